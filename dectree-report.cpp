@@ -0,0 +1,30 @@
+/**
+\file
+\brief Command-line app producing the diagnostic files of a training from its trace file,
+recorded with the \c -tr switch of \c dectree (see dtcpp::TraceDiagSink).
+See doc on https://github.com/skramm/dtcpp
+\author S. Kramm - 2021
+*/
+
+#include "dtcpp.h"
+
+using namespace dtcpp;
+
+
+int main( int argc, const char** argv )
+{
+	if( argc < 2 )
+	{
+		std::cerr << "Error, no trace file name given !\nusage: dectree-report <trace_file>\n";
+		std::exit(1);
+	}
+	std::string fname = argv[1];
+
+	FileDiagSink fileSink;
+	if( !writeTraceReport( fname, fileSink ) )
+	{
+		std::cerr << "Error, unable to read trace file: " << fname << '\n';
+		std::exit(1);
+	}
+	std::cout << " - Generated the files of trace " << fname << " in folder out/, see out/training.html\n";
+}
@@ -125,23 +125,105 @@ int main( int argc, const char** argv )
 	}
 #endif // HANDLE_OUTLIERS
 
+// optional arg: -nt x => use 'x' threads
+	auto str_threads = cmdl("nt").str();
+	if( !str_threads.empty() )
+	{
+		int nbThreads = std::stoi( str_threads );
+		if( nbThreads <= 0 )
+		{
+			std::cerr << "Error, invalid nb of threads: " << str_threads << '\n';
+			std::exit(1);
+		}
+		fparams.nbThreads = static_cast<uint>( nbThreads );
+		params.nbThreads = fparams.nbThreads;
+	}
+	std::cout << " - nb of threads: " << fparams.nbThreads << '\n';
+
+// optional boolean arg: -nc => do not use (nor create) the binary cache file of the dataset
+	bool useCache = ( fname != "-" );
+	if( cmdl["nc"] )
+		useCache = false;
+
+// optional boolean arg: -cg => generate the C++ code of the trained tree in out/tree_model.h (no folding only)
+	bool doCodeGen = false;
+	if( cmdl["cg"] )
+		doCodeGen = true;
+
+// optional arg: -sm file => save the trained tree in binary model file 'file' (no folding only)
+	auto modelFile = cmdl("sm").str();
+
+// optional arg: -mb x => memory budget of 'x' MB for training, data file is read through the cache file
+	auto str_membudget = cmdl("mb").str();
+	if( !str_membudget.empty() )
+	{
+		params.memoryBudget = size_t( std::stoul( str_membudget ) ) << 20;
+		if( !useCache )
+		{
+			std::cerr << " - option -mb: requires the cache file, can't be used with -nc or stdin\n";
+			return 1;
+		}
+		std::cout << " - memory budget: " << str_membudget << " MB\n";
+	}
+
 	if( cmdl["sd"] )
 		params.useSortToFindThresholds = true;
-	std::cout << " - threshold finding technique: " << (params.useSortToFindThresholds?"sort points":"histogram binning") << '\n';
+	if( cmdl["ps"] )
+		params.usePresortedAttributes = true;
+	if( cmdl["lw"] )
+		params.levelWiseGrowth = true;
+	std::cout << " - threshold finding technique: " << (params.useSortToFindThresholds?"sort points":"histogram binning")
+		<< (params.useSortToFindThresholds && params.usePresortedAttributes?" (presorted)":"") << '\n';
+	if( params.levelWiseGrowth )
+		std::cout << " - level-wise tree growth\n";
 
 	DataSet dataset;
-	if( !dataset.load( fname, fparams ) )
+	auto fcache = fname + ".dtcache";
+	bool cacheLoaded = false;
+	if( useCache && priv::fileIsNewer( fcache, fname ) )
+		cacheLoaded = dataset.loadSnapshot( fcache, fparams );
+	if( !cacheLoaded && params.memoryBudget )        // data is not loaded in memory, but directly written to the cache file
+	{
+		if( !DataSet::createSnapshot( fname, fcache, fparams ) || !dataset.loadSnapshot( fcache, fparams ) )
+		{
+			std::cerr << "Error, unable to convert data file: " << fname << '\n';
+			std::exit(1);
+		}
+		cacheLoaded = true;
+	}
+	if( !cacheLoaded && !dataset.load( fname, fparams ) )
 	{
 		std::cerr << "Error, unable to load data file: " << fname << '\n';
 		std::exit(1);
 	}
 
 	dataset.printInfo( std::cout );
-	auto stats = dataset.computeStats<float>( nbBins );
+	DatasetStats<float> snapStats( dataset.nbAttribs() );
+	bool hasSnapStats = cacheLoaded && dataset.getSnapshotStats( snapStats );   // no need to compute them again
+	auto stats = dataset.computeStats<float>( nbBins, hasSnapStats ? &snapStats : nullptr );
 	std::cout << stats;
 
+	if( useCache && !cacheLoaded )
+	{
+		if( dataset.saveSnapshot( fcache, &stats ) )
+			std::cout << " - saved cache file " << fcache << '\n';
+		else
+			std::cerr << " - warning: unable to save cache file " << fcache << '\n';
+	}
+
 	auto fhtml = dtcpp::priv::openOutputFile( "dectree", priv::FT_HTML, dataset._fname );
 	params.outputHtml = &fhtml;
+	FileDiagSink  fileSink;
+	TraceDiagSink traceSink;
+	auto traceFile = cmdl("tr").str();       // optional arg: -tr file => record a training trace in 'file', see dectree-report
+	if( !traceFile.empty() )
+	{
+		params.diagSink = &traceSink;
+		std::cout << " - recording training trace in " << traceFile << '\n';
+	}
+	else
+		if( !cmdl["nd"] )
+			params.diagSink = &fileSink;
 
 	dataset.generateDataHtmlPage( fhtml, stats, 10 /* bins */ );
 
@@ -181,49 +263,47 @@ int main( int argc, const char** argv )
 		tt.printInfo( std::cout, "After pruning" );
 		std::cout << trainInfo;
 
-		auto cm = tt.classify( dataset );
+		auto itree = tt.compile();
+		auto cm = itree.classify( dataset );
 		std::cout << cm << "\n";
 		cm.printAllScores( std::cout );
+
+		if( !modelFile.empty() )
+		{
+			itree.assignLabels( dataset.getStringIndexBimap() );
+			if( !itree.saveModel( modelFile ) )
+			{
+				std::cerr << "Error, unable to save model in file " << modelFile << '\n';
+				return 1;
+			}
+			std::cout << " - Saved model in file " << modelFile << '\n';
+		}
+
+		if( doCodeGen )
+		{
+			auto fcode = priv::openOutputFile( "tree_model", priv::FT_HPP, dataset._fname );
+			tt.printCode( fcode, "dtcpp_model", &dataset.getStringIndexBimap() );
+			std::cout << " - Generated C++ code of the tree in out/tree_model.h\n";
+		}
 	}
 	else
 	{
-		dataset.shuffle();
+		DataSetView dsview( dataset );    // shuffle and folding only handle indexes, the data is not copied
+		dsview.shuffle();
 
-        std::vector<ConfusionMatrix> vec_cm_test;
         std::vector<TrainingTree> vec_tree(nbFolds);
+		auto cvInfo = crossValidate( vec_tree, dsview, params, params.nbThreads );   // folds are processed concurrently if several threads
+		const auto& vec_cm_test = cvInfo.vConfMat;
 		for( int i=0; i<nbFolds; i++ )
 		{
-			vec_tree[i].assignCIM( dataset.getClassIndexMap() );
-			auto p_data_subsets = dataset.getFolds( i, nbFolds );
-			auto data_train = p_data_subsets.first;
-			auto data_test  = p_data_subsets.second;
-
-//			data_train.generateClassDistrib( "histo_tr_" + std::to_string(i) );
-//			data_test.generateClassDistrib(  "histo_te_" + std::to_string(i) );
-
-//			data_train.printInfo( std::cout, "train" );
-//			data_test.printInfo(  std::cout, "test" );
-			params.foldIndex = i;
-			auto trainInfo = vec_tree[i].train( data_train, params );
-			if( !trainInfo.trainingSuccess )
+			std::cout << cvInfo.vLog[i];
+			if( !cvInfo.vTrainInfo[i].trainingSuccess )
 			{
 				std::cerr << "Failed to build tree for fold " << i << '\n';
 				return 1;
 			}
-
 			vec_tree[i].printInfo( std::cout, "fold " + std::to_string(i) );
-			std::cout << trainInfo;
-
-//			vec_cm_train.push_back( tt.classify( data_train ) );
-			vec_cm_test.push_back( vec_tree[i].classify( data_test ) );
-
-//			std::cout << "\n* Fold " << i+1 << "/" << nbFolds << '\n';
-
-/*			std::cout << "Confusion Matrix (train):" << cm_train << "\n";
-			cm_train.printAllScores( std::cout, "train" );
-			std::cout << "Confusion Matrix (test):"  << cm_test << "\n";
-			cm_test.printAllScores( std::cout, "test" );
-*/
+			std::cout << cvInfo.vTrainInfo[i];
 		}
 		std::cout << "* Folding: tree data:\n";
 		for( int i=0; i<nbFolds; i++ )
@@ -246,4 +326,10 @@ int main( int argc, const char** argv )
 
 	}
 	fhtml << "</body></html>\n";
+
+	if( !traceFile.empty() && !traceSink.save( traceFile ) )
+	{
+		std::cerr << "Error, unable to save training trace in file " << traceFile << '\n';
+		return 1;
+	}
 }
@@ -30,15 +30,34 @@ See doc on https://github.com/skramm/dtcpp
 #include <random>
 #include <iomanip>
 #include <chrono>
+#include <ctime>
+#include <cstring>
+#include <cctype>
+#include <memory>
+#include <thread>
+#include <array>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <atomic>
+#include <set>
+#include <tuple>
 
 #include <boost/graph/adjacency_list.hpp>
 #include <boost/histogram.hpp>
 #include <boost/bimap.hpp>
 #include <boost/bimap/vector_of.hpp>
+#include <boost/align/aligned_allocator.hpp>
+#include <boost/utility/string_view.hpp>
+#include <boost/range/iterator_range.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
-#ifdef GRAPH_SERIALIZATION
-	#include <boost/archive/text_oarchive.hpp>
-	#include <boost/archive/text_iarchive.hpp>
+#include <sys/stat.h>
+
+#if defined(__SSE2__) && defined(DTCPP_SIMD_INFERENCE)
+	#include <emmintrin.h>
 #endif
 
 //#include "private.hpp"
@@ -48,7 +67,8 @@ See doc on https://github.com/skramm/dtcpp
 namespace dtcpp {
 
 // forward declaration
-//class DataSet;
+class DataSet;
+class DataSetView;
 
 // % % % % % % % % % % % % % %
 /// private namespace; not part of API
@@ -59,7 +79,7 @@ namespace priv {
 /// Identifier for output file type, used in openOutputFile()
 enum EN_FileType
 {
-	FT_CSV,FT_DAT,FT_HTML,FT_PLT,FT_DOT
+	FT_CSV,FT_DAT,FT_HTML,FT_PLT,FT_DOT,FT_HPP
 };
 const char*
 getString( EN_FileType ft )
@@ -72,6 +92,7 @@ getString( EN_FileType ft )
 		case FT_PLT:  s = "plt";  break;
 		case FT_DOT:  s = "dot";  break;
 		case FT_HTML: s = "html"; break;
+		case FT_HPP:  s = "h";    break;
 		default: assert(0);
 	}
 	return s;
@@ -96,7 +117,8 @@ openOutputFile( const std::string& fn, EN_FileType ft, const std::string& data_f
 			<< "</title>\n<link rel='stylesheet' href='out_style.css' type='text/css'>\n"
 			<< "</head>\n<body>\n";
 
-	f <<  ( ft == FT_HTML ? "<p>" : "# " )
+	std::string cmt = ( ft == FT_HPP ? "//" : "#" );     // line comment
+	f <<  ( ft == FT_HTML ? "<p>" : cmt + ' ' )
 		<< "generated by dtcpp, see "
 		<<  ( ft == FT_HTML ? "<a href='https://github.com/skramm/dtcpp'>" : "" )
 		<< "https://github.com/skramm/dtcpp"
@@ -106,14 +128,20 @@ openOutputFile( const std::string& fn, EN_FileType ft, const std::string& data_f
 		auto now = std::chrono::system_clock::now();
 		auto in_time_t = std::chrono::system_clock::to_time_t(now);
 
+		std::tm tmNow;                 // not std::localtime(), as its static buffer is shared by the threads writing output files
+#ifdef _WIN32
+		localtime_s( &tmNow, &in_time_t );
+#else
+		localtime_r( &in_time_t, &tmNow );
+#endif
 		std::ostringstream ss;
-		ss << std::put_time(std::localtime(&in_time_t), "%Y-%m-%d %X");
-		f <<  ( ft == FT_HTML ? "" : "#" )
+		ss << std::put_time( &tmNow, "%Y-%m-%d %X" );
+		f <<  ( ft == FT_HTML ? std::string() : cmt )
 			<< " Generated on " << ss.str() << "\n"
 			<<  ( ft == FT_HTML ? "</p>" : "" );
 	}
 	if( !data_fn.empty() && ft != FT_HTML )
-		f << "# source data file: " << data_fn << '\n';
+		f << cmt << " source data file: " << data_fn << '\n';
 
 	f << '\n';
 	return f;
@@ -163,109 +191,453 @@ private:
 //class DataSet;
 
 
-//-------------------------------------------------------------------
-/// Remove multiple spaces AND TABS in string, allows only one, except if in first position
+//---------------------------------------------------------------------
+/// Returns true if \c c is a space or a tab
+inline
+bool
+isBlank( char c )
+{
+	return c == ' ' || c == '\t';
+}
+
+//---------------------------------------------------------------------
+/// Line tokenizer, splits the characters in [first,last) into fields separated by \c sep.
 /**
-Also replaces tabs with spaces
+Fields are stored in \c v_tok as views on the input buffer (no copy, no allocation once
+\c v_tok has reached its capacity).
+
+- If the separator is a space or a tab, then any sequence of spaces and tabs is considered as a single separator
+- else, leading and trailing spaces/tabs of each field are removed
+- a separator at end of line does not produce an empty field
 */
-std::string
-trimSpaces( const std::string& input )
+inline
+void
+splitLine( const char* first, const char* last, char sep, std::vector<boost::string_view>& v_tok )
+{
+	v_tok.clear();
+	if( isBlank( sep ) )
+	{
+		while( first != last )
+		{
+			while( first != last && isBlank(*first) )
+				first++;
+			auto tok = first;
+			while( first != last && !isBlank(*first) )
+				first++;
+			if( tok != first )
+				v_tok.emplace_back( tok, first - tok );
+		}
+		return;
+	}
+
+	while( first != last )
+	{
+		auto tok = first;
+		while( first != last && *first != sep )
+			first++;
+		auto tok_end = first;
+		while( tok != tok_end && isBlank(*tok) )
+			tok++;
+		while( tok != tok_end && isBlank(*(tok_end-1)) )
+			tok_end--;
+		if( first != last )   // then we are on a separator, skip it
+			first++;
+		v_tok.emplace_back( tok, tok_end - tok );
+	}
+}
+
+//---------------------------------------------------------------------
+/// Locale-independent string to floating-point conversion, in the spirit of C++17 \c std::from_chars()
+/**
+- Accepts either '.' or ',' as decimal separator, an optional sign and an optional exponent.
+- Does not allocate and does not depend on the current locale.
+
+\return a pointer on the first character that was not parsed, or \c nullptr if no number could be read
+(and then, \c value is left unchanged)
+
+\note The result is exact (correctly rounded) as long as the number has less than 16 significant digits
+and a decimal exponent lower than 22, which covers nearly all the values found in csv files.
+*/
+inline
+const char*
+parseNumber( const char* first, const char* last, double& value )
 {
-	assert( input.size() > 0 );
-	bool HasOneAlready( false );
-	bool FirstElem( true );
-	std::string out;
-	for( auto c: input )
+	static const double pow10[] = {
+		1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+	auto p = first;
+	bool neg = false;
+	if( p != last && ( *p == '-' || *p == '+' ) )
+		neg = ( *p++ == '-' );
+
+	uint64_t mant  = 0u;
+	int      nbDig = 0;     // nb of significant digits stored in mant
+	int      exp10 = 0;
+	bool     hasDigit = false;
+	for( ; p != last && *p >= '0' && *p <= '9'; p++ )   // integral part
 	{
-		if( c != ' ' && c != 9 )
+		hasDigit = true;
+		if( nbDig < 19 )
 		{
-			out.push_back( c );
-			HasOneAlready = false;
-			FirstElem = false;
+			mant = mant*10u + static_cast<uint64_t>( *p - '0' );
+			if( mant )
+				nbDig++;
 		}
-		else {
-			if( !HasOneAlready && !FirstElem )
+		else
+			exp10++;
+	}
+	if( p != last && ( *p == '.' || *p == ',' ) )        // fractional part
+	{
+		p++;
+		for( ; p != last && *p >= '0' && *p <= '9'; p++ )
+		{
+			hasDigit = true;
+			if( nbDig < 19 )
 			{
-				out.push_back( ' ' ); // add a space character
-				HasOneAlready = true;
+				mant = mant*10u + static_cast<uint64_t>( *p - '0' );
+				if( mant )
+					nbDig++;
+				exp10--;
 			}
 		}
 	}
-	if( out.back() == ' ' ) // if last element is a space, then remove it
-		out.erase( out.end()-1 );
+	if( !hasDigit )
+		return nullptr;
+
+	if( p != last && ( *p == 'e' || *p == 'E' ) )        // exponent, only consumed if valid
+	{
+		auto pe = p+1;
+		bool eneg = false;
+		if( pe != last && ( *pe == '-' || *pe == '+' ) )
+			eneg = ( *pe++ == '-' );
+		if( pe != last && *pe >= '0' && *pe <= '9' )
+		{
+			int e = 0;
+			for( ; pe != last && *pe >= '0' && *pe <= '9'; pe++ )
+				if( e < 10000 )
+					e = e*10 + ( *pe - '0' );
+			exp10 += ( eneg ? -e : e );
+			p = pe;
+		}
+	}
 
-	return out;
+	double res = static_cast<double>( mant );
+	if( mant == 0u )
+		res = 0.;
+	else
+	{
+		if( mant < (1ull<<53) && exp10 >= -22 && exp10 <= 22 )   // exact path: both operands are exact
+			res = ( exp10 < 0 ? res / pow10[-exp10] : res * pow10[exp10] );
+		else
+			res *= std::pow( 10., exp10 );
+	}
+	value = ( neg ? -res : res );
+	return p;
 }
 
 //---------------------------------------------------------------------
-/// General string tokenizer, taken from http://stackoverflow.com/a/236803/193789
+/// Locale-independent string to integer conversion, in the spirit of C++17 \c std::from_chars()
 /**
-- see also this one: http://stackoverflow.com/a/53878/193789
+\return a pointer on the first character that was not parsed, or \c nullptr if no number could be read
 */
 inline
-std::vector<std::string>
-splitString( const std::string &s, char delim )
+const char*
+parseInt( const char* first, const char* last, int& value )
 {
-	std::vector<std::string> velems;
-	std::stringstream ss( trimSpaces(s) );
-	std::string item;
-	while( std::getline( ss, item, delim ) )
-		velems.push_back(item);
+	auto p = first;
+	bool neg = false;
+	if( p != last && ( *p == '-' || *p == '+' ) )
+		neg = ( *p++ == '-' );
+	if( p == last || *p < '0' || *p > '9' )
+		return nullptr;
+	int64_t res = 0;
+	for( ; p != last && *p >= '0' && *p <= '9'; p++ )
+	{
+		res = res*10 + ( *p - '0' );
+		if( res > std::numeric_limits<int>::max() )
+			return nullptr;
+	}
+	value = static_cast<int>( neg ? -res : res );
+	return p;
+}
+
+//---------------------------------------------------------------------
+/// Read-only memory mapping of a whole file (wrapper over Boost.Interprocess)
+/**
+Throws a \c boost::interprocess::interprocess_exception if the file can not be mapped
+(non existing file, pipe, empty file, ...)
+*/
+class MappedFile
+{
+	public:
+		explicit MappedFile( const std::string& fname )
+			: _fmap( fname.c_str(), boost::interprocess::read_only )
+			, _region( _fmap, boost::interprocess::read_only )
+		{}
+		const char* data() const
+		{
+			return static_cast<const char*>( _region.get_address() );
+		}
+		size_t size() const
+		{
+			return _region.get_size();
+		}
+/// Hint the kernel that the mapping will be read sequentially
+		void adviseSequential()
+		{
+			_region.advise( boost::interprocess::mapped_region::advice_sequential );
+		}
+	private:
+		boost::interprocess::file_mapping  _fmap;
+		boost::interprocess::mapped_region _region;
+};
 
-	return velems;
+//---------------------------------------------------------------------
+/// Returns true if \c fname is a regular file (not a pipe, a device, ...), so it can be mapped in memory
+inline
+bool
+isRegularFile( const std::string& fname )
+{
+	struct stat st;
+	return stat( fname.c_str(), &st ) == 0 && S_ISREG( st.st_mode );
+}
+//---------------------------------------------------------------------
+/// Returns true if file \c f1 exists and has been modified after file \c f2
+bool
+fileIsNewer( const std::string& f1, const std::string& f2 )
+{
+	struct stat st1, st2;
+	if( stat( f1.c_str(), &st1 ) != 0 || stat( f2.c_str(), &st2 ) != 0 )
+		return false;
+	if( st1.st_mtime != st2.st_mtime )
+		return st1.st_mtime > st2.st_mtime;
+#if defined(__APPLE__)                 // nanoseconds, if available
+	return st1.st_mtimespec.tv_nsec > st2.st_mtimespec.tv_nsec;
+#elif defined(__linux__)
+	return st1.st_mtim.tv_nsec > st2.st_mtim.tv_nsec;
+#else
+	return false;
+#endif
 }
 
 //---------------------------------------------------------------------
-/// Edge of the tree. Value is true/false of the above decision, depending on threshold
-struct EdgeData
+/// Bits of SnapshotHeader::flags
+enum EN_SnapshotFlag : uint32_t
 {
-	bool edgeSide;
+	SF_HasMissing = 1,
+	SF_HasStats   = 2
 };
 
+/// Current version of the snapshot file format, see DataSet::saveSnapshot()
+constexpr uint32_t SnapshotVersion = 1;
+
 //---------------------------------------------------------------------
-/// String to floating-point conversion utility, split on ',' or '.'.
+/// Header of a binary dataset snapshot file, see DataSet::saveSnapshot()
 /**
-\note Needed because, with C++14, you can't convert independently of the locale !!!
+All the offsets are relative to the beginning of the file, and are multiples of 64, so that the
+columns can be used directly from the mapped memory. Values are stored in native byte order.
+
+Sections, in that order:
+- the attribute columns (\c nbAttribs arrays of \c nbPoints floats, separated by \c colStride bytes)
+- the class column (\c nbPoints int32)
+- the flag column (\c nbPoints bytes, see EN_PointFlag)
+- the missing values bitmaps (one per attribute, of \c bitmapStride bytes), only if flag \c SF_HasMissing is set
+- the class counts (\c nbClassCount pairs of int64: class value, nb of points)
+- the string labels (\c nbLabels times: uint32 index, uint32 length, characters)
+- the attribute stats (\c nbAttribs times 5 floats, see AttribStats), only if flag \c SF_HasStats is set
+- the name of the source data file
+*/
+struct SnapshotHeader
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t byteOrder;       ///< used to check the file has been written on a machine with same endianness
+	uint64_t fileSize;
+	uint64_t nbPoints;
+	uint32_t nbAttribs;
+	uint32_t flags;           ///< see EN_SnapshotFlag
+	uint32_t fparamsFlags;    ///< to check that the file was read with the same parameters, see fparamsFlags()
+	char     sep;             ///< field separator of source file
+	char     pad[3];
+	uint64_t nbNoClassPoints;
+	uint64_t offColumns;
+	uint64_t colStride;
+	uint64_t offClass;
+	uint64_t offFlags;
+	uint64_t offMissing;
+	uint64_t bitmapStride;
+	uint64_t offClassCount;
+	uint64_t nbClassCount;
+	uint64_t offLabels;
+	uint64_t nbLabels;
+	uint64_t offStats;
+	uint64_t offSourceName;
+	uint64_t sourceNameSize;
+};
+
+/// Magic string at beginning of snapshot files
+constexpr char SnapshotMagic[8] = { 'D','T','C','P','P','D','S','\0' };
 
-\note Unfortunately, can't detect erroneous strings such as "12.34,56" because std::stoi doest not
-throw if it sees a decimal separator...
+//---------------------------------------------------------------------
+/// Current version of the training trace file format, see TraceDiagSink
+constexpr uint32_t TraceVersion = 1;
+
+/// Magic string at beginning of training trace files
+constexpr char TraceMagic[8] = { 'D','T','C','P','P','T','R','\0' };
+
+/// Type of a record of a training trace, see TraceDiagSink
+enum EN_TraceRecord : uint8_t
+{
+	TR_SplitSearch = 1,   ///< a SplitSearchRecord
+	TR_Tree        = 2    ///< a tree (name, fold index, data file name, nb of leaves and the nodes, see TraceNode)
+};
+
+//---------------------------------------------------------------------
+/// Header of a binary training trace file, see TraceDiagSink::save()
+/**
+Values are stored in native byte order. The header is followed by:
+- the name of the data file (uint32 length, characters)
+- the class labels (\c nbLabels times: uint32 length, characters)
+- the records (\c nbRecords times: one byte giving the record type, see EN_TraceRecord, then the record)
 */
-double
-my_stod( std::string str )
+struct TraceHeader
 {
-	assert( str.size() );                // input must not be empty
-	auto vc = splitString( str, ',' );
-	auto vd = splitString( str, '.' );
-	assert( vc.size() &&  vd.size() ); // that shouln't happen either
+	char     magic[8];
+	uint32_t version;
+	uint32_t byteOrder;       ///< used to check the file has been written on a machine with same endianness
+	uint64_t nbRecords;
+	uint32_t nbLabels;
+	uint32_t pad;
+};
 
-	if( vc.size() > 2 || vd.size() > 2 ) // can't have more than one '.' or ','
-		throw std::runtime_error( "unable to convert string -" + str + "- to float" );
+//---------------------------------------------------------------------
+/// A node of a tree, as stored in a training trace. Nodes are stored in depth-first order, each one after its parent.
+struct TraceNode
+{
+	int32_t  parent;          ///< index of the parent node in the record, -1 for the root node
+	uint32_t nodeId;
+	uint32_t type;            ///< see NodeType
+	int32_t  nClass;
+	uint32_t attrIndex;
+	float    threshold;
+	float    giniImpurity;
+	float    nAmbig;
+	uint32_t edgeSide;        ///< side of the edge from the parent node, see EdgeData
+	uint32_t depth;
+	uint64_t nbPoints;
+};
 
-	double res =0.;
-	if( vc.size() == 1 && vd.size() == 1 )  // no decimal separator
-		try
+//---------------------------------------------------------------------
+/// Appends the bytes of \c val to the buffer \c buf, see TraceDiagSink
+template<typename T>
+void
+traceWrite( std::string& buf, const T& val )
+{
+	buf.append( reinterpret_cast<const char*>( &val ), sizeof(T) );
+}
+
+/// Appends a vector (uint32 size, then the elements) to the buffer \c buf
+template<typename T>
+void
+traceWrite( std::string& buf, const std::vector<T>& vec )
+{
+	traceWrite( buf, static_cast<uint32_t>( vec.size() ) );
+	buf.append( reinterpret_cast<const char*>( vec.data() ), vec.size() * sizeof(T) );
+}
+
+/// Appends a string (uint32 length, then the characters) to the buffer \c buf
+inline
+void
+traceWrite( std::string& buf, const std::string& str )
+{
+	traceWrite( buf, static_cast<uint32_t>( str.size() ) );
+	buf.append( str );
+}
+
+//---------------------------------------------------------------------
+/// Reads the values written with traceWrite() from a memory buffer, checking it does not read past the end
+class TraceReader
+{
+	public:
+		TraceReader( const char* p, size_t size ) : _p(p), _end(p+size)
+		{}
+/// Returns false if the buffer is too short
+		template<typename T>
+		bool read( T& val )
 		{
-			res = 1. * std::stoi( str );  // string is an integer
+			if( size_t(_end - _p) < sizeof(T) )
+				return false;
+			std::memcpy( &val, _p, sizeof(T) );
+			_p += sizeof(T);
+			return true;
 		}
-		catch( ... )
+		template<typename T>
+		bool read( std::vector<T>& vec )
 		{
-			throw std::runtime_error( "unable to convert string -" + str + "- to float" );
+			uint32_t n = 0;
+			if( !read( n ) || size_t(_end - _p) / sizeof(T) < n )
+				return false;
+			vec.resize( n );
+			std::memcpy( vec.data(), _p, n * sizeof(T) );
+			_p += n * sizeof(T);
+			return true;
 		}
-	else   // here, we do have a decimal separator
-	{
-		if( vc.size() == 2 )  // comma detected
-			std::swap( vc, vd );
+		bool read( std::string& str )
+		{
+			uint32_t n = 0;
+			if( !read( n ) || size_t(_end - _p) < n )
+				return false;
+			str.assign( _p, n );
+			_p += n;
+			return true;
+		}
+		bool atEnd() const { return _p == _end; }
 
-		auto xi = 0.;                 // value left of decimal separator
-		if( vd[0].size() )            // we use stod() instead of stoi() because
-			xi = std::stod( vd[0] );  // the number of digits might be to much for stoi()
+	private:
+		const char* _p;
+		const char* _end;
+};
 
-		auto xf = 0.;                 // value right of decimal separator
-		if( vd[1].size() )
-			xf = std::stod( vd[1] );
+//---------------------------------------------------------------------
+/// Holds the state of the parser while reading a data file, see DataSet::load()
+struct ParserState
+{
+	uint   classIndexCounter = 0;         ///< the next index value for classes as strings
+	size_t nb_lines   = 0;
+	size_t nb_empty   = 0;
+	size_t nb_comment = 0;
+	uint   nbAttribs  = 0;                ///< nb of attributes, set on first data line
+	bool   quiet      = false;            ///< if true, errors are not printed (used when parsing chunks in parallel)
+	std::vector<boost::string_view> v_tok;   ///< tokens of current line, reused from one line to the next
+	std::string                     strBuf;  ///< reused buffer, for class strings lookup
+#ifdef HANDLE_MISSING_VALUES
+	std::vector<uint>               vMissing; ///< indexes of the attributes with missing values in current line
+#endif
+};
 
-		res = xi + xf / std::pow(10, vd[1].size() );
-	}
+//---------------------------------------------------------------------
+/// Edge of the tree. Value is true/false of the above decision, depending on threshold
+struct EdgeData
+{
+	bool edgeSide;
+};
+
+//---------------------------------------------------------------------
+/// String to floating-point conversion utility, accepts ',' or '.' as decimal separator.
+/**
+\note Needed because, with C++14, you can't convert independently of the locale !!!
+
+Throws if the whole string can not be converted, see parseNumber()
+*/
+double
+my_stod( const std::string& str )
+{
+	assert( str.size() );                // input must not be empty
+	double res = 0.;
+	auto last = str.data() + str.size();
+	if( parseNumber( str.data(), last, res ) != last )
+		throw std::runtime_error( "unable to convert string -" + str + "- to float" );
 	return res;
 }
 
@@ -278,6 +650,74 @@ my_stod( std::string str )
 using ThresholdVal = priv::NamedType<float,struct ThresholdValTag>;
 using ClassVal     = priv::NamedType<int,  struct ClassValTag>;
 
+//---------------------------------------------------------------------
+/// Outcome of the threshold search on one attribute for one node, see SearchBestIG() and DiagSink::addSplitSearch()
+struct SplitSearchRecord
+{
+	uint32_t nodeId = 0;
+	uint32_t atIdx = 0;
+	int32_t  foldIndex = -1;
+	uint64_t nbPoints = 0;
+	std::vector<float>    vThresVal;       ///< threshold values
+	std::vector<uint32_t> vNbLT;           ///< for each threshold, nb of points lower than it
+	std::vector<uint64_t> vNbHT;           ///< for each threshold, nb of points higher than it
+	std::vector<float>    vDeltaGini;      ///< for each threshold, the Gini gain
+/// Nb of points of each class (columns) in each interval between thresholds (rows, one more than the thresholds).
+/// Empty if not computed (see \c DTCPP_NEED_FOR_SPEED)
+	std::vector<uint32_t> vClassHisto;
+};
+
+class TrainingTree;
+
+//---------------------------------------------------------------------
+/// Destination of the diagnostic files produced while searching the splits (one data file and one plot script
+/// per node and attribute, see SearchBestIG()), see Params::diagSink
+class DiagSink
+{
+	public:
+		virtual ~DiagSink() = default;
+/// If false, no diagnostic output is produced at all, and the per node html report is not written
+		virtual bool enabled() const = 0;
+/// If false, the per node html report is not written in Params::outputHtml (when the sink produces its own)
+		virtual bool htmlReport() const
+		{
+			return enabled();
+		}
+/// Returns the stream to write the file \c fname (without extension) of type \c ft into
+		virtual std::unique_ptr<std::ostream> openFile( const std::string& fname, priv::EN_FileType ft, const std::string& data_fn ) = 0;
+/// Receives the outcome of the threshold search of an attribute on a node.
+/// Default behavior is to write the data and plot files using openFile(), see writeSplitSearchFiles()
+		virtual void addSplitSearch( const SplitSearchRecord& rec, const DataSet& data );
+/// Receives the trees built by the training (\c name is \c "initial" or \c "pruned").
+/// Default behavior is to write the DOT file of the tree using openFile(), see TrainingTree::printDot()
+		virtual void addTree( const std::string& name, const TrainingTree& tree, int foldIndex );
+};
+//---------------------------------------------------------------------
+/// Diagnostic sink discarding everything, so that the training produces no diagnostic output (this is the default, see Params::diagSink)
+/**
+No file is written, and the trees are not converted to DOT. Only the html report is still written, if Params::outputHtml is not null.
+*/
+class NullDiagSink : public DiagSink
+{
+	public:
+		bool enabled() const override { return false; }
+		std::unique_ptr<std::ostream> openFile( const std::string&, priv::EN_FileType, const std::string& ) override
+		{
+			return std::unique_ptr<std::ostream>();
+		}
+};
+//---------------------------------------------------------------------
+/// Diagnostic sink writing the files in the \c out folder, see priv::openOutputFile()
+class FileDiagSink : public DiagSink
+{
+	public:
+		bool enabled() const override { return true; }
+		std::unique_ptr<std::ostream> openFile( const std::string& fname, priv::EN_FileType ft, const std::string& data_fn ) override
+		{
+			return std::make_unique<std::ofstream>( priv::openOutputFile( fname, ft, data_fn ) );
+		}
+};
+
 //---------------------------------------------------------------------
 /// Run-time parameters for training
 struct Params
@@ -291,9 +731,31 @@ struct Params
 //	int   nbFolds = 5;
 	uint  maxTreeDepth = 12;
 	bool  useSortToFindThresholds = false;
-	bool  generateDotFiles = true;
+/// If true (and \ref useSortToFindThresholds is true), the points are sorted on each attribute only once, at the root node.
+/// Each child node inherits the sorted lists of its parent, so no more sorting is needed.
+	bool  usePresortedAttributes = false;
 	int   foldIndex = -1;
+/// Html report of the training (can be null)
 	std::ostream* outputHtml = nullptr;
+/// Destination of the diagnostic files of the split search and of the DOT files of the trees.
+/// If null, none are produced (same as \ref NullDiagSink).
+/// When enabled, the html report also shows, for each node, the plots of these files.
+	DiagSink*     diagSink = nullptr;
+/// Max memory (bytes) used by the lists of point indexes of the tree nodes during training, 0 means no limit.
+/// When exceeded, these lists are moved to a temporary file until needed (they are not available after training).
+/// For datasets that do not fit in memory, use this with a dataset loaded by DataSet::loadSnapshot().
+	size_t memoryBudget = 0;
+/// Nb of threads used for training. With more than one, the attributes of a node are processed concurrently
+/// (see findBestAttribute()), and so are the two subtrees of a node (see priv::splitNode()).
+/// The resulting tree is the same, but node ids may differ, as they follow the node creation order.
+	uint  nbThreads = 1;
+/// With \ref nbThreads > 1, nodes holding at least this nb of points get their points split into blocks, counted by separate
+/// threads when evaluating the thresholds of an attribute (see computeDeltaGini()).
+	size_t blockSplitMinSize = 1<<18;
+/// If true, the tree is grown level by level instead of depth first (see priv::growLevelWise()): all the nodes of a level
+/// are processed together, with a few sequential passes over each attribute column.
+/// Ignored if a \ref memoryBudget is set, and \ref usePresortedAttributes is then not used.
+	bool  levelWiseGrowth = false;
 };
 
 
@@ -329,6 +791,13 @@ class DataSetDescription
 
 //---------------------------------------------------------------------
 /// A datapoint, holds a set of attributes value and a corresponding (binary) class
+/**
+Two flavours:
+- a standalone point, that owns its attribute values (this is what you build to add some point in a DataSet, or to classify a point)
+- a row view on a DataSet, as returned by DataSet::getDataPoint(). This one does not hold the values,
+it just fetches them from the dataset columns, so it is cheap to create (no allocation). It is only valid
+as long as the dataset it comes from is alive and unchanged.
+*/
 //template<typename T>
 class DataPoint
 {
@@ -336,29 +805,28 @@ class DataPoint
 	friend class DataSet;
 
 	private:
-		std::vector<float> _attrValue;   ///< attributes
+		std::vector<float> _attrValue;   ///< attributes (standalone points only, empty for row views)
 		ClassVal _class = ClassVal(-1);  ///< Class of the datapoint, -1 for undefined
+		const DataSet* _pDataSet = nullptr;  ///< if not null, then this point is a view on row \c _rowIdx of that dataset
+		size_t         _rowIdx = 0u;
 
 #ifdef HANDLE_MISSING_VALUES
 /// \name Missing Values handling
 /// (enabled only if \c HANDLE_MISSING_VALUES enabled, see build options)
 ///@{
-		std::set<uint> _missingValues;  ///< holds indexes of the attributes with missing values
+		std::vector<uint> _missingValues;  ///< holds (sorted) indexes of the attributes with missing values (standalone points only)
 	public:
-		size_t nbMissingValues() const
-		{
-			return _missingValues.size();
-		}
-		bool valueIsMissing( size_t idx ) const
-		{
-			assert( idx < nbAttribs() );
-			return ( _missingValues.find( idx ) != _missingValues.end() );
-
-		}
+		size_t nbMissingValues() const;
+		bool valueIsMissing( size_t idx ) const;
 		bool isMissingValue( const std::string& str ) const;
 ///@}
 #endif
 
+/// Constructor of a row view, see DataSet::getDataPoint()
+		DataPoint( const DataSet& ds, size_t rowIdx, ClassVal c )
+			: _class(c), _pDataSet(&ds), _rowIdx(rowIdx)
+		{}
+
 	public:
 #ifdef TESTMODE
 /// Constructor used in tests
@@ -383,7 +851,7 @@ class DataPoint
 #ifdef HANDLE_MISSING_VALUES
 				if( isMissingValue( v_string[i] ) )
 				{
-					_missingValues.insert( static_cast<uint>(i) );
+					_missingValues.push_back( static_cast<uint>(i) );
 					_attrValue.push_back( 0. );
 				}
 				else
@@ -411,10 +879,7 @@ class DataPoint
 				_attrValue.push_back( v_val[i] );
 		}
 
-		size_t nbAttribs() const
-		{
-			return _attrValue.size();
-		}
+		size_t nbAttribs() const;
 		ClassVal classVal() const
 		{
 			assert( _class != ClassVal(-1) );
@@ -424,23 +889,23 @@ class DataPoint
 		{
 			return _class == ClassVal(-1);
 		}
-		void setSize( size_t n ) { _attrValue.resize(n); }
-
-		const float& attribVal( size_t idx ) const
+/// Returns true if this point is a row view on some dataset
+		bool isView() const
 		{
-			assert( idx<_attrValue.size() );
-			return _attrValue[idx];
+			return _pDataSet != nullptr;
 		}
-/// This (fetch by ref) is needed when tagging outliers
-		float& attribVal( size_t idx )
+		void setSize( size_t n )
 		{
-			assert( idx<_attrValue.size() );
-			return _attrValue[idx];
+			assert( !isView() );
+			_attrValue.resize(n);
 		}
 
+		float attribVal( size_t idx ) const;
+
 //		template<typename U>
 		void setAttribVector( const std::vector<float>& vec )
 		{
+			assert( !isView() );
 			assert( vec.size() == nbAttribs() );
 			_attrValue = vec;
 		}
@@ -449,8 +914,8 @@ class DataPoint
 		friend std::ostream& operator << ( std::ostream& f, const DataPoint& pt )
 		{
 			f << "Datapoint: ";
-			for( const auto& v: pt._attrValue )
-				f << v << '-';
+			for( size_t i=0; i<pt.nbAttribs(); i++ )
+				f << pt.attribVal(i) << '-';
 			f << "C=" << pt._class.get() << ' ';
 			return f;
 		}
@@ -466,8 +931,120 @@ struct Fparams
 	bool classIsfirst = false;        ///< Default: class is last element of line, if first, then set this to true
 //	uint nbBinHistograms = 15;        ///< Nb of bins for the data analysis histograms
 	bool firstLineLabels = false;     ///< first line of data file holds attribute labels
+	bool useMemoryMapping = true;     ///< map the input file in memory and parse it from there (falls back to regular reading for pipes or stdin)
+	uint nbThreads = 1;               ///< Nb of threads used to parse the file (only used with memory mapping)
+};
+
+namespace priv {
+//---------------------------------------------------------------------
+/// Returns the flags of \c params that change the content of the dataset, stored in snapshot files
+inline
+uint32_t
+fparamsFlags( const Fparams& params )
+{
+	return   ( params.classAsString       ? 1 : 0 )
+		| ( params.dataFilesHoldsClass ? 2 : 0 )
+		| ( params.classIsfirst        ? 4 : 0 )
+		| ( params.firstLineLabels     ? 8 : 0 );
+}
+
+/// Returns bit \c idx of \c bitmap
+inline
+bool
+testBit( const uint64_t* bitmap, size_t idx )
+{
+	return ( bitmap[idx/64] >> (idx%64) ) & 1u;
+}
+
+/// Rounds up \c n to next multiple of 64
+//---------------------------------------------------------------------
+/// Current version of the model file format, see InferenceTree::saveModel()
+constexpr uint32_t ModelVersion = 2;
+
+/// Magic string at beginning of model files
+constexpr char ModelMagic[8] = { 'D','T','C','P','P','M','D','\0' };
+
+//---------------------------------------------------------------------
+/// Header of a binary model file, see InferenceTree::saveModel()
+/**
+All the offsets are relative to the beginning of the file, and the sections start on multiples of 64.
+Values are little-endian, so that the nodes can be used directly from the mapped memory.
+
+Sections, in that order:
+- the nodes (\c nbNodes InferenceNode, root first)
+- the class index map (\c nbClasses pairs of uint32: class value, index)
+- the string labels (\c nbLabels times: uint32 class value, uint32 length, characters)
+*/
+struct ModelHeader
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t byteOrder;       ///< used to check the file is read on a little-endian machine
+	uint64_t fileSize;
+	uint32_t layout;          ///< see En_TreeLayout
+	uint32_t leafIdx;         ///< see InferenceTree::_leafIdx
+	uint32_t nbAttribs;       ///< nb of attributes of the points the tree classifies (attribute indexes of the nodes are lower)
+	uint32_t pad;
+	uint64_t offNodes;
+	uint64_t nbNodes;
+	uint64_t offClasses;
+	uint64_t nbClasses;
+	uint64_t offLabels;
+	uint64_t nbLabels;
 };
 
+/// Returns true if the machine stores integers in little-endian order
+inline
+bool
+isLittleEndian()
+{
+	const uint32_t v = 1;
+	uint8_t b;
+	std::memcpy( &b, &v, 1 );
+	return b == 1;
+}
+
+inline
+uint64_t
+roundUp64( uint64_t n )
+{
+	return (n+63) / 64 * 64;
+}
+
+//---------------------------------------------------------------------
+/// Returns a snapshot file header, with only the general fields set, see DataSet::saveSnapshot()
+inline
+SnapshotHeader
+snapshotHeader( const Fparams& params, size_t nbAttribs )
+{
+	SnapshotHeader h;
+	std::memset( &h, 0, sizeof(h) );
+	std::memcpy( h.magic, SnapshotMagic, sizeof(h.magic) );
+	h.version      = SnapshotVersion;
+	h.byteOrder    = 0x01020304;
+	h.nbAttribs    = nbAttribs;
+	h.fparamsFlags = fparamsFlags( params );
+	h.sep          = params.sep;
+	return h;
+}
+//---------------------------------------------------------------------
+/// Sets the offsets of the column sections of snapshot header \c h, so they can hold \c capacity points
+inline
+void
+snapshotLayout( SnapshotHeader& h, size_t capacity )
+{
+	h.offColumns = roundUp64( sizeof(SnapshotHeader) );
+	h.colStride  = roundUp64( capacity * sizeof(float) );
+	h.offClass   = h.offColumns + h.nbAttribs * h.colStride;
+	h.offFlags   = h.offClass + roundUp64( capacity * sizeof(int32_t) );
+	h.offMissing = h.offFlags + roundUp64( capacity );
+#ifdef HANDLE_MISSING_VALUES
+	h.bitmapStride = roundUp64( (capacity+63) / 64 * sizeof(uint64_t) );
+#endif
+	h.offClassCount = h.offMissing + h.nbAttribs * h.bitmapStride;
+}
+} // namespace priv
+
 //---------------------------------------------------------------------
 /// Stats for a single attribute, see DataSet::computeStats()
 template<typename T>
@@ -537,6 +1114,16 @@ using ClassStringIndexBiMap = boost::bimap<
 
 using ClassCounter = std::map<ClassVal,size_t>;
 
+/// Dense index of a class, in the range 0..K-1 (K: nb of classes), following the class values order.
+/// This is what the training code uses, see DataSet::getClassIndexColumn()
+using ClassIndex = uint16_t;
+
+/// Class index of the classless points
+const ClassIndex NoClassIndex = ClassIndex(-1);
+
+/// Nb of points of each class, indexed by the class index
+using ClassCountArray = std::vector<size_t>;
+
 //---------------------------------------------------------------------
 /// Outlier Detection Method. Related to Dataset::tagOutliers()
 enum class En_OD_method
@@ -561,30 +1148,85 @@ enum class En_MVS
 	setToMean   ///< used mean value of attribute \todoM 20210403: not implemented yet !
 };
 #endif
+//---------------------------------------------------------------------
+/// Flags stored for each point of a DataSet, see DataSet::pointFlags()
+enum EN_PointFlag : uint8_t
+{
+	PF_None    = 0
+	,PF_Outlier = 1   ///< point has been tagged as outlier, see DataSet::tagOutliers()
+};
+
+/// A column of attribute values (one per attribute in a DataSet), aligned on a cache line
+using AttribColumn = std::vector<float,boost::alignment::aligned_allocator<float,64>>;
+
 //---------------------------------------------------------------------
 /// A dataset, holds a set of \ref DataPoint
+/**
+Storage is columnar: values are held in one contiguous (aligned) array per attribute, plus a class column and a flag column.
+The training code accesses these directly through getColumn() and getClassColumn().
+DataPoint objects returned by getDataPoint() or by iterating are only row views on these columns.
+
+Once loaded, a dataset can be saved as a binary snapshot with saveSnapshot().
+Reloading it with loadSnapshot() maps the file in memory, and the dataset then uses the columns
+directly from there (read-only, no parsing and no copying), so several processes share the same physical copy.
+Modifying such a dataset (adding points, shuffling, ...) will first copy the columns in memory.
+*/
 //template<typename T>
 class DataSet
 {
 	public:
-		DataSet() : _nbAttribs(0)
+/// Const iterator on the points of the dataset, dereferences to a row view (see DataPoint)
+		class const_iterator
 		{
-#ifdef HANDLE_MISSING_VALUES
-			DataSet::sv_MissingValueStrings.push_back("?");
-#endif
-//			g_params.p_dataset = this;
+			public:
+				const_iterator( const DataSet& ds, size_t idx ) : _pDataSet(&ds), _idx(idx)
+				{}
+				DataPoint operator * () const
+				{
+					return _pDataSet->getDataPoint( _idx );
+				}
+				const_iterator& operator ++ ()
+				{
+					_idx++;
+					return *this;
+				}
+				bool operator == ( const const_iterator& it ) const
+				{
+					return _idx == it._idx && _pDataSet == it._pDataSet;
+				}
+				bool operator != ( const const_iterator& it ) const
+				{
+					return !( *this == it );
+				}
+			private:
+				const DataSet* _pDataSet;
+				size_t         _idx;
+		};
+
+		DataSet() : _nbAttribs(0)
+		{
+#ifdef HANDLE_MISSING_VALUES
+			DataSet::sv_MissingValueStrings.push_back("?");
+#endif
+//			g_params.p_dataset = this;
 		}
-		explicit DataSet( size_t nbAttribs ) : _nbAttribs(nbAttribs)
+		explicit DataSet( size_t nbAttribs ) : _nbAttribs(nbAttribs), _vColumns(nbAttribs)
 		{
 			assert( nbAttribs );
 #ifdef HANDLE_MISSING_VALUES
 			DataSet::sv_MissingValueStrings.push_back("?");
+			_vMissing.resize( nbAttribs );
+			_vNbMissing.resize( nbAttribs );
 #endif
 //			g_params.p_dataset = this;
 		}
 
 		size_t size() const
-		{ return _data.size(); }
+		{ return isReadOnly() ? _snap.size : _vClass.size(); }
+
+/// Returns true if the dataset uses the columns of a mapped snapshot file, see loadSnapshot()
+		bool isReadOnly() const
+		{ return _snap.pMap != nullptr; }
 
 		size_t nbAttribs() const
 		{ return _nbAttribs; }
@@ -595,18 +1237,95 @@ class DataSet
 			if( size() )
 				throw std::runtime_error( "cannot set size if data set not empty" );
 			_nbAttribs = n;
+			_vColumns.resize( n );
+#ifdef HANDLE_MISSING_VALUES
+			_vMissing.resize( n );
+			_vNbMissing.resize( n );
+#endif
+		}
+
+		const_iterator begin() const
+		{
+			return const_iterator( *this, 0 );
+		}
+		const_iterator end() const
+		{
+			return const_iterator( *this, size() );
+		}
+
+/// \name Column access, this is what the training code uses
+///@{
+/// Returns a pointer on the first value of the column holding attribute \c atIdx (size is size())
+		const float* getColumn( size_t atIdx ) const
+		{
+			assert( atIdx < _vColumns.size() );
+			return isReadOnly() ? _snap.vColumns[atIdx] : _vColumns[atIdx].data();
+		}
+/// Returns a pointer on the first value of the class column (size is size())
+		const ClassVal* getClassColumn() const
+		{
+			return isReadOnly() ? _snap.pClass : _vClass.data();
+		}
+/// Returns a pointer on the first value of the class index column (size is size()): for each point, the index of its class
+/// (see getClassIndexMap()), or \ref NoClassIndex if classless
+		const ClassIndex* getClassIndexColumn() const
+		{
+			p_updateClassIndex();
+			return _vClassIdx.data();
+		}
+/// Returns a pointer on the first value of the flag column (size is size()), see EN_PointFlag
+		const uint8_t* getFlagColumn() const
+		{
+			return _vFlags.data();
+		}
+		ClassVal classVal( size_t idx ) const
+		{
+			assert( idx < size() );
+			return getClassColumn()[idx];
+		}
+		bool isClassLess( size_t idx ) const
+		{
+			assert( idx < size() );
+			return getClassColumn()[idx] == ClassVal(-1);
 		}
+///@}
 
-		std::vector<DataPoint>::const_iterator
-		begin() const
+#ifdef HANDLE_MISSING_VALUES
+/// \name Missing values (only enabled if \c HANDLE_MISSING_VALUES defined, see build options)
+///@{
+/// Returns the missing values bitmap of attribute \c atIdx (bit \c i is set if value of point \c i is missing),
+/// or nullptr if that attribute has no missing values, so the caller can skip the check
+		const uint64_t* getMissingBitmap( size_t atIdx ) const
 		{
-			return _data.begin();
+			assert( atIdx < nbAttribs() );
+			if( _vNbMissing[atIdx] == 0 )
+				return nullptr;
+			return isReadOnly() ? _snap.vMissing[atIdx] : _vMissing[atIdx].data();
 		}
-		std::vector<DataPoint>::const_iterator
-		end() const
+/// Returns true if attribute \c atIdx has some missing values
+		bool attribHasMissingValues( size_t atIdx ) const
 		{
-			return _data.end();
+			assert( atIdx < nbAttribs() );
+			return _vNbMissing[atIdx] != 0;
 		}
+/// Returns true if attribute \c atIdx of point \c idx is missing
+		bool valueIsMissing( size_t idx, size_t atIdx ) const
+		{
+			assert( idx < size() );
+			auto bm = getMissingBitmap( atIdx );
+			return bm && priv::testBit( bm, idx );
+		}
+/// Returns the nb of missing values of point \c idx
+		size_t nbMissingValues( size_t idx ) const
+		{
+			assert( idx < size() );
+			size_t nb = 0;
+			for( size_t at=0; at<nbAttribs(); at++ )
+				nb += valueIsMissing( idx, at );
+			return nb;
+		}
+///@}
+#endif
 
 //		template<typename U>
 		void addPoint( const DataPoint& dp )
@@ -620,7 +1339,7 @@ class DataSet
 					+ " dataset=" + std::to_string( _nbAttribs )
 				);
 #endif // DTCPP_ERRORS_ASSERT
-			_data.push_back( dp );
+			p_addRow( dp );
 			if( !dp.isClassLess() )
 //			if( dp.classVal().get() >= 0 )
 				_classCount[ dp.classVal() ]++;
@@ -631,30 +1350,28 @@ class DataSet
 			_cimIsUpToDate = false;
 		}
 
+/// Returns a row view on point \c idx (see DataPoint)
 //		template<typename U>
-		DataPoint& getDataPoint( size_t idx )
+		DataPoint getDataPoint( size_t idx ) const
 		{
 #ifdef DTCPP_ERRORS_ASSERT
-			assert( idx < _data.size() );
+			assert( idx < size() );
 #else
-			if( idx >= _data.size() )
+			if( idx >= size() )
 				throw std::runtime_error(
 					"idx=" + std::to_string( idx )
-					+ " dataset size=" + std::to_string( _data.size() )
+					+ " dataset size=" + std::to_string( size() )
 				);
 
 #endif // DTCPP_ERRORS_ASSERT
-
-			return _data[idx];
-		}
-//		template<typename U>
-		const DataPoint& getDataPoint( size_t idx ) const
-		{
-			assert( idx < _data.size() );
-			return _data[idx];
+			return DataPoint( *this, idx, classVal(idx) );
 		}
 
 		bool load( std::string fname, const Fparams=Fparams() );
+		bool saveSnapshot( const std::string& fname, const DatasetStats<float>* pStats=nullptr ) const;
+		static bool createSnapshot( const std::string& dataFile, const std::string& snapFile, const Fparams&, size_t blockSize=1<<20 );
+		bool loadSnapshot( const std::string& fname, const Fparams& params );
+		bool getSnapshotStats( DatasetStats<float>& ) const;
 		void print( std::ostream& ) const;
 		void print( std::ostream&, const std::vector<uint>& ) const;
 		void printInfo( std::ostream&, const char* name=0 ) const;
@@ -664,7 +1381,7 @@ class DataSet
 
 		void clear()
 		{
-			_data.clear();
+			p_clearColumns();
 			_classCount.clear();
 			_classStringIndexBimap.clear();
 
@@ -675,15 +1392,12 @@ class DataSet
 			clearOutliers();
 #endif
 		}
-		std::pair<DataSet,DataSet> getFolds( uint i, uint nbFolds ) const;
+		std::pair<DataSetView,DataSetView> getFolds( uint i, uint nbFolds ) const;
+		std::pair<DataSetView,DataSetView> getStratifiedFolds( uint i, uint nbFolds ) const;
 
-/// Shuffle the data (taken from https://stackoverflow.com/a/6926473/193789)
-		void shuffle()
-		{
-			std::shuffle(std::begin(_data), std::end(_data), std::random_device() );
-		}
+		void shuffle();
 		template<typename T>
-		DatasetStats<T> computeStats( uint nbBins ) const;
+		DatasetStats<T> computeStats( uint nbBins, const DatasetStats<T>* pStats=nullptr ) const;
 #ifdef HANDLE_OUTLIERS
 /// \name Outlier handling (only enabled if \c HANDLE_OUTLIERS defined, see build options)
 ///@{
@@ -693,23 +1407,20 @@ class DataSet
 /// Returns true if point has been tagged as outlier, see tagOutliers()
 		bool pointIsOutlier( size_t i ) const
 		{
-			if( _vIsOutlier.size() )
-			{
-				assert( i < _vIsOutlier.size() );
-				return _vIsOutlier[i];
-			}
-			return false;
+			assert( i < _vFlags.size() );
+			return _vFlags[i] & PF_Outlier;
 		}
 		void clearOutliers()
 		{
-			_vIsOutlier.clear();
+			for( auto& fl: _vFlags )
+				fl &= ~PF_Outlier;
 			_nbOutliers = 0;
 		}
 		size_t nbOutliers() const
 		{
 			return _nbOutliers;
 		}
-		DataSet getSetWithoutOutliers() const;
+		DataSetView getSetWithoutOutliers() const;
 ///@}
 #endif // HANDLE_OUTLIERS
 		size_t nbClasses( const std::vector<uint>& ) const;
@@ -720,15 +1431,9 @@ class DataSet
 			return _classCount.size();
 		}
 
-		ClassIndexMap getClassIndexMap() const
+		const ClassIndexMap& getClassIndexMap() const
 		{
-			if( !_cimIsUpToDate )
-			{
-				size_t i = 0;                            // for each class value, fill
-				for( const auto& cc: _classCount )       // the map with an incremental index
-					_classIndexMap.insert( ClassIndexMap::value_type( cc.first, i++ ) );
-				_cimIsUpToDate = true;
-			}
+			p_updateClassIndex();
 			return _classIndexMap;
 		}
 
@@ -748,7 +1453,7 @@ class DataSet
 		}
 		const ClassIndexMap& getIndexBimap() const
 		{
-			return _classIndexMap;
+			return getClassIndexMap();
 		}
 
 		void generateDataHtmlPage( std::ostream&, const DatasetStats<float>& stats, int nbBins ) const;
@@ -757,29 +1462,62 @@ class DataSet
 #ifdef HANDLE_OUTLIERS
 		void p_countClasses();
 #endif
+		void p_updateClassIndex() const;
 
 		template<typename T>
 		void p_generateAttribPlot( const std::string& otd, const DatasetStats<T>&, std::ostream& ) const;
 		void p_generateClassDistrib( std::string fname ) const;
 
-		void p_parseTokens( std::vector<std::string>&, const Fparams&, uint&, size_t );
+		void p_parseTokens( const Fparams&, priv::ParserState& );
+		bool p_parseLine( const char*, const char*, const Fparams&, priv::ParserState& );
+		bool p_loadStream( std::istream&, const Fparams&, priv::ParserState& );
+		bool p_loadBuffer( const char*, const char*, const Fparams&, priv::ParserState& );
+		bool p_loadBufferParallel( const char*, const char*, const Fparams&, priv::ParserState& );
+		void p_addRow( const DataPoint& );
+		void p_detachSnapshot();
+		void p_clearColumns();
+		bool p_writeSnapshotBlock( std::ostream&, const priv::SnapshotHeader&, size_t ) const;
+#ifdef HANDLE_MISSING_VALUES
+		void p_pushMissing( const std::vector<uint>& );
+#endif
+		void p_writeSnapshotTail( std::ostream&, priv::SnapshotHeader&, const DatasetStats<float>* ) const;
 		template<typename HISTO>
 		std::vector<std::pair<uint,uint>> p_countClassPerBin( size_t, const HISTO& ) const;
 
 	private:
+/// Read-only storage, used when data comes from a mapped snapshot file, see loadSnapshot()
+		struct SnapshotData
+		{
+			std::shared_ptr<const priv::MappedFile> pMap;      ///< shared between copies of the dataset
+			std::vector<const float*> vColumns;
+			const ClassVal*           pClass = nullptr;
+			const float*              pStats = nullptr;      ///< null if snapshot holds no stats
+#ifdef HANDLE_MISSING_VALUES
+		std::vector<const uint64_t*> vMissing;           ///< missing values bitmaps
+#endif
+			size_t                    size   = 0;
+		};
+
 		size_t                  _nbAttribs = 0;
-		std::vector<DataPoint>  _data;
+		SnapshotData            _snap;
+		std::vector<AttribColumn> _vColumns;            ///< attribute values, one column per attribute
+		std::vector<ClassVal>   _vClass;                ///< class column (-1 for classless points)
+		std::vector<uint8_t>    _vFlags;                ///< flag column, see EN_PointFlag
+#ifdef HANDLE_MISSING_VALUES
+		std::vector<std::vector<uint64_t>> _vMissing;   ///< for each attribute, bitmap of the missing values (empty if none), see getMissingBitmap()
+		std::vector<size_t>     _vNbMissing;            ///< for each attribute, nb of missing values
+#endif
 		ClassStringIndexBiMap   _classStringIndexBimap;  ///< maps string labels to indexes
 		ClassCounter            _classCount;             ///< Holds the number of points for each class value. Does \b NOT count classless points
 		mutable ClassIndexMap   _classIndexMap;		     ///< holds correspondence between real class values (say, 1,4,7) and corresponding indexes (0,1,2)
-		mutable bool            _cimIsUpToDate = false;
+		mutable std::vector<ClassIndex> _vClassIdx;      ///< class index column, see getClassIndexColumn()
+		mutable bool            _cimIsUpToDate = false;  ///< if false, \ref _classIndexMap and \ref _vClassIdx need to be rebuilt
 		uint                    _nbNoClassPoints = 0u;
 		bool                    _noChange = false;
 		Fparams                 _fparams;               ///< stored here, because some flags might be useful after loading
 		bool                    _outlierTaggingDone = false;
 #ifdef HANDLE_OUTLIERS
 		size_t                  _nbOutliers = 0;        ///< to avoid recounting them when unneeded
-		std::vector<bool>       _vIsOutlier;            ///< Will be allocated ONLY if tagOutliers() is called, with En_OR_method::disablePoint
 #endif
 	public:
 		std::string             _fname;                 ///< file name (saved so it can be printed in output files)
@@ -788,11 +1526,68 @@ class DataSet
 /** If we find any of these in a input data file, then the considered attribute for the considered datapoint will be tagged as "missing" */
 		static std::vector<std::string> sv_MissingValueStrings;
 		static En_MVS                   s_MissingValueStrategy;
+		static bool isMissingValueString( boost::string_view );
 #endif
 };
 //using DataSetf = DataSet<float>;
 //using DataSetd = DataSet<double>;
 
+//---------------------------------------------------------------------
+/// A subset of a DataSet, given as a reference on the parent dataset and an array of point indexes
+/**
+This is used for folds, shuffling and outlier-free subsets, so that the points never get copied:
+such a view only costs one index per point.
+TrainingTree::train() and TrainingTree::classify() accept views as well as datasets.
+
+\warning The parent dataset must outlive the view, and must not be modified while the view is used.
+*/
+class DataSetView
+{
+	public:
+/// Constructor, view holds all the points of \c ds, in the same order
+		explicit DataSetView( const DataSet& ds );
+/// Constructor, view holds the points of \c ds given by the indexes in \c vIdx
+		DataSetView( const DataSet& ds, std::vector<uint> vIdx )
+			: _pDataSet(&ds), _vIdx( std::move(vIdx) )
+		{}
+
+		size_t size() const
+		{
+			return _vIdx.size();
+		}
+		size_t nbAttribs() const;
+/// Returns the dataset this view is built on
+		const DataSet& parent() const
+		{
+			return *_pDataSet;
+		}
+/// Returns the indexes of the points, in the parent dataset
+		const std::vector<uint>& getIndexes() const
+		{
+			return _vIdx;
+		}
+/// Returns the index in the parent dataset of point \c idx
+		uint parentIndex( size_t idx ) const
+		{
+			assert( idx < size() );
+			return _vIdx[idx];
+		}
+		DataPoint getDataPoint( size_t idx ) const;
+		size_t nbClasses() const;
+		size_t getClassCount( ClassVal ) const;
+
+		void shuffle();
+		std::pair<DataSetView,DataSetView> getFolds( uint i, uint nbFolds ) const;
+		std::pair<DataSetView,DataSetView> getStratifiedFolds( uint i, uint nbFolds ) const;
+#ifdef HANDLE_OUTLIERS
+		DataSetView getSetWithoutOutliers() const;
+#endif
+
+	private:
+		const DataSet*    _pDataSet;
+		std::vector<uint> _vIdx;       ///< indexes of the points in the parent dataset
+};
+
 
 //---------------------------------------------------------------------
 #ifdef HANDLE_MISSING_VALUES
@@ -801,20 +1596,65 @@ En_MVS                   DataSet::s_MissingValueStrategy = En_MVS::disablePoint;
 
 /// Used when loading the data into memory
 bool
-DataPoint::isMissingValue( const std::string& str ) const
+DataSet::isMissingValueString( boost::string_view str )
 {
 	for( const auto& mvs: DataSet::sv_MissingValueStrings )
 		if( mvs == str )
 			return true;
 	return false;
 }
+
+bool
+DataPoint::isMissingValue( const std::string& str ) const
+{
+	return DataSet::isMissingValueString( str );
+}
+#endif
+//---------------------------------------------------------------------
+#ifdef HANDLE_MISSING_VALUES
+size_t
+DataPoint::nbMissingValues() const
+{
+	if( isView() )
+		return _pDataSet->nbMissingValues( _rowIdx );
+	return _missingValues.size();
+}
+
+bool
+DataPoint::valueIsMissing( size_t idx ) const
+{
+	assert( idx < nbAttribs() );
+	if( isView() )
+		return _pDataSet->valueIsMissing( _rowIdx, idx );
+	return std::binary_search( _missingValues.begin(), _missingValues.end(), static_cast<uint>(idx) );
+}
 #endif
+//---------------------------------------------------------------------
+inline
+size_t
+DataPoint::nbAttribs() const
+{
+	if( isView() )
+		return _pDataSet->nbAttribs();
+	return _attrValue.size();
+}
+
+inline
+float
+DataPoint::attribVal( size_t idx ) const
+{
+	assert( idx<nbAttribs() );
+	if( isView() )
+		return _pDataSet->getColumn( idx )[_rowIdx];
+	return _attrValue[idx];
+}
+
 //---------------------------------------------------------------------
 void
 DataPoint::print( std::ostream& f ) const
 {
-	for( const auto& v: _attrValue )
-		f << v << ' ';
+	for( size_t i=0; i<nbAttribs(); i++ )
+		f << attribVal(i) << ' ';
 	if( g_params.p_dataset )
 	{
 		if( isClassLess() )
@@ -825,6 +1665,167 @@ DataPoint::print( std::ostream& f ) const
 	f << '\n';
 }
 
+//---------------------------------------------------------------------
+/// Appends a point at the end of all the columns. Does not update the class counters, see addPoint()
+void
+DataSet::p_addRow( const DataPoint& dp )
+{
+	assert( dp.nbAttribs() == _nbAttribs );
+	if( isReadOnly() )
+		p_detachSnapshot();
+	for( size_t i=0; i<_nbAttribs; i++ )
+		_vColumns[i].push_back( dp.attribVal(i) );
+	_vClass.push_back( dp._class );
+	_vFlags.push_back( PF_None );
+#ifdef HANDLE_MISSING_VALUES
+	if( dp.isView() )
+	{
+		std::vector<uint> vMissing;
+		for( size_t at=0; at<_nbAttribs; at++ )
+			if( dp._pDataSet->attribHasMissingValues( at ) && dp.valueIsMissing( at ) )
+				vMissing.push_back( static_cast<uint>(at) );
+		p_pushMissing( vMissing );
+	}
+	else
+		p_pushMissing( dp._missingValues );
+#endif
+}
+#ifdef HANDLE_MISSING_VALUES
+//---------------------------------------------------------------------
+/// Registers the attributes \c vAt as missing for the last point added
+/**
+The bitmaps of attributes that have some missing values always hold enough words for all the points,
+the other ones are empty.
+*/
+void
+DataSet::p_pushMissing( const std::vector<uint>& vAt )
+{
+	assert( size() );
+	auto row = size()-1;
+	if( row % 64 == 0 )                 // first point of a new word
+		for( auto& bm: _vMissing )
+			if( !bm.empty() )
+				bm.push_back( 0u );
+	for( auto at: vAt )
+	{
+		auto& bm = _vMissing[at];
+		if( bm.empty() )
+			bm.resize( row/64 + 1, 0u );
+		bm[row/64] |= uint64_t(1) << (row%64);
+		_vNbMissing[at]++;
+	}
+}
+#endif
+//---------------------------------------------------------------------
+/// Removes all the points, but keeps the class counters and the string labels, see clear()
+void
+DataSet::p_clearColumns()
+{
+	_snap = SnapshotData();
+	for( auto& col: _vColumns )
+		col.clear();
+	_vClass.clear();
+	_vFlags.clear();
+#ifdef HANDLE_MISSING_VALUES
+	for( auto& bm: _vMissing )
+		bm.clear();
+	std::fill( _vNbMissing.begin(), _vNbMissing.end(), 0u );
+#endif
+}
+//---------------------------------------------------------------------
+/// Copies the columns of the mapped snapshot file in memory, so that the dataset can be modified, see loadSnapshot()
+void
+DataSet::p_detachSnapshot()
+{
+	assert( isReadOnly() );
+	START;
+	auto snap = std::move( _snap );
+	_snap = SnapshotData();
+	for( size_t at=0; at<_nbAttribs; at++ )
+		_vColumns[at].assign( snap.vColumns[at], snap.vColumns[at] + snap.size );
+	_vClass.assign( snap.pClass, snap.pClass + snap.size );
+#ifdef HANDLE_MISSING_VALUES
+	for( size_t at=0; at<_nbAttribs; at++ )
+		if( _vNbMissing[at] )
+			_vMissing[at].assign( snap.vMissing[at], snap.vMissing[at] + (snap.size+63)/64 );
+#endif
+}
+//---------------------------------------------------------------------
+/// Shuffle the data (taken from https://stackoverflow.com/a/6926473/193789)
+/**
+As data is stored by columns, we shuffle a vector of indexes and apply the permutation on each column.
+
+\sa DataSetView::shuffle(), that only shuffles the indexes and moves no data
+*/
+void
+DataSet::shuffle()
+{
+	if( isReadOnly() )
+		p_detachSnapshot();
+	std::vector<size_t> vperm( size() );
+	std::iota( vperm.begin(), vperm.end(), 0 );
+	std::shuffle( std::begin(vperm), std::end(vperm), std::random_device() );
+
+	auto applyPerm = [&vperm]( auto& col )     // lambda
+	{
+		typename std::remove_reference<decltype(col)>::type col2( col.size() );
+		for( size_t i=0; i<vperm.size(); i++ )
+			col2[i] = std::move( col[vperm[i]] );
+		col = std::move( col2 );
+	};
+	for( auto& col: _vColumns )
+		applyPerm( col );
+	applyPerm( _vClass );
+	applyPerm( _vFlags );
+	_cimIsUpToDate = false;
+#ifdef HANDLE_MISSING_VALUES
+	for( auto& bm: _vMissing )
+		if( !bm.empty() )
+		{
+			std::vector<uint64_t> bm2( bm.size(), 0u );
+			for( size_t i=0; i<vperm.size(); i++ )
+				if( priv::testBit( bm.data(), vperm[i] ) )
+					bm2[i/64] |= uint64_t(1) << (i%64);
+			bm = std::move( bm2 );
+		}
+#endif
+}
+//---------------------------------------------------------------------
+/// Builds (if needed) the class index map and the class index column
+/**
+Indexes follow the class values order. Points whose class is not counted (outliers, see p_countClasses())
+get \ref NoClassIndex, as classless points.
+*/
+void
+DataSet::p_updateClassIndex() const
+{
+	if( _cimIsUpToDate )
+		return;
+	if( _classCount.size() >= NoClassIndex )
+		throw std::runtime_error( "too many classes: " + std::to_string( _classCount.size() ) );
+
+	_classIndexMap.clear();
+	size_t i = 0;                            // for each class value, fill
+	for( const auto& cc: _classCount )       // the map with an incremental index
+		_classIndexMap.insert( ClassIndexMap::value_type( cc.first, i++ ) );
+
+	const auto* classCol = getClassColumn();
+	_vClassIdx.resize( size() );
+	ClassVal   prevVal(-1);                  // consecutive points often have the same class,
+	ClassIndex prevIdx = NoClassIndex;       // so we avoid a lookup in that case
+	for( size_t p=0; p<size(); p++ )
+	{
+		auto cval = classCol[p];
+		if( cval != prevVal )
+		{
+			auto it = _classIndexMap.left.find( cval );
+			prevIdx = ( it == _classIndexMap.left.end() ? NoClassIndex : static_cast<ClassIndex>( it->second ) );
+			prevVal = cval;
+		}
+		_vClassIdx[p] = prevIdx;
+	}
+	_cimIsUpToDate = true;
+}
 //---------------------------------------------------------------------
 uint
 DataSet::getIndexFromClass( ClassVal cval ) const
@@ -942,12 +1943,12 @@ DataSet::p_countClassPerBin( size_t attrIdx, const HISTO& histo ) const
 	auto nbBins = histo.size();
 	std::vector<std::set<ClassVal>> classSets( nbBins ); // one set of classes per bin
 
+	const auto* col = getColumn( attrIdx );
 	for(size_t idx=0; idx<size(); idx++ )
 	{
-		const auto& pt = getDataPoint(idx);        // for each data point
-		auto attribVal = pt.attribVal( attrIdx );  // get attribute value
+		auto attribVal = col[idx];                 // get attribute value
 
-		if( !pt.isClassLess() )                    // if not classless, then
+		if( !isClassLess(idx) )                    // if not classless, then
 #ifdef HANDLE_OUTLIERS
 			if( !pointIsOutlier(idx) )             // AND not an outlier,
 #endif
@@ -956,7 +1957,7 @@ DataSet::p_countClassPerBin( size_t attrIdx, const HISTO& histo ) const
 			for (auto&& x : boost::histogram::indexed(histo) )
 			{
 				if( attribVal > x.bin().lower() && attribVal <= x.bin().upper() )
-					classSets[i].insert( pt.classVal() );
+					classSets[i].insert( classVal(idx) );
 				i++;
 			}
 		}
@@ -1047,17 +2048,16 @@ DataSet::p_countClasses()
 	_classCount.clear();
 	for( size_t p=0; p<size(); p++ )
 	{
-		const auto& pt = getDataPoint(p);
-
 		if( !pointIsOutlier(p) )
 		{
-			if( pt.isClassLess() )
+			if( isClassLess(p) )
 				_nbNoClassPoints++;
 			else
-				_classCount[ pt.classVal() ]++;
+				_classCount[ classVal(p) ]++;
 		}
 	}
 	_noChange = true;
+	_cimIsUpToDate = false;
 }
 //---------------------------------------------------------------------
 /// Search and tag for outliers in the dataset. The exact action taken depends on \c orm
@@ -1071,30 +2071,26 @@ template<typename T>
 void
 DataSet::tagOutliers( const DatasetStats<T>& stats, En_OD_method odm, En_OR_method orm, float param )
 {
-	_nbOutliers = 0;
-	if( orm == En_OR_method::disablePoint )
-	{
-		_vIsOutlier.resize( size() );
-		std::fill( _vIsOutlier.begin(), _vIsOutlier.end(), false );
-	}
+	clearOutliers();
 	for( size_t p=0; p<size(); p++ )
 	{
 		bool ptDisabled = false;
-		auto& pt = getDataPoint(p);
 		for( size_t i=0; i<nbAttribs() && !ptDisabled; i++ )  // loop through all attributes
 		{                                                           // but stop if point is already disabled
-			auto& atval = pt.attribVal(i);
+			auto atval = getColumn(i)[p];
 			if( attribIsOutlier( atval, stats.get(i), odm, param ) )
 			{
 				_nbOutliers++;
 				switch( orm )
 				{
 					case En_OR_method::disablePoint:
-						_vIsOutlier.at(p) = true;
+						_vFlags.at(p) |= PF_Outlier;
 						ptDisabled = true;
 					break;
 					case En_OR_method::replaceWithMean:
-						atval = stats.get(i)._meanVal;
+						if( isReadOnly() )
+							p_detachSnapshot();
+						_vColumns[i][p] = stats.get(i)._meanVal;
 					break;
 					default: assert(0);
 				}
@@ -1108,11 +2104,14 @@ DataSet::tagOutliers( const DatasetStats<T>& stats, En_OD_method odm, En_OR_meth
 /// Compute statistics of the dataset, attribute by attribute, and saves histogram in data files.
 /// Also generates a Gnuplot script to plot these.
 /**
-Done by storing for a given attribute all the values in a vector, then computing stats on that vector
+Done by storing for a given attribute all the values in a vector, then computing stats on that vector.
+
+If \c pStats is given (for example the stats of a snapshot file, see getSnapshotStats()), these are used and returned
+instead, and only the histograms are computed.
 */
 template<typename T>
 DatasetStats<T>
-DataSet::computeStats( uint nbBins ) const
+DataSet::computeStats( uint nbBins, const DatasetStats<T>* pStats ) const
 {
 	START;
 	auto fplot = priv::openOutputFile( "attrib_histo", priv::FT_PLT, _fname );
@@ -1129,35 +2128,34 @@ DataSet::computeStats( uint nbBins ) const
 	{
 		std::vector<float> vat;
 		vat.reserve( size() );               // guarantees we won't have any reallocating
+		const auto* col = getColumn( atIdx );
+#ifdef HANDLE_MISSING_VALUES
+		const auto* missBm = getMissingBitmap( atIdx );
+#endif
 #ifdef HANDLE_OUTLIERS
 		if( nbOutliers() == 0 )
 #endif
-			for( const auto& point: _data )
+			for( size_t ptIdx=0; ptIdx<size(); ptIdx++ )
 			{
 #ifdef HANDLE_MISSING_VALUES
-				if( !point.valueIsMissing( atIdx ) )
+				if( !missBm || !priv::testBit( missBm, ptIdx ) )
 #endif
-				vat.push_back( point.attribVal(atIdx) );
+				vat.push_back( col[ptIdx] );
 			}
 #ifdef HANDLE_OUTLIERS
 		else
-#endif
-
 			for( size_t ptIdx=0; ptIdx<size(); ptIdx++ )
 			{
-				const auto& point = getDataPoint(ptIdx);
-
-#ifdef HANDLE_OUTLIERS
 				if( !pointIsOutlier(ptIdx) )
-#endif
 #ifdef HANDLE_MISSING_VALUES
-				if( !point.valueIsMissing( atIdx ) )
+				if( !missBm || !priv::testBit( missBm, ptIdx ) )
 #endif
-					vat.push_back( point.attribVal(atIdx) );
+					vat.push_back( col[ptIdx] );
 			}
+#endif
 
 
-		const auto& atstats = computeAttribStats<T>( vat );
+		const auto atstats = ( pStats ? pStats->get( atIdx ) : computeAttribStats<T>( vat ) );
 		dstats.add( atIdx, atstats );
 
 		auto histo = genAttribHisto( atIdx, vat, atstats, nbBins, _fname, size() );
@@ -1189,30 +2187,17 @@ DataSet::nbClasses( const std::vector<uint>& vIdx ) const
 {
 	std::set<ClassVal> classSet;
 	for( const auto idx: vIdx )
-	{
-		const auto& pt = getDataPoint( idx );
-		if( !pt.isClassLess() )
-			classSet.insert( pt.classVal() );
-	}
+		if( !isClassLess(idx) )
+			classSet.insert( classVal(idx) );
 	return classSet.size();
 }
 //---------------------------------------------------------------------
 #ifdef HANDLE_OUTLIERS
-/// Returns dataset without the outliers (assumes they have been tagged before!)
-DataSet
+/// Returns a view on the dataset without the outliers (assumes they have been tagged before!)
+DataSetView
 DataSet::getSetWithoutOutliers() const
 {
-	if( nbOutliers() )
-	{
-		DataSet newset( nbAttribs() );
-		newset._data.reserve( size() );   // to avoid reallocation
-		for( size_t i=0; i<size(); i++ )
-			if( !pointIsOutlier(i) )
-				newset._data.push_back( getDataPoint(i) );
-		return newset;
-	}
-	else                           // if no outliers,
-		return DataSet(*this);     // then return a copy
+	return DataSetView(*this).getSetWithoutOutliers();
 }
 #endif
 //---------------------------------------------------------------------
@@ -1226,31 +2211,152 @@ and the training set will hold the rest of the points.
 The \c index defines which fraction of the points are returned in the test set
 
 If some points have been tagged as outliers, then they will \b not be included in the two returned sets.
+
+The two sets are views on this dataset, see DataSetView.
 */
-std::pair<DataSet,DataSet>
+std::pair<DataSetView,DataSetView>
 DataSet::getFolds( uint index, uint nbFolds ) const
 {
- 	DataSet ds_train( nbAttribs() );
- 	DataSet ds_test(  nbAttribs() );
+	return DataSetView(*this).getFolds( index, nbFolds );
+}
+//---------------------------------------------------------------------
+/// Same as getFolds(), but each class is spread evenly over the folds, see DataSetView::getStratifiedFolds()
+std::pair<DataSetView,DataSetView>
+DataSet::getStratifiedFolds( uint index, uint nbFolds ) const
+{
+	return DataSetView(*this).getStratifiedFolds( index, nbFolds );
+}
+
+//---------------------------------------------------------------------
+DataSetView::DataSetView( const DataSet& ds ) : _pDataSet(&ds), _vIdx( ds.size() )
+{
+	std::iota( _vIdx.begin(), _vIdx.end(), 0 );
+}
+
+size_t
+DataSetView::nbAttribs() const
+{
+	return _pDataSet->nbAttribs();
+}
+
+/// Returns point \c idx of the view (a row view on the parent dataset)
+DataPoint
+DataSetView::getDataPoint( size_t idx ) const
+{
+	return _pDataSet->getDataPoint( parentIndex( idx ) );
+}
+
+/// Returns nb of classes in the view, \b NOT considering the points without any class assigned
+size_t
+DataSetView::nbClasses() const
+{
+	return _pDataSet->nbClasses( _vIdx );
+}
+
+/// Returns the number of points with class \c val (or number of non-assigned points if \c val=-1)
+size_t
+DataSetView::getClassCount( ClassVal val ) const
+{
+	return std::count_if(
+		_vIdx.begin(),
+		_vIdx.end(),
+		[&]( uint idx ){ return _pDataSet->classVal( idx ) == val; }
+	);
+}
+//---------------------------------------------------------------------
+/// Shuffle the points of the view. Only the indexes are shuffled, the parent dataset is left unchanged
+void
+DataSetView::shuffle()
+{
+	std::shuffle( std::begin(_vIdx), std::end(_vIdx), std::random_device() );
+}
 
 #ifdef HANDLE_OUTLIERS
-	DataSet ds2 = getSetWithoutOutliers();
+/// Returns the view without the points that have been tagged as outliers in the parent dataset
+DataSetView
+DataSetView::getSetWithoutOutliers() const
+{
+	std::vector<uint> vIdx;
+	if( _pDataSet->nbOutliers() )
+	{
+		vIdx.reserve( size() - std::min( size(), _pDataSet->nbOutliers() ) );
+		for( auto idx: _vIdx )
+			if( !_pDataSet->pointIsOutlier( idx ) )
+				vIdx.push_back( idx );
+	}
+	else
+		vIdx = _vIdx;
+	return DataSetView( *_pDataSet, std::move(vIdx) );
+}
+#endif
+//---------------------------------------------------------------------
+/// Returns a pair of two subsets of the view, first is the training data, second is the test data.
+/// See DataSet::getFolds()
+std::pair<DataSetView,DataSetView>
+DataSetView::getFolds( uint index, uint nbFolds ) const
+{
+#ifdef HANDLE_OUTLIERS
+	auto ds2 = getSetWithoutOutliers();
 #else
-	const DataSet& ds2 =*this;
+	const auto& ds2 = *this;
 #endif
 	uint nb = ds2.size() / nbFolds;
+	std::vector<uint> v_train, v_test;
+	v_test.reserve( nb );
+	v_train.reserve( ds2.size() - nb );
 	for( uint i=0; i<ds2.size(); i++ )
 	{
 		if( i / nb == index )
-			ds_test.addPoint( ds2.getDataPoint(i) );
+			v_test.push_back( ds2._vIdx[i] );
+		else
+			v_train.push_back( ds2._vIdx[i] );
+	}
+
+	COUT << "ds_test #=" << v_test.size()
+		<< " ds_train #=" << v_train.size() << "\n";
+
+	return std::make_pair(
+		DataSetView( *_pDataSet, std::move(v_train) ),
+		DataSetView( *_pDataSet, std::move(v_test) )
+	);
+}
+//---------------------------------------------------------------------
+/// Returns a pair of two subsets of the view, first is the training data, second is the test data,
+/// with each class spread evenly over the folds
+/**
+The points of each class (and the classless points) are dealt in turn to the \c nbFolds folds,
+following the order of the view, and fold \c index is returned as the test set.
+Thus, the class proportions are (up to one point per class) the same in both sets.
+
+If some points have been tagged as outliers, then they will \b not be included in the two returned sets.
+*/
+std::pair<DataSetView,DataSetView>
+DataSetView::getStratifiedFolds( uint index, uint nbFolds ) const
+{
+	assert( index < nbFolds );
+#ifdef HANDLE_OUTLIERS
+	auto ds2 = getSetWithoutOutliers();
+#else
+	const auto& ds2 = *this;
+#endif
+	std::map<ClassVal,uint> classRank;            // nb of points of each class seen so far
+	std::vector<uint> v_train, v_test;
+	for( auto idx: ds2._vIdx )
+	{
+		auto& rank = classRank[ _pDataSet->classVal( idx ) ];
+		if( rank++ % nbFolds == index )
+			v_test.push_back( idx );
 		else
-			ds_train.addPoint( ds2.getDataPoint(i) );
+			v_train.push_back( idx );
 	}
 
-	COUT << "ds_test #=" << ds_test.size()
-		<< " ds_train #=" << ds_train.size() << "\n";
+	COUT << "ds_test #=" << v_test.size()
+		<< " ds_train #=" << v_train.size() << "\n";
 
-	return std::make_pair( ds_train, ds_test );
+	return std::make_pair(
+		DataSetView( *_pDataSet, std::move(v_train) ),
+		DataSetView( *_pDataSet, std::move(v_test) )
+	);
 }
 
 //---------------------------------------------------------------------
@@ -1291,17 +2397,11 @@ DataSet::p_generateAttribPlot(
 	std::string fname = "class_attrib_" + ro;
 	auto f1 = priv::openOutputFile( fname, priv::FT_CSV, _fname );
 
+	for( size_t i=0; i<size(); i++ )
 #ifdef HANDLE_OUTLIERS
-	if( _vIsOutlier.size() )
-	{
-		for( size_t i=0; i<size(); i++ )
-			if( !_vIsOutlier[i] )
-				getDataPoint(i).print( f1 );
-	}
-	else
+		if( !pointIsOutlier(i) )
 #endif
-		for( const auto& pt: _data )
-			pt.print( f1 );
+			getDataPoint(i).print( f1 );
 	f1 << '\n';
 
 	fhtml << "<table><tr>\n";
@@ -1347,238 +2447,920 @@ DataSet::p_generateAttribPlot(
 }
 
 //---------------------------------------------------------------------
-/// Helper member function for DataSet::load()
+/// Helper member function for DataSet::load(), converts the tokens of a line and adds them as a new point.
+/**
+Values are written directly in the columns. In case of conversion failure, the partially written row is removed
+and an exception is thrown.
+*/
 void
 DataSet::p_parseTokens(
-	std::vector<std::string>&   v_tok,             ///< string tokens read on line
-	const Fparams&              params,            ///< parameters
-	uint&                       classIndexCounter, ///< the next index value for classes as strings
-	size_t                      nb_lines           ///< in case of error
+	const Fparams&       params,   ///< parameters
+	priv::ParserState&   pst       ///< parser state, holds the tokens
 )
 {
-	if( !params.dataFilesHoldsClass )
-		_data.push_back( DataPoint( v_tok ) );
-	else
+	const auto& v_tok = pst.v_tok;
+	size_t firstAt = ( params.dataFilesHoldsClass && params.classIsfirst ) ? 1 : 0;
+#ifdef HANDLE_MISSING_VALUES
+	pst.vMissing.clear();
+#endif
+	size_t atIdx = 0;
+	try
 	{
-		int classIndex = -1;
-		auto cla = v_tok.back();
-		if( params.classIsfirst )
-			cla = v_tok.front();
-
-		if( !params.classAsString )
+		for( ; atIdx<_nbAttribs; atIdx++ )
 		{
-			try
-			{
-				classIndex = std::stoi( cla );
-			}
-			catch( ... )
+			const auto& tok = v_tok[firstAt+atIdx];
+			double val = 0.;
+#ifdef HANDLE_MISSING_VALUES
+			if( isMissingValueString( tok ) )
+				pst.vMissing.push_back( static_cast<uint>(atIdx) );
+			else
+#endif
 			{
-				throw std::runtime_error( "Unable to convert string '" + cla + "' on line " + std::to_string(nb_lines) + " to an integer value" );
+				auto last = tok.data() + tok.size();
+				if( tok.empty() || priv::parseNumber( tok.data(), last, val ) != last )
+					throw std::runtime_error(
+						"unable to convert a string value -" + tok.to_string()
+						+ "- to float, on line " + std::to_string(pst.nb_lines)
+					);
 			}
+			_vColumns[atIdx].push_back( static_cast<float>(val) );
 		}
-		else
+
+		int classIndex = -1;
+		if( params.dataFilesHoldsClass )
 		{
-			auto it = _classStringIndexBimap.left.find( cla );
-			if( it == _classStringIndexBimap.left.end() )  // if not registered, then
+			const auto& cla = ( params.classIsfirst ? v_tok.front() : v_tok.back() );
+			if( !params.classAsString )
 			{
-				classIndex = classIndexCounter;
-				_classStringIndexBimap.insert( ClassStringIndexBiMap::value_type( cla, classIndexCounter) );             // new class, add it
-				classIndexCounter++;
+				auto last = cla.data() + cla.size();
+				if( priv::parseInt( cla.data(), last, classIndex ) != last )
+					throw std::runtime_error( "Unable to convert string '" + cla.to_string() + "' on line " + std::to_string(pst.nb_lines) + " to an integer value" );
 			}
 			else
-				classIndex = _classStringIndexBimap.left.at( cla );
+			{
+				pst.strBuf.assign( cla.data(), cla.size() );  // reuses the buffer capacity
+				auto it = _classStringIndexBimap.left.find( pst.strBuf );
+				if( it == _classStringIndexBimap.left.end() )  // if not registered, then
+				{
+					classIndex = pst.classIndexCounter;
+					_classStringIndexBimap.insert( ClassStringIndexBiMap::value_type( pst.strBuf, pst.classIndexCounter) );             // new class, add it
+					pst.classIndexCounter++;
+				}
+				else
+					classIndex = it->second;
+			}
+			if( classIndex < 0 )
+				_nbNoClassPoints++;
+			else
+				_classCount[ ClassVal(classIndex) ]++;
 		}
-		if( classIndex < 0 )
-			_nbNoClassPoints++;
-
-		else
-			_classCount[ ClassVal(classIndex) ]++;
-
-		if( params.classIsfirst )
-			std::rotate( v_tok.begin(), v_tok.begin()+1, v_tok.end() );
-		v_tok.erase( v_tok.end()-1 );   // remove last element (class)
-		_data.push_back( DataPoint( v_tok, ClassVal(classIndex) ) );
+		_vClass.push_back( ClassVal(classIndex) );
+		_vFlags.push_back( PF_None );
+#ifdef HANDLE_MISSING_VALUES
+		p_pushMissing( pst.vMissing );
+#endif
+	}
+	catch( ... )                        // remove the values already added for this point
+	{
+		for( size_t i=0; i<atIdx; i++ )
+			_vColumns[i].pop_back();
+		throw;
 	}
 }
 //---------------------------------------------------------------------
-/// Load data file into memory, returns false on failure
-//template<typename T>
+/// Helper member function for DataSet::load(), handles a line of the input file, given as [first,last)
+/**
+\return false on error
+*/
 bool
-DataSet::load( std::string fname, const Fparams params )
+DataSet::p_parseLine(
+	const char*          first,
+	const char*          last,
+	const Fparams&       params,  ///< parameters
+	priv::ParserState&   pst      ///< parser state
+)
 {
-	std::ifstream f( fname );
-	if( !f.is_open() )
+	pst.nb_lines++;
+	if( params.firstLineLabels && pst.nb_lines == 1 )
+		return true;
+
+	if( first != last && *(last-1) == '\r' )     // in case of Windows-style line endings
+		last--;
+	if( first == last )          // if empty
+	{
+		pst.nb_empty++;
+		return true;
+	}
+	if( *first == '#' )          // if comment
+	{
+		pst.nb_comment++;
+		return true;
+	}
+
+	priv::splitLine( first, last, params.sep, pst.v_tok );
+	if( pst.v_tok.size() < 2 )
 	{
-		std::cerr << "Unable to open file " << fname << "\n";
+		if( !pst.quiet )
+			std::cerr << "-Error: only one value on line " << pst.nb_lines
+				<< "\n-Line=" << std::string( first, last ) << " \n-length=" << last - first << '\n';
 		return false;
 	}
-	_fparams = params;
-	_fname   = fname;
-	clear();
 
-	uint classIndexCounter = 0;
+	auto nbAtt = ( params.dataFilesHoldsClass ? pst.v_tok.size()-1 : pst.v_tok.size() );
+	if( pst.nbAttribs == 0 )             // if this is the first datapoint, then set the nb of attributes
+	{
+		setNbAttribs( nbAtt );
+		pst.nbAttribs = nbAtt;
+	}
+	if( nbAtt != pst.nbAttribs )
+	{
+		if( !pst.quiet )
+			std::cerr << "-Error: line " << pst.nb_lines << " holds " << nbAtt
+				<< " attribute values, expected " << pst.nbAttribs
+				<< "\n-Line=" << std::string( first, last ) << '\n';
+		return false;
+	}
 
-	size_t nb_lines     = 0;
-	size_t nb_empty     = 0;
-	size_t nb_comment   = 0;
+	p_parseTokens( params, pst );
+	return true;
+}
+//---------------------------------------------------------------------
+/// Helper member function for DataSet::load(), reads data from a stream, line by line
+bool
+DataSet::p_loadStream( std::istream& f, const Fparams& params, priv::ParserState& pst )
+{
+	std::string line;            // declared outside the loop, so its capacity gets reused
 	do
 	{
-		std::string temp;
-		std::getline( f, temp );
-		nb_lines++;
+		std::getline( f, line );
+		if( !p_parseLine( line.data(), line.data() + line.size(), params, pst ) )
+			return false;
+	}
+	while( !f.eof() );
+	return true;
+}
+//---------------------------------------------------------------------
+/// Helper member function for DataSet::load(), reads data from a memory buffer (the mapped file)
+/**
+Lines are found by scanning the buffer, and are parsed in place, without any copy
+*/
+bool
+DataSet::p_loadBuffer( const char* first, const char* last, const Fparams& params, priv::ParserState& pst )
+{
+	while( true )
+	{
+		auto eol = static_cast<const char*>( std::memchr( first, '\n', last - first ) );
+		if( !p_parseLine( first, ( eol ? eol : last ), params, pst ) )
+			return false;
+		if( !eol )
+			break;
+		first = eol + 1;
+	}
+	return true;
+}
+//---------------------------------------------------------------------
+/// Helper member function for DataSet::load(), parses the buffer [first,last) using several threads
+/**
+- The buffer is split into (at most) Fparams::nbThreads byte ranges, aligned on line ends,
+and no smaller than \c DTCPP_MIN_CHUNK_SIZE.
+- Each range is parsed on its own thread into a local dataset.
+- These are then merged in order into the current dataset.
+String class labels get the same indexes as with the sequential parsing, as they are registered
+in order of first appearance in the file.
+
+If parsing of any chunk fails, the whole buffer is parsed again sequentially, so that the
+error message holds the correct line number.
+*/
+bool
+DataSet::p_loadBufferParallel( const char* first, const char* last, const Fparams& params, priv::ParserState& pst )
+{
+	START;
+	size_t bufSize  = last - first;
+	size_t nbChunks = std::min( (size_t)params.nbThreads, 1 + bufSize / DTCPP_MIN_CHUNK_SIZE );
+	if( nbChunks < 2 )
+		return p_loadBuffer( first, last, params, pst );
+
+	std::vector<const char*> vBound( 1, first );              // chunk boundaries, just after a line end
+	for( size_t i=1; i<nbChunks; i++ )
+	{
+		auto pos = std::max( first + i*bufSize/nbChunks, vBound.back() );
+		auto eol = static_cast<const char*>( std::memchr( pos, '\n', last - pos ) );
+		if( eol && eol+1 < last && eol+1 > vBound.back() )
+			vBound.push_back( eol+1 );
+	}
+	vBound.push_back( last );
+	nbChunks = vBound.size()-1;
+	LOG( 2, "parsing file using " << nbChunks << " chunks" );
+
+	std::vector<DataSet>           vChunk( nbChunks );  // constructed here because the constructor is not thread-safe
+	std::vector<priv::ParserState> vPst( nbChunks );
+	for( auto& chpst: vPst )
+		chpst.quiet = true;
+	std::vector<char>              vSuccess( nbChunks, 0 );
+	std::vector<std::thread>       vThreads;
+	for( size_t i=0; i<nbChunks; i++ )
+		vThreads.emplace_back(
+			[&,i]()                                      // lambda
+			{
+				auto chparams = params;
+				if( i != 0 )
+					chparams.firstLineLabels = false;
+				auto chlast = vBound[i+1];
+				if( i != nbChunks-1 )  // remove the line end, so we don't get an additional empty line
+					chlast--;
+				try
+				{
+					vSuccess[i] = vChunk[i].p_loadBuffer( vBound[i], chlast, chparams, vPst[i] );
+				}
+				catch( ... )
+				{}
+			}
+		);
+	for( auto& th: vThreads )
+		th.join();
+
+	size_t nbAtt = 0;
+	std::vector<size_t> vOffset( 1, 0u );
+	bool success = true;
+	for( size_t i=0; i<nbChunks; i++ )
+	{
+		if( !vSuccess[i] )
+			success = false;
+		if( vChunk[i].size() )
+		{
+			if( nbAtt == 0 )
+				nbAtt = vChunk[i].nbAttribs();
+			if( vChunk[i].nbAttribs() != nbAtt )
+				success = false;
+		}
+		vOffset.push_back( vOffset.back() + vChunk[i].size() );
+	}
+	if( !success )
+	{
+		LOG( 2, "parallel parsing failed, parsing again sequentially" );
+		return p_loadBuffer( first, last, params, pst );
+	}
 
-		if( !params.firstLineLabels || nb_lines != 1 )
+// register the string labels in order of appearance, and build the index remapping for each chunk
+	std::vector<std::vector<int>> vRemap( nbChunks );
+	for( size_t i=0; i<nbChunks; i++ )
+	{
+		const auto& chbim = vChunk[i]._classStringIndexBimap;
+		vRemap[i].resize( chbim.size() );
+		for( size_t li=0; li<chbim.size(); li++ )   // local indexes are in order of appearance in the chunk
 		{
-			if( temp.empty() )          // if empty
-				nb_empty++;
-			else                        // if NOT empty
+			const auto& label = chbim.right.at( li );
+			auto it = _classStringIndexBimap.left.find( label );
+			if( it == _classStringIndexBimap.left.end() )
+			{
+				vRemap[i][li] = pst.classIndexCounter;
+				_classStringIndexBimap.insert( ClassStringIndexBiMap::value_type( label, pst.classIndexCounter ) );
+				pst.classIndexCounter++;
+			}
+			else
+				vRemap[i][li] = it->second;
+		}
+		for( const auto& cc: vChunk[i]._classCount )
+			_classCount[ params.classAsString ? ClassVal( vRemap[i][cc.first.get()] ) : cc.first ] += cc.second;
+		_nbNoClassPoints += vChunk[i]._nbNoClassPoints;
+		pst.nb_lines   += vPst[i].nb_lines;
+		pst.nb_empty   += vPst[i].nb_empty;
+		pst.nb_comment += vPst[i].nb_comment;
+	}
+
+// merge the columns, each chunk being copied by its own thread
+	auto nbPts = vOffset.back();
+	if( nbAtt )
+		setNbAttribs( nbAtt );
+	for( auto& col: _vColumns )
+		col.resize( nbPts );
+	_vClass.resize( nbPts );
+	_vFlags.resize( nbPts, PF_None );
+	vThreads.clear();
+	for( size_t i=0; i<nbChunks; i++ )
+		vThreads.emplace_back(
+			[&,i]()                                      // lambda
 			{
-				if( temp.at(0) == '#' )  // if comment
-					nb_comment++;
-				else                     // if NOT comment
+				const auto& ch = vChunk[i];
+				auto offset = vOffset[i];
+				for( size_t at=0; at<ch._vColumns.size(); at++ )
+					std::copy( ch._vColumns[at].begin(), ch._vColumns[at].end(), _vColumns[at].begin() + offset );
+				for( size_t j=0; j<ch.size(); j++ )
 				{
-					auto v_tok = priv::splitString( temp, params.sep );
-					if( v_tok.size() < 2 )
-					{
-						std::cerr << "-Error: only one value on line " << nb_lines
-							<< "\n-Line=" << temp << " \n-length=" << temp.size() << '\n';
-						return false;
-					}
-
-					if( size() == 0 )                    // if this is the first datapoint, then set the nb of attributes
-						setNbAttribs( params.dataFilesHoldsClass ? v_tok.size()-1 : v_tok.size() );
-
-					p_parseTokens( v_tok, params, classIndexCounter, nb_lines );
+					auto cval = ch._vClass[j];
+					if( params.classAsString && cval != ClassVal(-1) )
+						cval = ClassVal( vRemap[i][cval.get()] );
+					_vClass[offset+j] = cval;
 				}
 			}
+		);
+	for( auto& th: vThreads )
+		th.join();
+
+#ifdef HANDLE_MISSING_VALUES
+	for( size_t at=0; at<nbAtt; at++ )             // chunks are not aligned on bitmap words, so this is done bit by bit
+		for( size_t i=0; i<nbChunks; i++ )
+		{
+			const auto* chbm = vChunk[i].getMissingBitmap( at );
+			if( !chbm )
+				continue;
+			if( _vMissing[at].empty() )
+				_vMissing[at].resize( (nbPts+63)/64, 0u );
+			for( size_t j=0; j<vChunk[i].size(); j++ )
+				if( priv::testBit( chbm, j ) )
+				{
+					auto p = vOffset[i] + j;
+					_vMissing[at][p/64] |= uint64_t(1) << (p%64);
+				}
+			_vNbMissing[at] += vChunk[i]._vNbMissing[at];
 		}
+#endif
+	return true;
+}
+//---------------------------------------------------------------------
+/// Load data file into memory, returns false on failure
+/**
+- If \c fname is "-", then data is read from standard input.
+- If Fparams::useMemoryMapping is true and \c fname is a regular file, it is mapped in memory and parsed directly from there.
+Anything else (named pipe, special file, ...) is read as a stream, and so it is if mapping fails.
+The file type is checked first, so that a named pipe is only opened once (no input is lost).
+*/
+//template<typename T>
+bool
+DataSet::load( std::string fname, const Fparams params )
+{
+	priv::ParserState pst;
+	bool success = false;
+	if( fname == "-" )
+	{
+		_fparams = params;
+		_fname   = "(stdin)";
+		clear();
+		success = p_loadStream( std::cin, params, pst );
 	}
-	while( !f.eof() );
+	else
+	{
+		std::unique_ptr<priv::MappedFile> pmap;
+		if( params.useMemoryMapping && priv::isRegularFile( fname ) )
+		{
+			try
+			{
+				pmap.reset( new priv::MappedFile( fname ) );
+			}
+			catch( const boost::interprocess::interprocess_exception& )
+			{}
+		}
+		if( pmap )
+		{
+			_fparams = params;
+			_fname   = fname;
+			clear();
+			pmap->adviseSequential();
+			if( params.nbThreads > 1 )
+				success = p_loadBufferParallel( pmap->data(), pmap->data() + pmap->size(), params, pst );
+			else
+				success = p_loadBuffer( pmap->data(), pmap->data() + pmap->size(), params, pst );
+		}
+		else
+		{
+			std::ifstream f( fname );
+			if( !f.is_open() )
+			{
+				std::cerr << "Unable to open file " << fname << "\n";
+				return false;
+			}
+			_fparams = params;
+			_fname   = fname;
+			clear();
+			success = p_loadStream( f, params, pst );
+		}
+	}
+	if( !success )
+		return false;
 
 	_cimIsUpToDate = false;
 	_noChange      = false;
+	p_updateClassIndex();
 	g_params.p_dataset = this;
 #if 1
 	std::cout << " - Read " << size() << " points in file " << fname;
 	std::cout << "\n - file info:"
-		<< "\n  - nb lines=" << nb_lines
-		<< "\n  - nb empty=" << nb_empty
-		<< "\n  - nb comment=" << nb_comment
+		<< "\n  - nb lines=" << pst.nb_lines
+		<< "\n  - nb empty=" << pst.nb_empty
+		<< "\n  - nb comment=" << pst.nb_comment
 		<< "\n  - nb classes=" << nbClasses()
 		<< '\n';
 #endif
 	return true;
 }
 //---------------------------------------------------------------------
-/// Generates in Html page the code to show the produced plots
-void
-DataSet::generateDataHtmlPage( std::ostream& fhtml, const DatasetStats<float>& stats, int nbBins ) const
+/// Writes the points currently held in memory in the snapshot file \c f, as points \c firstPoint and following.
+/// Returns true if some values are missing. Helper function for saveSnapshot() and createSnapshot()
+/**
+The sections offsets must be set in header \c h, see priv::snapshotLayout().
+*/
+bool
+DataSet::p_writeSnapshotBlock( std::ostream& f, const priv::SnapshotHeader& h, size_t firstPoint ) const
 {
-	fhtml << "<h2>A - Dataset characteristics</h2>\n<ul>\n"
-		<< "<li>name: " << _fname
-		<< "</li>\n<li># points=" << size()
-		<< "</li>\n<li># attributes="       << nbAttribs()
-		<< "</li>\n<li># classes="          << nbClasses()
-		<< "</li>\n<li># classless points=" << _nbNoClassPoints
-		<< "</li>\n<li># outliers removed:" << (_outlierTaggingDone?"YES":"NO")
-		<< "</li>\n</ul>\n";
-
-	if( _fparams.classAsString )
+	static_assert( sizeof(ClassVal) == sizeof(int32_t), "ClassVal must be a 32 bits integer" );
+	assert( firstPoint % 64 == 0 );
+	for( size_t at=0; at<nbAttribs(); at++ )
 	{
-		fhtml << "<h4>Class strings => indexes:</h4>\n<ul>\n";
-		for( const auto& psi: _classStringIndexBimap.left )
-			fhtml << "<li>\"" << psi.first << "\" : " << psi.second << "</li>\n";
-		fhtml << "</ul>\n";
+		f.seekp( h.offColumns + at * h.colStride + firstPoint * sizeof(float) );
+		f.write( reinterpret_cast<const char*>( getColumn(at) ), size() * sizeof(float) );
 	}
+	f.seekp( h.offClass + firstPoint * sizeof(ClassVal) );
+	f.write( reinterpret_cast<const char*>( getClassColumn() ), size() * sizeof(ClassVal) );
+	f.seekp( h.offFlags + firstPoint );
+	f.write( reinterpret_cast<const char*>( getFlagColumn() ), size() );
 
-	fhtml << "<h4>Classes frequency:</h4>\n<ol>\n";
-	size_t sum = 0;
-	for( const auto& cval: _classCount )
+	bool hasMissing = false;
+#ifdef HANDLE_MISSING_VALUES
+	for( size_t at=0; at<nbAttribs(); at++ )
 	{
-		fhtml << "<li> : " <<  cval.first << " - "
-			<< cval.second
-			<< " (" << std::setw(4) << 100. * cval.second/size()
-			<< " %)</li>\n";
-		sum += cval.second;
+		const auto* bm = getMissingBitmap( at );
+		if( bm )                  // if none, then nothing written: the file holds zeros there
+		{
+			f.seekp( h.offMissing + at * h.bitmapStride + firstPoint / 8 );
+			f.write( reinterpret_cast<const char*>( bm ), (size()+63)/64 * sizeof(uint64_t) );
+			hasMissing = true;
+		}
 	}
-	fhtml << "</ol>\n => " << sum << " points holding a class value\n\n";
-
-	std::string otd = _outlierTaggingDone?"B":"A";
-	fhtml << "<h3>A1 - Class distribution</h3>\n"
-		<< "<img src='class_distrib_" << otd << ".png'>\n";
-	p_generateClassDistrib( "class_distrib_" + otd );
-
-	fhtml << "<h3>A2 - Class vs. attribute values</h3>\n";
-	p_generateAttribPlot( otd, stats, fhtml );
-
-// TODO
-//	generateClassHistoPerTVal( nodeId, atIdx, v_thresVal, data, v_dpidx );
-
-	fhtml << "<h3>A3 - Histogram of data related to attribute value</h3>\n<table><tr>\n";
-	for( uint i=0; i<nbAttribs(); i++ )
-		fhtml << "<th>Attribute " << i << "</th>\n";
-	fhtml << "</tr><tr>\n";
-	for( uint i=0; i<nbAttribs(); i++ )
-		fhtml << "<td>\n <img src='attrib_histo_" << i << ".png'></td>\n";
-	fhtml << "</tr></table>\n";
+#endif
+	return hasMissing;
 }
-
 //---------------------------------------------------------------------
-/// Generates both data files and Gnuplot script of the class distribution of the dataset
+/// Writes the last sections of the snapshot file (class counts, labels, stats, source file name) and the header.
+/// Helper function for saveSnapshot() and createSnapshot()
 void
-DataSet::p_generateClassDistrib( std::string fname ) const
+DataSet::p_writeSnapshotTail( std::ostream& f, priv::SnapshotHeader& h, const DatasetStats<float>* pStats ) const
 {
-	START;
-	auto fhisto = priv::openOutputFile( fname, priv::FT_DAT, _fname );
+	f.seekp( h.offClassCount );
+	h.nbClassCount = _classCount.size();
+	for( const auto& cc: _classCount )
+	{
+		int64_t pair[2] = { cc.first.get(), static_cast<int64_t>( cc.second ) };
+		f.write( reinterpret_cast<const char*>( pair ), sizeof(pair) );
+	}
+	h.nbNoClassPoints = _nbNoClassPoints;
 
-	fhisto << "# data class histogram file for input file '" <<  fname
-		<< "'\n# class_index occurence_count percentage\n"
-		<< "NC " << getClassCount( ClassVal(-1) ) << ' '
-		<< 100. * getClassCount( ClassVal(-1) ) / size() << '\n';
+	h.offLabels = static_cast<uint64_t>( f.tellp() );
+	h.nbLabels  = _classStringIndexBimap.size();
+	for( const auto& lab: _classStringIndexBimap.left )
+	{
+		uint32_t val[2] = { static_cast<uint32_t>( lab.second ), static_cast<uint32_t>( lab.first.size() ) };
+		f.write( reinterpret_cast<const char*>( val ), sizeof(val) );
+		f.write( lab.first.data(), lab.first.size() );
+	}
 
-	for( const auto& cval: _classCount )
-		fhisto << cval.first << ' '
-			<< cval.second << ' ' << 100. * cval.second/size()
-			<< '\n';
+	h.offStats = priv::roundUp64( f.tellp() );
+	if( pStats )
+	{
+		h.flags |= priv::SF_HasStats;
+		f.seekp( h.offStats );
+		for( size_t at=0; at<nbAttribs(); at++ )
+		{
+			auto st = pStats->get( at );
+			float val[5] = { st._minVal, st._maxVal, st._meanVal, st._stddevVal, st._medianVal };
+			f.write( reinterpret_cast<const char*>( val ), sizeof(val) );
+		}
+	}
 
-	auto fplot = priv::openOutputFile( fname, priv::FT_PLT, _fname );
-	fplot << "set terminal pngcairo size 600,600\n"
-		<< "set output '" << fname << ".png'\n"
-		<< "set title 'Class distribution'\n"
-//		<< "set label 'file: " << _fname << "' at screen 0.01, screen .98 noenhanced\n"
-		<< "set ylabel '% of total points'\n"
-		<< "set xlabel 'Class'\n"
-		<< "set style data histogram\n"
-		<< "set style histogram cluster gap 1\n"
-		<< "set style fill solid\n"
-		<< "set boxwidth 1\n"
-		<< "plot '" << fname << ".dat' using 3:xtic(1) notitle\n";
-}
+	h.offSourceName  = static_cast<uint64_t>( f.tellp() );
+	h.sourceNameSize = _fname.size();
+	f.write( _fname.data(), _fname.size() );
+	h.fileSize = static_cast<uint64_t>( f.tellp() );
 
+	f.seekp( 0 );
+	f.write( reinterpret_cast<const char*>( &h ), sizeof(h) );
+}
 //---------------------------------------------------------------------
-void
-DataSet::printInfo( std::ostream& f, const char* name ) const
+/// Saves the dataset in a binary snapshot file, that can be reloaded with loadSnapshot(). Returns false on failure
+/**
+- See priv::SnapshotHeader for the file layout.
+- If \c pStats is given, these are stored too, see getSnapshotStats()
+- The file is first written under a temporary name and then renamed, so that concurrent processes
+never see a partially written file.
+*/
+bool
+DataSet::saveSnapshot( const std::string& fname, const DatasetStats<float>* pStats ) const
 {
-	f << "------------------------\nDataset: ";
-	if( name )
-		f << name;
-	f << "\n # points="             << size()
-		<< "\n # attributes="       << nbAttribs()
-		<< "\n # classes="          << nbClasses()
-		<< "\n # classless points=" << _nbNoClassPoints
-#ifdef HANDLE_OUTLIERS
-		<< "\n # outliers=" << _nbOutliers
-#endif
-		<< '\n';
+	START;
+	auto ftmp = fname + ".tmp" + std::to_string( std::random_device()() );
+	{
+		std::ofstream f( ftmp, std::ios::binary );
+		if( !f.is_open() )
+			return false;
 
-	if( _fparams.classAsString )
+		auto h = priv::snapshotHeader( _fparams, nbAttribs() );
+		h.nbPoints = size();
+		priv::snapshotLayout( h, size() );
+		if( p_writeSnapshotBlock( f, h, 0 ) )
+			h.flags |= priv::SF_HasMissing;
+		p_writeSnapshotTail( f, h, pStats );
+		if( !f )
+		{
+			f.close();
+			std::remove( ftmp.c_str() );
+			return false;
+		}
+	}
+	if( std::rename( ftmp.c_str(), fname.c_str() ) != 0 )
 	{
-		f << "- Class strings => indexes:\n";
-		for( const auto& psi: _classStringIndexBimap.left )
-			f << " -\"" << psi.first << "\": " << psi.second << '\n';
+		std::remove( ftmp.c_str() );
+		return false;
 	}
+	return true;
+}
+//---------------------------------------------------------------------
+/// Reads data file \c dataFile and writes its content in the snapshot file \c snapFile, without ever holding
+/// the whole dataset in memory. Returns false on failure
+/**
+This is to be used for datasets too large to fit in memory: the data file is parsed by blocks of
+\c blockSize points, each of these being written in the snapshot file before parsing the next one.
+The snapshot can then be loaded with loadSnapshot(), and the training will use the mapped columns,
+see Params::memoryBudget.
 
-	f << "- Classes frequency:\n";
+As the number of points is unknown when starting, the sections of the file are sized using the
+number of lines in the file, so there may be some (unused) space at the end of the columns.
+*/
+bool
+DataSet::createSnapshot(
+	const std::string& dataFile,   ///< input data file
+	const std::string& snapFile,   ///< output snapshot file
+	const Fparams&     params,     ///< parameters to read the data file
+	size_t             blockSize   ///< nb of points parsed before being written to the snapshot file
+)
+{
+	START;
+	std::unique_ptr<priv::MappedFile> pmap;
+	try
+	{
+		pmap.reset( new priv::MappedFile( dataFile ) );
+	}
+	catch( const boost::interprocess::interprocess_exception& )
+	{
+		std::cerr << "Unable to map file " << dataFile << "\n";
+		return false;
+	}
+	pmap->adviseSequential();
+	auto first = pmap->data();
+	auto last  = first + pmap->size();
+	auto capacity = std::count( first, last, '\n' ) + 1;   // upper bound on the number of points
+	blockSize = std::max( blockSize / 64 * 64, size_t(64) );  // so that missing values bitmaps stay aligned
+
+	auto ftmp = snapFile + ".tmp" + std::to_string( std::random_device()() );
+	std::ofstream f( ftmp, std::ios::binary );
+	if( !f.is_open() )
+		return false;
+
+	DataSet block;
+	block._fparams = params;
+	block._fname   = dataFile;
+	priv::ParserState pst;
+	priv::SnapshotHeader h;
+	size_t nbWritten = 0;
+	auto writeBlock = [&]()        // lambda
+	{
+		if( nbWritten == 0 )       // first block: now we know the nb of attributes
+		{
+			h = priv::snapshotHeader( params, block.nbAttribs() );
+			priv::snapshotLayout( h, capacity );
+		}
+		if( block.p_writeSnapshotBlock( f, h, nbWritten ) )
+			h.flags |= priv::SF_HasMissing;
+		nbWritten += block.size();
+		block.p_clearColumns();
+	};
+
+	bool success = true;
+	try
+	{
+		while( success )
+		{
+			auto eol = static_cast<const char*>( std::memchr( first, '\n', last - first ) );
+			success = block.p_parseLine( first, ( eol ? eol : last ), params, pst );
+			if( success && block.size() == blockSize )
+				writeBlock();
+			if( !eol )
+				break;
+			first = eol + 1;
+		}
+	}
+	catch( ... )
+	{
+		f.close();
+		std::remove( ftmp.c_str() );
+		throw;
+	}
+	if( success && block.size() )
+		writeBlock();
+	if( success && nbWritten )
+	{
+		h.nbPoints = nbWritten;
+		block.p_writeSnapshotTail( f, h, nullptr );
+	}
+	f.close();
+	if( !success || nbWritten == 0 || !f || std::rename( ftmp.c_str(), snapFile.c_str() ) != 0 )
+	{
+		std::remove( ftmp.c_str() );
+		return false;
+	}
+	std::cout << " - Read " << nbWritten << " points in file " << dataFile << ", saved in snapshot file " << snapFile << '\n';
+	return true;
+}
+//---------------------------------------------------------------------
+/// Loads a binary snapshot file created by saveSnapshot(), returns false on failure
+/**
+The file is mapped in memory, and the dataset directly uses the attribute and class columns from there
+(see isReadOnly()). Only the flags, the class counters and the labels (and missing values, if enabled) are copied.
+
+Fails (returning false, dataset left unchanged) if the file is not a valid snapshot,
+or if it was created from a data file read with different parameters than \c params.
+The header is checked before anything is mapped to a column: all sections must lie in the file
+(computed without integer overflow), be 64-bytes aligned, and the column and bitmap strides must be large enough
+to hold \c nbPoints values. The class column (apart from classless points) and the labels must only hold class values that appear in the class counts.
+*/
+bool
+DataSet::loadSnapshot( const std::string& fname, const Fparams& params )
+{
+	START;
+	std::shared_ptr<priv::MappedFile> pmap;
+	try
+	{
+		pmap = std::make_shared<priv::MappedFile>( fname );
+	}
+	catch( const boost::interprocess::interprocess_exception& )
+	{
+		return false;
+	}
+	const char* data  = pmap->data();
+	size_t      fsize = pmap->size();
+
+	priv::SnapshotHeader h;
+	if( fsize < sizeof(h) )
+		return false;
+	std::memcpy( &h, data, sizeof(h) );
+	if( std::memcmp( h.magic, priv::SnapshotMagic, sizeof(h.magic) ) != 0
+		|| h.version != priv::SnapshotVersion
+		|| h.byteOrder != 0x01020304
+		|| h.fileSize != fsize
+		|| h.nbAttribs < 2
+	)
+		return false;
+	if( h.sep != params.sep || h.fparamsFlags != priv::fparamsFlags( params ) )
+	{
+		LOG( 1, "snapshot file " << fname << " was created with different parameters" );
+		return false;
+	}
+#ifndef HANDLE_MISSING_VALUES
+	if( h.flags & priv::SF_HasMissing )
+		return false;
+#endif
+
+	auto fits = [fsize]( uint64_t offset, uint64_t nb, uint64_t elemSize )   // lambda
+	{                   // true if \c nb elements of \c elemSize bytes starting at \c offset are in the file (no overflow)
+		return offset <= fsize && ( elemSize == 0 || nb <= ( fsize - offset ) / elemSize );
+	};
+	auto aligned = []( uint64_t offset )   // lambda
+	{
+		return offset % 64 == 0;
+	};
+	if( !fits( h.offClass, h.nbPoints, sizeof(ClassVal) )         // first, so that nbPoints*4 can not overflow below
+		|| h.colStride < h.nbPoints * sizeof(float)
+		|| !aligned( h.offColumns ) || !aligned( h.colStride ) || !aligned( h.offClass ) || !aligned( h.offFlags )
+		|| !fits( h.offColumns, h.nbAttribs, h.colStride )
+		|| !fits( h.offFlags, h.nbPoints, 1 )
+		|| !fits( h.offClassCount, h.nbClassCount, 2 * sizeof(int64_t) )
+		|| !fits( h.offLabels, 0, 1 )
+		|| !fits( h.offSourceName, h.sourceNameSize, 1 )
+	)
+		return false;
+	if( h.flags & priv::SF_HasMissing )
+		if( h.bitmapStride < (h.nbPoints+63) / 64 * sizeof(uint64_t)
+			|| !aligned( h.offMissing ) || !aligned( h.bitmapStride )
+			|| !fits( h.offMissing, h.nbAttribs, h.bitmapStride )
+		)
+			return false;
+	if( h.flags & priv::SF_HasStats )
+		if( !aligned( h.offStats ) || !fits( h.offStats, h.nbAttribs, 5 * sizeof(float) ) )
+			return false;
+
+// class counts: each class must have at least one point
+	ClassCounter classCount;
+	uint64_t nbClassPoints = 0;
+	for( uint64_t i=0; i<h.nbClassCount; i++ )
+	{
+		int64_t pair[2];
+		std::memcpy( pair, data + h.offClassCount + i * sizeof(pair), sizeof(pair) );
+		if( pair[0] < 0 || pair[0] > std::numeric_limits<int>::max() || pair[1] <= 0 )
+			return false;
+		nbClassPoints += static_cast<uint64_t>( pair[1] );
+		classCount[ ClassVal( static_cast<int>( pair[0] ) ) ] = static_cast<size_t>( pair[1] );
+	}
+	if( classCount.size() != h.nbClassCount || nbClassPoints + h.nbNoClassPoints > h.nbPoints )
+		return false;
+
+// class column: each value must be negative (no class) or one of the counted classes
+	{
+		const auto* pClass = reinterpret_cast<const ClassVal*>( data + h.offClass );
+		ClassVal prev( -1 );
+		for( uint64_t i=0; i<h.nbPoints; i++ )
+			if( pClass[i] != prev )          // classes usually come in runs, this saves most lookups
+			{
+				if( pClass[i].get() >= 0 && classCount.count( pClass[i] ) == 0 )
+					return false;
+				prev = pClass[i];
+			}
+	}
+
+	ClassStringIndexBiMap bimap;
+	uint64_t offLab = h.offLabels;
+	for( uint64_t i=0; i<h.nbLabels; i++ )
+	{
+		uint32_t val[2];
+		if( !fits( offLab, 1, sizeof(val) ) )
+			return false;
+		std::memcpy( val, data + offLab, sizeof(val) );
+		offLab += sizeof(val);
+		if( !fits( offLab, val[1], 1 )
+			|| val[0] > static_cast<uint32_t>( std::numeric_limits<int>::max() )
+			|| classCount.count( ClassVal( static_cast<int>( val[0] ) ) ) == 0
+		)
+			return false;
+		bimap.insert( ClassStringIndexBiMap::value_type( std::string( data + offLab, val[1] ), val[0] ) );
+		offLab += val[1];
+	}
+
+	clear();
+	_fparams   = params;
+	_fname     = std::string( data + h.offSourceName, h.sourceNameSize );
+	_nbAttribs = h.nbAttribs;
+	_vColumns.resize( _nbAttribs );
+	_classStringIndexBimap = std::move( bimap );
+	_nbNoClassPoints = static_cast<uint>( h.nbNoClassPoints );
+	_classCount = std::move( classCount );
+	_vFlags.assign( data + h.offFlags, data + h.offFlags + h.nbPoints );
+#ifdef HANDLE_MISSING_VALUES
+	_vMissing.resize( _nbAttribs );
+	_vNbMissing.assign( _nbAttribs, 0u );
+	_snap.vMissing.assign( _nbAttribs, nullptr );
+	if( h.flags & priv::SF_HasMissing )
+		for( size_t at=0; at<_nbAttribs; at++ )
+		{
+			auto bitmap = reinterpret_cast<const uint64_t*>( data + h.offMissing + at * h.bitmapStride );
+			for( size_t w=0; w<(h.nbPoints+63)/64; w++ )
+				_vNbMissing[at] += __builtin_popcountll( bitmap[w] );
+			_snap.vMissing[at] = bitmap;
+		}
+#endif
+#ifdef HANDLE_OUTLIERS
+	_nbOutliers = std::count_if( _vFlags.begin(), _vFlags.end(), [](uint8_t fl){ return fl & PF_Outlier; } );
+#endif
+
+	_snap.vColumns.resize( _nbAttribs );
+	for( size_t at=0; at<_nbAttribs; at++ )
+		_snap.vColumns[at] = reinterpret_cast<const float*>( data + h.offColumns + at * h.colStride );
+	_snap.pClass = reinterpret_cast<const ClassVal*>( data + h.offClass );
+	if( h.flags & priv::SF_HasStats )
+		_snap.pStats = reinterpret_cast<const float*>( data + h.offStats );
+	_snap.size = h.nbPoints;
+	_snap.pMap = std::move( pmap );
+
+	_cimIsUpToDate = false;
+	_noChange      = false;
+	p_updateClassIndex();
+	g_params.p_dataset = this;
+	std::cout << " - Read " << size() << " points from snapshot file " << fname
+		<< "\n  - nb classes=" << nbClasses()
+		<< '\n';
+	return true;
+}
+//---------------------------------------------------------------------
+/// Fetches the attribute stats stored in the snapshot file, returns false if none (see saveSnapshot())
+bool
+DataSet::getSnapshotStats( DatasetStats<float>& stats ) const
+{
+	if( !_snap.pStats )
+		return false;
+	stats = DatasetStats<float>( nbAttribs() );
+	for( size_t at=0; at<nbAttribs(); at++ )
+	{
+		const float* val = _snap.pStats + at*5;
+		stats.add( at, AttribStats<float>{ val[0], val[1], val[2], val[3], val[4] } );
+	}
+	return true;
+}
+//---------------------------------------------------------------------
+/// Generates in Html page the code to show the produced plots
+void
+DataSet::generateDataHtmlPage( std::ostream& fhtml, const DatasetStats<float>& stats, int nbBins ) const
+{
+	fhtml << "<h2>A - Dataset characteristics</h2>\n<ul>\n"
+		<< "<li>name: " << _fname
+		<< "</li>\n<li># points=" << size()
+		<< "</li>\n<li># attributes="       << nbAttribs()
+		<< "</li>\n<li># classes="          << nbClasses()
+		<< "</li>\n<li># classless points=" << _nbNoClassPoints
+		<< "</li>\n<li># outliers removed:" << (_outlierTaggingDone?"YES":"NO")
+		<< "</li>\n</ul>\n";
+
+	if( _fparams.classAsString )
+	{
+		fhtml << "<h4>Class strings => indexes:</h4>\n<ul>\n";
+		for( const auto& psi: _classStringIndexBimap.left )
+			fhtml << "<li>\"" << psi.first << "\" : " << psi.second << "</li>\n";
+		fhtml << "</ul>\n";
+	}
+
+	fhtml << "<h4>Classes frequency:</h4>\n<ol>\n";
+	size_t sum = 0;
+	for( const auto& cval: _classCount )
+	{
+		fhtml << "<li> : " <<  cval.first << " - "
+			<< cval.second
+			<< " (" << std::setw(4) << 100. * cval.second/size()
+			<< " %)</li>\n";
+		sum += cval.second;
+	}
+	fhtml << "</ol>\n => " << sum << " points holding a class value\n\n";
+
+	std::string otd = _outlierTaggingDone?"B":"A";
+	fhtml << "<h3>A1 - Class distribution</h3>\n"
+		<< "<img src='class_distrib_" << otd << ".png'>\n";
+	p_generateClassDistrib( "class_distrib_" + otd );
+
+	fhtml << "<h3>A2 - Class vs. attribute values</h3>\n";
+	p_generateAttribPlot( otd, stats, fhtml );
+
+// TODO
+//	generateClassHistoPerTVal( nodeId, atIdx, v_thresVal, data, v_dpidx );
+
+	fhtml << "<h3>A3 - Histogram of data related to attribute value</h3>\n<table><tr>\n";
+	for( uint i=0; i<nbAttribs(); i++ )
+		fhtml << "<th>Attribute " << i << "</th>\n";
+	fhtml << "</tr><tr>\n";
+	for( uint i=0; i<nbAttribs(); i++ )
+		fhtml << "<td>\n <img src='attrib_histo_" << i << ".png'></td>\n";
+	fhtml << "</tr></table>\n";
+}
+
+//---------------------------------------------------------------------
+/// Generates both data files and Gnuplot script of the class distribution of the dataset
+void
+DataSet::p_generateClassDistrib( std::string fname ) const
+{
+	START;
+	auto fhisto = priv::openOutputFile( fname, priv::FT_DAT, _fname );
+
+	fhisto << "# data class histogram file for input file '" <<  fname
+		<< "'\n# class_index occurence_count percentage\n"
+		<< "NC " << getClassCount( ClassVal(-1) ) << ' '
+		<< 100. * getClassCount( ClassVal(-1) ) / size() << '\n';
+
+	for( const auto& cval: _classCount )
+		fhisto << cval.first << ' '
+			<< cval.second << ' ' << 100. * cval.second/size()
+			<< '\n';
+
+	auto fplot = priv::openOutputFile( fname, priv::FT_PLT, _fname );
+	fplot << "set terminal pngcairo size 600,600\n"
+		<< "set output '" << fname << ".png'\n"
+		<< "set title 'Class distribution'\n"
+//		<< "set label 'file: " << _fname << "' at screen 0.01, screen .98 noenhanced\n"
+		<< "set ylabel '% of total points'\n"
+		<< "set xlabel 'Class'\n"
+		<< "set style data histogram\n"
+		<< "set style histogram cluster gap 1\n"
+		<< "set style fill solid\n"
+		<< "set boxwidth 1\n"
+		<< "plot '" << fname << ".dat' using 3:xtic(1) notitle\n";
+}
+
+//---------------------------------------------------------------------
+void
+DataSet::printInfo( std::ostream& f, const char* name ) const
+{
+	f << "------------------------\nDataset: ";
+	if( name )
+		f << name;
+	f << "\n # points="             << size()
+		<< "\n # attributes="       << nbAttribs()
+		<< "\n # classes="          << nbClasses()
+		<< "\n # classless points=" << _nbNoClassPoints
+#ifdef HANDLE_OUTLIERS
+		<< "\n # outliers=" << _nbOutliers
+#endif
+		<< '\n';
+
+	if( _fparams.classAsString )
+	{
+		f << "- Class strings => indexes:\n";
+		for( const auto& psi: _classStringIndexBimap.left )
+			f << " -\"" << psi.first << "\": " << psi.second << '\n';
+	}
+
+	f << "- Classes frequency:\n";
 	size_t sum = 0;
 	size_t c = 0;
 	f << " # : label - Nb  %\n"; //-----------------------------\n";
@@ -1604,7 +3386,7 @@ DataSet::print( std::ostream& f ) const
 		f << i << "; ";
 	f << " class\n";
 
-	for( const auto& pt: _data )
+	for( const auto& pt: *this )
 		f << pt;
 	f << "# -------------------------------------------\n";
 }
@@ -1622,12 +3404,11 @@ DataSet::print( std::ostream& f, const std::vector<uint>& vIdx ) const
 	f << " class\n";
 	for( const auto& id: vIdx )
 	{
-		const auto& pt = getDataPoint( id );
 		f << id << " ";
-		for( const auto& val: pt._attrValue )
-			f << val << ";";
+		for( size_t i=0; i<nbAttribs(); i++ )
+			f << getColumn(i)[id] << ";";
 
-		f << pt.classVal() << "\n";
+		f << classVal(id) << "\n";
 	}
 	f << "# -------------------------------------------\n";
 }
@@ -1669,18 +3450,24 @@ getString( NodeType nt )
 /// A node of the training tree, this is used in the graph (see \ref GraphT)
 struct NodeT
 {
-	private:
-		static uint s_Counter;           ///< Node counter, incremented at each node creation, reset with resetNodeId()
-	public:
-		uint     _nodeId = 0;            ///< Id of the node. Needed to print the dot file. \todoL could be removed if graph switches to \c VecS
+		uint     _nodeId = 0;            ///< Id of the node, unique in its tree (see priv::addChildPair()). Needed to print the dot file. \todoL could be removed if graph switches to \c VecS
 		NodeType _type = NT_undef;       ///< Type of the node (Root, leaf, or decision)
 		ClassVal _nClass = ClassVal(-1); ///< Class, relevant only for terminal nodes (leaves of the tree)
+		size_t   _nClassIndex = size_t(-1);  ///< Index of \ref _nClass in the class index map of the tree (leaves only), see TrainingTree::classify()
 		size_t   _attrIndex = 0;         ///< Attribute Index that this nodes classifies (only for decision nodes)
 		float    _threshold = 0.f;       ///< Threshold on the attribute value (only for decision nodes)
 		uint     _depth = 0;             ///< Depth of the node in the tree
 		float    _giniImpurity = 0.f;
 		float    _nAmbig = -1.f;
-		std::vector<uint> v_Idx;         ///< Data point indexes
+		std::vector<uint> v_Idx;         ///< Data point indexes (released once the node is split, see priv::splitNode())
+/// For each attribute, the data point indexes, sorted on that attribute value (only with Params::usePresortedAttributes, released once the node is split)
+		std::vector<std::vector<uint>> v_SortedIdx;
+		size_t   _nbPoints = 0;          ///< Nb of data points of the node
+		int64_t  _spillOffset = -1;      ///< if not negative, \c v_Idx is stored at that position in the spill file, see priv::IndexSpill
+/// Class count of the points (classless points excluded), set when the node is created by a split (see priv::splitPoints())
+/// and released once the node is processed, except for the leaves, where it is used by the pruning (see priv::pruneSubtree()).
+/// If empty, it is computed from \c v_Idx
+		ClassCountArray _classCount;
 
 	friend std::ostream& operator << ( std::ostream& f, const NodeT& n )
 	{
@@ -1689,7 +3476,7 @@ struct NodeT
 			<< "\nattr=" << n._attrIndex
 			<< "\nthres=" << n._threshold
 			<< "\ndepth=" << n._depth
-			<< "\n#v=" << n.v_Idx.size()
+			<< "\n#v=" << n._nbPoints
 			;
 		return f;
 	}
@@ -1704,19 +3491,11 @@ struct NodeT
 		return true;
 	}
 
-/// Reset of node counter \ref s_Counter
-	static void resetNodeId()
-	{
-		s_Counter = 0;
-	}
-	NodeT() { _nodeId = s_Counter++; }
+	NodeT() = default;
 	NodeT( const NodeT& ) = delete;
 	NodeT& operator= ( const NodeT& ) = delete;
 };
 
- /// Instanciation of static counter
- uint NodeT::s_Counter = 0;
-
 //---------------------------------------------------------------------
 /// Used for training
 /**
@@ -1740,36 +3519,330 @@ using GraphT = boost::adjacency_list<
 using vertexT_t = boost::graph_traits<GraphT>::vertex_descriptor;
 using edge_t = boost::graph_traits<GraphT>::edge_descriptor;
 
-//---------------------------------------------------------------------
-// forward declaration, needed for the friend declaration below
-class ConfusionMatrix;
-
 // % % % % % % % % % % % % % %
 namespace priv {
 // % % % % % % % % % % % % % %
 
-/// Private class, used to hold the counters extracted from the ConfusionMatrix,
-/// see ConfusionMatrix::p_score()
-class CM_Counters
+//---------------------------------------------------------------------
+/// Moves the index lists of the tree nodes out of memory when these exceed Params::memoryBudget
+/**
+Keeps track of the memory used by the lists held by the nodes. Lists are moved to an anonymous
+temporary file (automatically removed when closed), and reloaded from there when needed.
+*/
+class IndexSpill
 {
-	friend class dtcpp::ConfusionMatrix;
+	public:
+		explicit IndexSpill( size_t budget ) : _budget( budget )
+		{}
+		~IndexSpill()
+		{
+			if( _file )
+				std::fclose( _file );
+		}
+		IndexSpill( const IndexSpill& ) = delete;
+		IndexSpill& operator = ( const IndexSpill& ) = delete;
 
-	CM_Counters( double TP, double FP, double TN, double FN )
-		: tp(TP),fp(FP),tn(TN), fn(FN)
-	{
-		assert( tp + fp + tn + fn > 0 );
-	}
-	double tp,fp,tn,fn;
-};
-// % % % % % % % % % % % % % %
-} // namespace priv
-// % % % % % % % % % % % % % %
+/// To be called when an index list of \c n elements gets created in memory
+		void add( size_t n )
+		{
+			_inMemory += n * sizeof(uint);
+		}
+/// To be called when an index list of \c n elements gets released
+		void remove( size_t n )
+		{
+			assert( _inMemory >= n * sizeof(uint) );
+			_inMemory -= n * sizeof(uint);
+		}
+		bool overBudget() const
+		{
+			return _budget != 0 && _inMemory > _budget;
+		}
+		size_t nbStored() const
+		{
+			return _nbStored;
+		}
+		void store( NodeT& );
+		void load( NodeT& );
+
+/// Releases the sorted index lists of \c node (not needed once the node is a leaf)
+		void releaseSorted( NodeT& node )
+		{
+			remove( node.v_SortedIdx.size() * node.v_Idx.size() );
+			std::vector<std::vector<uint>>().swap( node.v_SortedIdx );
+		}
+/// Moves the index list of \c node to the spill file, if memory budget is exceeded
+		void storeIfOverBudget( NodeT& node )
+		{
+			if( overBudget() && node._spillOffset < 0 && !node.v_Idx.empty() )
+				store( node );
+		}
 
+	private:
+		size_t     _budget;
+		std::atomic<size_t> _inMemory{0};  ///< memory used by the index lists (bytes), atomic as the subtrees can be built concurrently
+		std::FILE* _file     = nullptr;
+		uint64_t   _fileSize = 0;
+		size_t     _nbStored = 0;
+};
 //---------------------------------------------------------------------
-/// Performance score of classification, see ConfusionMatrix for definitions
-enum class PerfScore
-{
-	TPR=0    ///< True Positive Rate (recall)
+/// Moves the index list(s) of \c node to the spill file
+/**
+The sorted lists (see Params::usePresortedAttributes) are written right after the main list.
+*/
+void
+IndexSpill::store( NodeT& node )
+{
+	assert( node._spillOffset < 0 );
+	assert( node.v_Idx.size() == node._nbPoints );
+	if( !_file )
+	{
+		_file = std::tmpfile();
+		if( !_file )
+			throw std::runtime_error( "unable to create temporary file for node index lists" );
+	}
+	auto n = node.v_Idx.size();
+	if( std::fseek( _file, _fileSize, SEEK_SET ) != 0 )
+		throw std::runtime_error( "unable to write node index list to temporary file" );
+	auto write = [&]( std::vector<uint>& vec )       // lambda
+	{
+		assert( vec.size() == n );
+		if( std::fwrite( vec.data(), sizeof(uint), n, _file ) != n )
+			throw std::runtime_error( "unable to write node index list to temporary file" );
+		std::vector<uint>().swap( vec );   // release the memory
+	};
+	write( node.v_Idx );
+	for( auto& vs: node.v_SortedIdx )
+		write( vs );
+
+	auto nbLists = 1 + node.v_SortedIdx.size();
+	node._spillOffset = _fileSize;
+	_fileSize += nbLists * n * sizeof(uint);
+	remove( nbLists * n );
+	_nbStored++;
+	LOG( 2, "moved index list of node " << node._nodeId << " (" << n << " points) to spill file" );
+}
+//---------------------------------------------------------------------
+/// Reloads the index list of \c node from the spill file (does nothing if it is in memory)
+void
+IndexSpill::load( NodeT& node )
+{
+	if( node._spillOffset < 0 )
+		return;
+	assert( _file );
+	auto n = node._nbPoints;
+	if( std::fseek( _file, node._spillOffset, SEEK_SET ) != 0 )
+		throw std::runtime_error( "unable to read node index list from temporary file" );
+	auto read = [&]( std::vector<uint>& vec )       // lambda
+	{
+		vec.resize( n );
+		if( std::fread( vec.data(), sizeof(uint), n, _file ) != n )
+			throw std::runtime_error( "unable to read node index list from temporary file" );
+	};
+	read( node.v_Idx );
+	for( auto& vs: node.v_SortedIdx )
+		read( vs );
+	node._spillOffset = -1;
+	add( ( 1 + node.v_SortedIdx.size() ) * n );
+}
+
+//---------------------------------------------------------------------
+/// A work-stealing thread pool, used to run concurrently the independent parts of the training, see Params::nbThreads
+/**
+The pool is created at the beginning of the training, and its threads are reused for all the nodes.
+
+Each thread has its own task queue: it pushes its new tasks on it and pops them back in LIFO order (so a thread
+goes depth-first in the tree), and when empty, steals the oldest tasks from the other queues (these are the largest
+ones, as close to the root). Queue 0 is used by the threads that do not belong to the pool.
+All the queues are protected by a single mutex, as the tasks are coarse (a node or an attribute of a node).
+
+The thread waiting for a group of tasks (see parallelFor()) runs the first one itself, then runs the queued tasks
+until its own are done, so a task can start a parallel loop without risking a deadlock.
+*/
+class ThreadPool
+{
+	public:
+/// Constructor. \c nbThreads includes the calling thread, so \c nbThreads-1 workers are started
+		explicit ThreadPool( size_t nbThreads )
+			: _vQueue( std::max( nbThreads, (size_t)1 ) )
+		{
+			for( size_t i=1; i<nbThreads; i++ )
+				_vThreads.emplace_back( [this,i](){ p_workerLoop( i ); } );   // lambda
+		}
+		~ThreadPool()
+		{
+			{
+				std::lock_guard<std::mutex> lock( _mutex );
+				_stop = true;
+			}
+			_cv.notify_all();
+			for( auto& th: _vThreads )
+				th.join();
+		}
+		ThreadPool( const ThreadPool& )             = delete;
+		ThreadPool& operator = ( const ThreadPool& ) = delete;
+
+/// Nb of threads, including the calling one
+		size_t nbThreads() const { return _vThreads.size() + 1; }
+
+		template<typename FUNC>
+		void parallelFor( size_t n, FUNC func );
+
+	private:
+		bool   p_runOneTask( std::unique_lock<std::mutex>&, size_t qIdx );
+		void   p_workerLoop( size_t qIdx );
+		size_t p_queueIndex() const
+		{
+			return s_pPool == this ? s_queueIdx : 0u;
+		}
+
+		std::vector<std::thread>                       _vThreads;
+		std::vector<std::deque<std::function<void()>>> _vQueue;       ///< tasks waiting to be run, one queue per thread
+		size_t                                         _nbQueued = 0; ///< total nb of tasks in \ref _vQueue
+		std::mutex                                     _mutex;        ///< protects the queues, \ref _stop and the task counters
+		std::condition_variable                        _cv;           ///< signaled when a task is queued or a group of tasks is done
+		bool                                           _stop = false;
+
+		static thread_local const ThreadPool* s_pPool;     ///< pool the current thread belongs to (if any)
+		static thread_local size_t            s_queueIdx;  ///< index of the queue of the current thread in that pool
+};
+
+thread_local const ThreadPool* ThreadPool::s_pPool    = nullptr;
+thread_local size_t            ThreadPool::s_queueIdx = 0;
+
+//---------------------------------------------------------------------
+/// Runs \c func(i) for i in [0,n), using the threads of the pool, and returns when all are done
+/**
+\c func(0) is run by the calling thread, the others are queued and can be stolen by the idle threads.
+If some call throws, the first exception is rethrown here, once all the calls are done.
+The calls log to the same stream as the caller (see priv1::logStream()).
+*/
+template<typename FUNC>
+void
+ThreadPool::parallelFor( size_t n, FUNC func )
+{
+	if( n == 0 )
+		return;
+	size_t nbRemaining = n;
+	std::exception_ptr except;
+	auto* pLog = priv1::logStream();           // the tasks log where the caller does
+	auto runTask = [&]( size_t i )               // lambda
+	{
+		std::exception_ptr ex;
+		auto* pLogPrev = priv1::logStream();
+		priv1::logStream() = pLog;
+		try
+		{
+			func( i );
+		}
+		catch( ... )
+		{
+			ex = std::current_exception();
+		}
+		priv1::logStream() = pLogPrev;
+		std::lock_guard<std::mutex> lock( _mutex );
+		if( ex && !except )
+			except = ex;
+		if( --nbRemaining == 0 )
+			_cv.notify_all();
+	};
+
+	auto qIdx = p_queueIndex();
+	if( n > 1 )
+	{
+		std::lock_guard<std::mutex> lock( _mutex );
+		for( size_t i=n-1; i>0; i-- )         // reverse order, so the owner pops them back in increasing order
+			_vQueue[qIdx].emplace_back( [&runTask,i](){ runTask( i ); } );   // lambda
+		_nbQueued += n-1;
+		_cv.notify_all();
+	}
+	runTask( 0 );
+
+	std::unique_lock<std::mutex> lock( _mutex );
+	while( nbRemaining )                        // help running the tasks (not only ours) until our own are done
+		if( !p_runOneTask( lock, qIdx ) )
+			_cv.wait( lock, [&]{ return nbRemaining == 0 || _nbQueued != 0; } );  // lambda
+	lock.unlock();
+
+	if( except )
+		std::rethrow_exception( except );
+}
+//---------------------------------------------------------------------
+/// Runs a queued task if any (the last one of queue \c qIdx, or else the first one of another queue), returns false if none.
+/// The lock is released while running it.
+bool
+ThreadPool::p_runOneTask( std::unique_lock<std::mutex>& lock, size_t qIdx )
+{
+	if( _nbQueued == 0 )
+		return false;
+	std::function<void()> task;
+	if( !_vQueue[qIdx].empty() )
+	{
+		task = std::move( _vQueue[qIdx].back() );
+		_vQueue[qIdx].pop_back();
+	}
+	else
+		for( size_t i=1; i<_vQueue.size(); i++ )         // steal
+		{
+			auto& queue = _vQueue[ (qIdx+i) % _vQueue.size() ];
+			if( !queue.empty() )
+			{
+				task = std::move( queue.front() );
+				queue.pop_front();
+				break;
+			}
+		}
+	assert( task );
+	_nbQueued--;
+	lock.unlock();
+	task();
+	lock.lock();
+	return true;
+}
+//---------------------------------------------------------------------
+void
+ThreadPool::p_workerLoop( size_t qIdx )
+{
+	s_pPool    = this;
+	s_queueIdx = qIdx;
+	std::unique_lock<std::mutex> lock( _mutex );
+	while( !_stop )
+		if( !p_runOneTask( lock, qIdx ) )
+			_cv.wait( lock, [this]{ return _stop || _nbQueued != 0; } );  // lambda
+}
+// % % % % % % % % % % % % % %
+} // namespace priv
+// % % % % % % % % % % % % % %
+
+//---------------------------------------------------------------------
+// forward declaration, needed for the friend declaration below
+class ConfusionMatrix;
+
+// % % % % % % % % % % % % % %
+namespace priv {
+// % % % % % % % % % % % % % %
+
+/// Private class, used to hold the counters extracted from the ConfusionMatrix,
+/// see ConfusionMatrix::p_score()
+class CM_Counters
+{
+	friend class dtcpp::ConfusionMatrix;
+
+	CM_Counters( double TP, double FP, double TN, double FN )
+		: tp(TP),fp(FP),tn(TN), fn(FN)
+	{
+		assert( tp + fp + tn + fn > 0 );
+	}
+	double tp,fp,tn,fn;
+};
+// % % % % % % % % % % % % % %
+} // namespace priv
+// % % % % % % % % % % % % % %
+
+//---------------------------------------------------------------------
+/// Performance score of classification, see ConfusionMatrix for definitions
+enum class PerfScore
+{
+	TPR=0    ///< True Positive Rate (recall)
 	,TNR     ///< True Negative Rate
 	,PPV     ///< Positive Predictive Value  (precision)
 	,ACC     ///< Accuracy
@@ -1939,11 +4012,13 @@ struct ConfusionMatrix
 		assert( predictedVal.get() >=0 );
 		assert( _cmClassIndexMap.size() );
 
-		auto col = _cmClassIndexMap.left.at( trueVal );
-		auto li  = _cmClassIndexMap.left.at( predictedVal );
-
-		assert( li < _mat.size() && col < _mat.size() );
-		_mat[li][col]++;
+		addIndex( _cmClassIndexMap.left.at( trueVal ), _cmClassIndexMap.left.at( predictedVal ) );
+	}
+/// Same as add(), but using the class indexes given by the class index map (no lookup)
+	void addIndex( size_t trueIdx, size_t predictedIdx )
+	{
+		assert( predictedIdx < _mat.size() && trueIdx < _mat.size() );
+		_mat[predictedIdx][trueIdx]++;
 	}
 
 	void printAllScores( std::ostream&, const char* msg=0 ) const;
@@ -2198,16 +4273,160 @@ ConfusionMatrix::printAllScores( std::ostream& f, const char* msg ) const
 struct TrainingInfo
 {
 	size_t nbRemovals = 0;
+	size_t nbSpilledLists = 0;   ///< nb of times a node index list was moved out of memory, see Params::memoryBudget
+/// Nb of node class counts obtained by subtracting the sibling's one from the parent's, see priv::splitPoints().
+/// This is done once for every split, so it always equals the nb of splits (before pruning)
+	size_t nbSiblingSubtractions = 0;
 	bool   trainingSuccess = false;
 
 	friend std::ostream& operator << ( std::ostream& f, const TrainingInfo& ti )
 	{
 		f << "TrainingInfo:"
 			<< "\n - nbRemovals=" << ti.nbRemovals
+			<< "\n - nbSiblingSubtractions=" << ti.nbSiblingSubtractions
 			<< '\n';
+		if( ti.nbSpilledLists )
+			f << " - nbSpilledLists=" << ti.nbSpilledLists << '\n';
 		return f;
 	}
 };
+//---------------------------------------------------------------------
+/// Layout of the nodes of an InferenceTree, see TrainingTree::compile()
+enum class En_TreeLayout
+{
+	DepthFirst,    ///< the subtree of the lower child of a node follows that node's children
+	BreadthFirst   ///< nodes are stored level by level
+};
+
+//---------------------------------------------------------------------
+/// A node of an InferenceTree (16 bytes)
+struct InferenceNode
+{
+	uint32_t attrIndex;   ///< attribute handled by a decision node, \c Leaf for a leaf
+	float    threshold;   ///< decision node: threshold on the attribute value
+/// Decision node: index of the child for attribute values lower than the threshold, the other child follows it.
+/// Leaf: index of the class in the class index map of the tree (-1 if unknown)
+	uint32_t child;
+	int32_t  classVal;    ///< leaf: class value
+
+	static constexpr uint32_t Leaf = uint32_t(-1);
+
+	bool isLeaf() const
+	{
+		return attrIndex == Leaf;
+	}
+};
+static_assert( sizeof(InferenceNode) == 16, "unexpected size of InferenceNode" );
+
+//---------------------------------------------------------------------
+/// Immutable tree used for classification, produced by TrainingTree::compile() or loaded from a model file with loadModel()
+/**
+All the nodes are held in a single array (see InferenceNode), so reaching a leaf only takes a few predictable loads.
+It does not depend on the training tree, that can be dropped once compiled.
+
+The node array is shared between copies of the tree. When loaded from a model file, it is the mapped file itself.
+*/
+class InferenceTree
+{
+	friend class TrainingTree;
+
+	public:
+		InferenceTree() = default;
+
+		ClassVal        classify( const float* pAttribVal ) const;
+		ClassVal        classify( const DataPoint& ) const;
+		ConfusionMatrix classify( const DataSet& ) const;
+		ConfusionMatrix classify( const DataSetView& ) const;
+
+		bool saveModel( const std::string& fname ) const;
+		bool loadModel( const std::string& fname );
+
+		void predictRows( const float* pRows, size_t nbRows, size_t rowStride, ClassVal* pOut ) const;
+		void predictColumns( const float* const* pCols, size_t nbRows, ClassVal* pOut ) const;
+		std::vector<ClassVal> predict( const DataSet& ) const;
+		std::vector<ClassVal> predict( const DataSetView& ) const;
+
+		size_t        nbNodes() const { return _nbNodes; }
+/// Nb of attributes of the points: the arrays given to classify( const float* ), predictRows() and predictColumns() must hold at least that many values
+		size_t        nbAttribs() const { return _nbAttribs; }
+		size_t        nbLeaves() const
+		{
+			return std::count_if( _pNodes, _pNodes+_nbNodes, []( const InferenceNode& n ){ return n.isLeaf(); } );
+		}
+		En_TreeLayout layout() const { return _layout; }
+		boost::iterator_range<const InferenceNode*> getNodes() const
+		{
+			return boost::make_iterator_range( _pNodes, _pNodes+_nbNodes );
+		}
+		const ClassIndexMap& getClassIndexMap() const { return _tClassIndexMap; }
+
+/// Assign the string labels of the classes (see DataSet::getStringIndexBimap()), these are saved in the model file
+		void assignLabels( const ClassStringIndexBiMap& labels )
+		{
+			_classLabels = labels;
+		}
+		const ClassStringIndexBiMap& getStringIndexBimap() const { return _classLabels; }
+
+	private:
+/// Returns the index of the leaf reached by a point whose attribute values are given by \c attribVal
+		template<typename F>
+		uint32_t p_findLeaf( F attribVal ) const
+		{
+			const auto* nodes = _pNodes;
+			uint32_t idx = 0;
+			while( !nodes[idx].isLeaf() )
+			{
+				const auto& node = nodes[idx];
+				idx = node.child + !( attribVal( node.attrIndex ) < node.threshold );
+			}
+			return idx;
+		}
+		ConfusionMatrix p_classify( const DataSet&, const std::vector<uint>* ) const;
+		void p_setNodes( std::vector<InferenceNode>&& );
+/// Throws if the points to classify have less than nbAttribs() attributes
+		void p_checkNbAttribs( size_t nbAttribs ) const
+		{
+			if( nbAttribs < _nbAttribs )
+				throw std::runtime_error(
+					"unable to classify, points have " + std::to_string( nbAttribs )
+					+ " attributes, tree needs " + std::to_string( _nbAttribs )
+				);
+		}
+		template<typename F>
+		void p_predict( size_t nbPts, F attribVal, ClassVal* pOut ) const;
+/// Finds the leaves reached by the points \c first to \c first+nb (at most \ref DTCPP_INFERENCE_BATCH points),
+/// whose attribute values are given by <code>attribVal(pointIndex,attribIndex)</code>
+		template<typename F>
+		void p_findLeaves( size_t first, size_t nb, F attribVal, uint32_t* pLeaf ) const
+		{
+#if defined(__SSE2__) && defined(DTCPP_SIMD_INFERENCE)
+			p_findLeavesSSE2( first, nb, attribVal, pLeaf );
+#else
+			p_findLeavesScalar( first, nb, attribVal, pLeaf );
+#endif
+		}
+
+#ifdef TESTMODE
+	public:
+#endif
+		template<typename F>
+		void p_findLeavesScalar( size_t first, size_t nb, F attribVal, uint32_t* pLeaf ) const;
+#if defined(__SSE2__) && defined(DTCPP_SIMD_INFERENCE)
+		template<typename F>
+		void p_findLeavesSSE2( size_t first, size_t nb, F attribVal, uint32_t* pLeaf ) const;
+#endif
+
+	private:
+		std::shared_ptr<const void> _pStorage;       ///< owns the node array: a vector, or the mapped model file
+		const InferenceNode*       _pNodes = nullptr; ///< root node first
+		size_t                     _nbNodes = 0;
+		ClassIndexMap              _tClassIndexMap;  ///< maps class values to index values
+		ClassStringIndexBiMap      _classLabels;     ///< maps string labels to class values (empty if classes are numerical)
+		En_TreeLayout              _layout = En_TreeLayout::DepthFirst;
+		size_t                     _nbAttribs = 0;   ///< nb of attributes of the training data
+		uint32_t                   _leafIdx = 0;     ///< index of a leaf, where the unused lanes of a batch start, see p_findLeavesSSE2()
+};
+
 //---------------------------------------------------------------------
 /// This one holds edges that each have a vector holding the index of datapoints.
 /// This is memory costly, but useless for classifying, so once it is trained, we could use another tree type
@@ -2227,6 +4446,7 @@ access the Confusion Matrix. It can be generated from a source dataset with:
 class TrainingTree
 {
 	friend void splitNode( vertexT_t, GraphT&, DataSet&, const Params& );
+	friend class TraceDiagSink;
 
 	private:
 #ifdef TESTMODE
@@ -2237,6 +4457,7 @@ class TrainingTree
 		uint          _maxDepth = 1;  ///< defined by training
 		ClassIndexMap _tClassIndexMap;  ///< maps class values to index values
 		std::string   _dataFileName = "(NO DATA)"; ///< used to print input file name on plot
+		size_t        _nbAttribs = 0; ///< nb of attributes of the training data, defined by training
 
 	public:
 //#ifdef TESTMODE
@@ -2258,31 +4479,34 @@ class TrainingTree
 		void assignCIM( const ClassIndexMap& cim )
 		{
 			_tClassIndexMap = cim;
+			p_setLeafClassIndexes();
 		}
 /// Clear the tree and create the initial (root) node
 		void clear()
 		{
 			_graph.clear();
-			NodeT::resetNodeId();
-			_initialVertex = boost::add_vertex(_graph);  // create initial vertex
+			_initialVertex = boost::add_vertex(_graph);  // create initial vertex, with id 0
 			_graph[_initialVertex]._type = NT_Root;
 		}
-#ifdef GRAPH_SERIALIZATION
-		void saveToFile(   const std::string& fname ) const;
-		void readFromFile( const std::string& fname );
-#endif
 		TrainingInfo    train( const DataSet&, const Params& );
+		TrainingInfo    train( const DataSetView&, const Params& );
 		ConfusionMatrix classify( const DataSet& ) const;
+		ConfusionMatrix classify( const DataSetView& ) const;
 		ClassVal        classify( const DataPoint& ) const;
+		InferenceTree   compile( En_TreeLayout layout=En_TreeLayout::DepthFirst ) const;
 
-		void     printDot( const std::string& name, const Params& params ) const;
+		void     printDot( std::ostream& ) const;
+		void     printCode( std::ostream&, const std::string& nameSpace="dtcpp_model", const ClassStringIndexBiMap* pLabels=nullptr ) const;
 		void     printInfo( std::ostream&, const std::string& msg=std::string() ) const;
 		uint     maxDepth() const { return _maxDepth; }
 		size_t   nbLeaves() const;
 
 	private:
-		size_t p_pruning( const DataSet& );
-		bool   p_buildTree( const DataSet&, const Params& params );
+		void   p_setLeafClassIndexes();
+		vertexT_t       p_findLeaf( const DataPoint& ) const;
+		ConfusionMatrix p_classify( const DataSet&, const std::vector<uint>* ) const;
+		TrainingInfo p_train( const DataSet&, std::vector<uint>, const Params& );
+		bool   p_buildTree( const DataSet&, std::vector<uint>, const Params& params, priv::IndexSpill&, TrainingInfo& );
 		void p_check() const
 		{
 //			assert( _tClassIndexMap.size() > 0 );
@@ -2290,48 +4514,14 @@ class TrainingTree
 				throw std::runtime_error( "program error, tree has no Class to Index map assigned" );
 		}
 
+#ifdef TESTMODE
+	public:
+#endif
+		size_t p_pruning( const DataSet&, priv::IndexSpill& );
+
 };
 
 
-//---------------------------------------------------------------------
-#ifdef GRAPH_SERIALIZATION
-} // namespace dtcpp
-namespace boost {
-namespace serialization {
-
-    template<class Archive>
-    void serialize( Archive& ar, dtcpp::NodeT& n, unsigned /*int version*/ )
-    {
-        ar & n._nodeId;
-//        ar & n._type;
-    }
-
-} // namespace serialization
-} // namespace boost
-namespace dtcpp {
-//---------------------------------------------------------------------
-/// Save tree to file
-/// \todo 20210506: As of today, this does not build, need to investigate
-void
-TrainingTree::saveToFile( const std::string& fname ) const
-{
-	std::ofstream f( fname );
-	if( !f.is_open() )
-		throw std::runtime_error( "unable to open file " + fname + " for saving tree" );
-	boost::archive::text_oarchive oa( f );
-    oa << _graph;
-}
-//---------------------------------------------------------------------
-void
-TrainingTree::readFromFile( const std::string& fname )
-{
-	std::ifstream f( fname );
-	if( !f.is_open() )
-		throw std::runtime_error( "unable to open file: " + fname + " for reading tree" );
-	boost::archive::text_iarchive ia( f );
-    ia >> _graph;
-}
-#endif // GRAPH_SERIALIZATION
 //---------------------------------------------------------------------
 /// Iterates on all nodes and counts the one that are not root, nor "decision" nodes
 inline
@@ -2389,7 +4579,7 @@ printDotNodeChilds( std::ostream& f, vertexT_t vert, const GraphT& graph )
 				<< "\\nGI=" << graph[target]._giniImpurity
 				<< " A=" << graph[target]._nAmbig;
 
-		f << "\\n#pts=" << graph[target].v_Idx.size() << "\"";
+		f << "\\n#pts=" << graph[target]._nbPoints << "\"";
 		switch( graph[target]._type )
 		{
 			case NT_Decision: f << ",color=green"; break;
@@ -2400,33 +4590,32 @@ printDotNodeChilds( std::ostream& f, vertexT_t vert, const GraphT& graph )
 		printDotNodeChilds( f, target, graph );
 	}
 }
-// % % % % % % % % % % % % % %
-} // namespace priv
-// % % % % % % % % % % % % % %
-
 //---------------------------------------------------------------------
-/// Print a DOT file of the tree by calling the recursive function \ref printDotNodeChilds()
+/// Name of the DOT file of a tree (without extension), see DiagSink::addTree()
 inline
-void
-TrainingTree::printDot( const std::string& name, const Params& params ) const
+std::string
+dotFileName( const std::string& name, int foldIndex )
 {
-	auto fname = "tree"
-		+ ( params.foldIndex==-1 ? "" : "_f" + std::to_string(params.foldIndex) )
+	return "tree"
+		+ ( foldIndex==-1 ? "" : "_f" + std::to_string(foldIndex) )
 		+ "_" + name;
-
-	*params.outputHtml << "<h4>" << name << " tree</h4>\n<img src='" << fname << ".png'>\n";
-
-	auto f = priv::openOutputFile( fname, priv::FT_DOT );
-	f << "# file: " << _dataFileName << "\n\n"
+}
+//---------------------------------------------------------------------
+/// Print the DOT code of the tree starting at \c root, by calling the recursive function \ref printDotNodeChilds()
+inline
+void
+printDotTree( std::ostream& f, const GraphT& graph, vertexT_t root, const std::string& dataFileName, size_t nbLeaves )
+{
+	f << "# file: " << dataFileName << "\n\n"
 		<< "digraph g {\nnode [shape=\"box\"];\n"
-		<< "title [label=\"data file: " << _dataFileName
-		<< "\\n" << nbLeaves()
+		<< "title [label=\"data file: " << dataFileName
+		<< "\\n" << nbLeaves
 		<< " leaves\",shape=\"note\",labelloc=\"c\"];\n"
-		<< _graph[_initialVertex]._nodeId
-		<< " [label=\"n" << _graph[_initialVertex]._nodeId
-		<< " attr="     << _graph[_initialVertex]._attrIndex
-		<< " thres="    << _graph[_initialVertex]._threshold
-		<< "\\n#"      << _graph[_initialVertex].v_Idx.size()
+		<< graph[root]._nodeId
+		<< " [label=\"n" << graph[root]._nodeId
+		<< " attr="     << graph[root]._attrIndex
+		<< " thres="    << graph[root]._threshold
+		<< "\\n#"      << graph[root]._nbPoints
 		<< "\",color = blue];\n";
 /*
 	f << "legend [label=\""
@@ -2437,9 +4626,143 @@ TrainingTree::printDot( const std::string& name, const Params& params ) const
 		<< "MP: Merged by pruning"
 		<< "\",shape=\"note\",labelloc=\"l\"];\n";
 */
-	priv::printDotNodeChilds( f, _initialVertex, _graph );
+	printDotNodeChilds( f, root, graph );
 	f << "}\n";
 }
+// % % % % % % % % % % % % % %
+} // namespace priv
+// % % % % % % % % % % % % % %
+
+//---------------------------------------------------------------------
+/// Print the DOT code of the tree, see priv::printDotTree().
+/// During training, the DOT files are written by the diagnostic sink, see DiagSink::addTree()
+inline
+void
+TrainingTree::printDot( std::ostream& f ) const
+{
+	priv::printDotTree( f, _graph, _initialVertex, _dataFileName, nbLeaves() );
+}
+
+// % % % % % % % % % % % % % %
+namespace priv {
+// % % % % % % % % % % % % % %
+
+//---------------------------------------------------------------------
+/// Returns a C++ literal of the float value \c v, that gets read back as the same value
+inline
+std::string
+floatLiteral( float v )
+{
+	std::ostringstream oss;
+	oss << std::setprecision( std::numeric_limits<float>::max_digits10 ) << v;
+	auto str = oss.str();
+	if( str.find_first_of( ".e" ) == std::string::npos )
+		str += '.';
+	return str + 'f';
+}
+//---------------------------------------------------------------------
+/// Returns a C++ string literal holding \c str (quotes, backslashes and non printable characters are escaped)
+inline
+std::string
+stringLiteral( const std::string& str )
+{
+	std::ostringstream oss;
+	oss << '"';
+	for( auto c: str )
+	{
+		auto uc = static_cast<unsigned char>( c );
+		if( c == '"' || c == '\\' )
+			oss << '\\' << c;
+		else
+			if( std::isprint( uc ) )
+				oss << c;
+			else                    // octal escape, always 3 digits so the next character can not be taken as a digit
+				oss << '\\' << std::oct << std::setw(3) << std::setfill('0') << static_cast<int>( uc ) << std::dec;
+	}
+	oss << '"';
+	return oss.str();
+}
+//---------------------------------------------------------------------
+/// Recursive function used to print the C++ code of the tree, prints the current node (see TrainingTree::printCode())
+/**
+As each branch ends with a \c return, the lower subtree is printed inside an \c if block, and the other one just after.
+*/
+inline
+void
+printCodeNode( std::ostream& f, vertexT_t vert, const GraphT& graph, size_t depth )
+{
+	std::string indent( depth, '\t' );
+	const auto& node = graph[vert];
+	assert( node._type != NT_undef );
+	if( node._type != NT_Root && node._type != NT_Decision )
+	{
+		f << indent << "return " << node._nClass << ";    // n" << node._nodeId << ": " << node._nbPoints << " pts\n";
+		return;
+	}
+	assert( boost::out_degree( vert, graph ) == 2 );
+	auto edges = boost::out_edges( vert, graph );
+	auto et = edges.first++;
+	auto ef = edges.first;
+	if( graph[*ef].edgeSide )
+		std::swap( et, ef );
+
+	auto lower = boost::target( *et, graph );
+	f << indent << "if( v[" << node._attrIndex << "] < " << floatLiteral( node._threshold ) << " )\n";
+	if( graph[lower].isLeave() )
+		printCodeNode( f, lower, graph, depth+1 );
+	else
+	{
+		f << indent << "{\n";
+		printCodeNode( f, lower, graph, depth+1 );
+		f << indent << "}\n";
+	}
+	printCodeNode( f, boost::target( *ef, graph ), graph, depth );
+}
+// % % % % % % % % % % % % % %
+} // namespace priv
+// % % % % % % % % % % % % % %
+
+//---------------------------------------------------------------------
+/// Prints the tree as a self-contained C++ header, holding the function <code>int nameSpace::classify( const float* v )</code>
+/**
+This function returns the class value of the point whose attribute values are given by \c v, as nested \c if statements,
+with the thresholds and the attribute indexes as constants. The generated code depends on nothing (not even the standard library).
+Points are classified as by classify() (an attribute value is compared with a threshold using \c <).
+
+The header also holds the function <code>const char* nameSpace::classLabel( int c )</code>, returning the string label of class value \c c,
+as given by \c pLabels (see DataSet::getStringIndexBimap()), or null if there is none.
+
+See \c dectree switch \c -cg and the \c model target of the makefile.
+*/
+inline
+void
+TrainingTree::printCode( std::ostream& f, const std::string& nameSpace, const ClassStringIndexBiMap* pLabels ) const
+{
+	if( nbLeaves() < 2 )
+		throw std::runtime_error( "unable to generate code, tree has " + std::to_string( nbLeaves() ) + " leaves" );
+
+	std::string guard;
+	for( auto c: nameSpace )
+		guard += static_cast<char>( std::isalnum( static_cast<unsigned char>(c) ) ? std::toupper( c ) : '_' );
+	guard += "_HG";
+
+	f << "#ifndef " << guard << "\n#define " << guard << "\n\n"
+		<< "/// Decision tree trained on data file " << _dataFileName
+		<< ", with " << nbLeaves() << " leaves (max depth " << maxDepth() << ")\n"
+		<< "namespace " << nameSpace << " {\n\n"
+		<< "/// Returns the class value of the point whose attribute values are given by \\c v\n"
+		<< "inline\nint\nclassify( const float* v )\n{\n";
+	priv::printCodeNode( f, _initialVertex, _graph, 1 );
+	f << "}\n\n"
+		<< "/// Returns the string label of class value \\c c, or null if there is none\n"
+		<< "inline\nconst char*\nclassLabel( int c )\n{\n"
+		<< "\tswitch( c )\n\t{\n";
+	if( pLabels )
+		for( const auto& lab: pLabels->right )     // in class value order
+			f << "\t\tcase " << lab.first << ": return " << priv::stringLiteral( lab.second ) << ";\n";
+	f << "\t\tdefault: return nullptr;\n\t}\n}\n\n"
+		<< "} // namespace " << nameSpace << "\n\n#endif // " << guard << '\n';
+}
 
 //---------------------------------------------------------------------
 /// Print basic information on the tree
@@ -2463,34 +4786,43 @@ TrainingTree::printInfo( std::ostream& f, const std::string& msg ) const
 /**
 - See related getGiniImpurity()
 */
-std::pair<ClassCounter,size_t>
+std::pair<ClassCountArray,size_t>
 getNodeClassCount(
 	const std::vector<uint>& v_dpidx, ///< datapoint indexes to consider
 	const DataSet&           data     ///< dataset
 )
 {
-	ClassCounter m;
+	ClassCountArray vcount( data.nbClasses(), 0u );
 	size_t nbClassLess = 0;
+	const auto* classIdxCol = data.getClassIndexColumn();
 	for( auto idx: v_dpidx )
 	{
-		const auto& dp = data.getDataPoint( idx );
-		if( dp.isClassLess() )
+		auto cidx = classIdxCol[idx];
+		if( cidx == NoClassIndex )
 			nbClassLess++;
 		else
-			m[ dp.classVal() ]++;
+			vcount[ cidx ]++;
 	}
 	assert( nbClassLess < v_dpidx.size() );
 
 	return std::make_pair(
-		m,                              // the class counters
+		std::move( vcount ),            // the class counters
 		v_dpidx.size() - nbClassLess    // the number of relevant points
 	);
 }
 //---------------------------------------------------------------------
-/// Computes the Gini impurity value from the class count
-/**
-Input arg: map of class counts and relevant number of points
-
+/// Returns the nb of classes that have some points in the class count \c vcount
+inline
+size_t
+nbNonEmptyClasses( const ClassCountArray& vcount )
+{
+	return std::count_if( vcount.begin(), vcount.end(), []( size_t c ){ return c != 0; } );
+}
+//---------------------------------------------------------------------
+/// Computes the Gini impurity value from the class count
+/**
+Input arg: map of class counts and relevant number of points
+
 - See related getNodeClassCount()
 */
 double
@@ -2513,6 +4845,28 @@ getGiniImpurity(
 	assert( giniCoeff >= 0. );                        // has to be !!!
 	return giniCoeff;
 }
+/// Computes the Gini impurity value from the class count, given as an array indexed by the class index
+double
+getGiniImpurity(
+	const std::pair<ClassCountArray,size_t>& pcount
+)
+{
+	const auto& classVotes  = pcount.first;
+	const auto& nbpts = pcount.second;
+	assert( nbNonEmptyClasses( classVotes ) > 0 );
+	assert( nbpts > 0 );
+
+	double giniCoeff = 1.;
+	for( auto nb: classVotes )
+		if( nb )                   // so we get exactly the same value as with a map
+		{
+			auto v = 1. * nb / nbpts;
+			giniCoeff -= v*v;
+		}
+	COUT << "global Gini Coeff=" << giniCoeff << '\n';
+	assert( giniCoeff >= 0. );                        // has to be !!!
+	return giniCoeff;
+}
 
 
 //---------------------------------------------------------------------
@@ -2530,12 +4884,17 @@ We check the differences between two consecutive values: <br>
 If \f$ d < coeff * range \f$, then it will be considered as "too close".
 */
 size_t
-removeDuplicates( std::vector<float>& vec, const Params& params )
+removeDuplicates(
+	std::vector<float>& vec,
+	const Params&       params,
+	bool                isSorted = false   ///< set to true if values are already sorted (see Params::usePresortedAttributes)
+)
 {
 	auto mm = std::minmax_element( std::begin(vec), std::end(vec) )	;
 	auto k = (*mm.second - *mm.first) * params.removalCoeff;
 
-	std::sort( vec.begin(), vec.end() );
+	if( !isSorted )
+		std::sort( vec.begin(), vec.end() );
 
 // remove all values that are equal
 	auto it_end = std::unique(
@@ -2585,339 +4944,882 @@ struct AttributeData
 	}
 };
 
+//---------------------------------------------------------------------
+/// Name of the per-node data/plot files (without extension), see writeSplitSearchFiles()
+/**
+When doing k-fold cross validation, the fold index is added so that the folds do not overwrite each other files
+*/
+std::string
+nodeFileName( const char* prefix, uint nodeId, uint atIdx, int foldIndex )
+{
+	std::ostringstream oss;
+	oss << prefix << "_n" << nodeId << "_at" << atIdx;
+	if( foldIndex != -1 )
+		oss << "_f" << foldIndex;
+	return oss.str();
+}
+
 //---------------------------------------------------------------------
 #ifndef DTCPP_NEED_FOR_SPEED
-/// Generates for each node and each attribute a data/plot file to show how classes are distributed,
-/// depending on the threshold values
-void
-generateClassHistoPerTVal(
-	uint                      nodeId,      ///< node Id (only needed to plot data)
+/// Computes how classes are distributed between the threshold values (sorted ascending), see SplitSearchRecord::vClassHisto
+std::vector<uint32_t>
+classHistoPerTVal(
 	uint                      atIdx,       ///< current attribute index
 	const std::vector<float>& v_thresVal,  ///< threshold values for that attribute
 	const DataSet&            data,        ///< dataset
 	const std::vector<uint>&  v_dpidx      ///< indexes of considered points in dataset
 )
+{
+	START;
+	auto nbClasses = data.nbClasses();
+	std::vector<uint32_t> histo( (v_thresVal.size()+1) * nbClasses, 0u );
+	const auto* atCol   = data.getColumn( atIdx );
+	const auto& classIdxCol = data.getClassIndexColumn();
+	for( auto ptIdx: v_dpidx )
+		if( !data.isClassLess( ptIdx ) )
+		{
+			auto tIdx = std::upper_bound( v_thresVal.begin(), v_thresVal.end(), atCol[ptIdx] ) - v_thresVal.begin();
+			histo[ tIdx * nbClasses + classIdxCol[ptIdx] ]++;        // interval tIdx is [thres(tIdx-1), thres(tIdx)[
+		}
+	return histo;
+}
+#endif
+
+//---------------------------------------------------------------------
+/// Returns the labels of the classes of the dataset, as shown in the plots
+std::vector<std::string>
+classLabels( const DataSet& data )
+{
+	const auto& ibm  = data.getIndexBimap();
+	const auto& sibm = data.getStringIndexBimap();
+	std::vector<std::string> vLabels( data.nbClasses() );
+	for( uint i=0; i<(uint)data.nbClasses(); i++ )
+	{
+		std::ostringstream oss;
+		if( !sibm.size() )                     // if we don't have string classes
+			oss << "class " << ibm.right.at(i);
+		else
+			oss << i << ":" << sibm.right.at(i);
+		vLabels[i] = oss.str();
+	}
+	return vLabels;
+}
+
+//---------------------------------------------------------------------
+/// Writes the data/plot files of a threshold search, see SearchBestIG()
+/**
+- \c thres_nX_atY: for each threshold value, the number of points lower and higher than that value, and the associated IG
+- \c thresClassHisto_nX_atY: how classes are distributed, depending on the threshold values (only if
+SplitSearchRecord::vClassHisto is not empty)
+*/
+void
+writeSplitSearchFiles(
+	const SplitSearchRecord&        rec,
+	const std::string&              data_fn,   ///< data file name, printed in the files
+	const std::vector<std::string>& vLabels,   ///< class labels, see classLabels()
+	DiagSink&                       sink
+)
 {
 	START;
 	char sep = ' ';
+	const auto& v_thresVal = rec.vThresVal;
+	auto fname = nodeFileName( "thres", rec.nodeId, rec.atIdx, rec.foldIndex );
+	if( auto pfdata = sink.openFile( fname, priv::FT_DAT, data_fn ) )
+	{
+		*pfdata << "# thres_index thres_value nbPtsLower nbPtsHigher\n\n";
+		for( size_t i=0; i<v_thresVal.size(); i++ )
+			*pfdata << i << sep << v_thresVal[i] << sep << rec.vNbLT[i] << sep << rec.vNbHT[i] << sep << rec.vDeltaGini[i] << '\n';
+	}
 
-	std::ostringstream oss;
-	oss << "thresClassHisto_n" << nodeId << "_at" << atIdx;
-	auto fdata = priv::openOutputFile( oss.str(), priv::FT_DAT, data._fname );
+	if( auto pfplot = sink.openFile( fname, priv::FT_PLT, data_fn ) )
+	{
+		auto pwidth = std::min( (size_t)DTCPP_PLOT_MAX_WIDTH, 300+v_thresVal.size()*12 );
+		auto& fplot = *pfplot;
+		fplot << "\nset terminal pngcairo size " << pwidth << ",500\n"
+			<< "\nset datafile separator ' '"
+			<< "\nset grid"
+			<< "\nset xlabel 'Threshold index'"
+			<< "\nset xtics 1"
+			<< "\nset yrange [0:1]"
+			<< "\nset y2range [*:*]"
+			<< "\nset y2tics"
+			<< "\nset style data linespoints"
+			<< "\nset output '" << fname << ".png'"
+//			<< "\nset title 'Attribute " << rec.atIdx << " node " << rec.nodeId << " (" << rec.nbPoints << " pts)'"
+			<< "\nset xtics 1"
+			<< '\n';
+		if( v_thresVal.size() > 9 )
+			fplot << "set xtics 2\n";
+		if( v_thresVal.size() > 24 )
+			fplot << "set xtics 5\n";
+
+		fplot << "set xlabel '" << v_thresVal.size()
+			<< " threshold values'\nplot '" << fname
+			<< ".dat' using 1:(1.-abs($3-$4)/($3+$4)) lw 2 ti 'Pts balance',"
+			<< " '' using 1:5 lw 2 axes x1y2 ti 'IG'\n";
+	}
+
+	if( rec.vClassHisto.empty() || vLabels.empty() )
+		return;
+	auto nbClasses = vLabels.size();
+	assert( rec.vClassHisto.size() == (v_thresVal.size()+1) * nbClasses );
+
+	auto hname = nodeFileName( "thresClassHisto", rec.nodeId, rec.atIdx, rec.foldIndex );
+	auto pfdata = sink.openFile( hname, priv::FT_DAT, data_fn );
+	if( !pfdata )
+		return;
+	auto& fdata = *pfdata;
 
 	fdata << "# generated from function " << __FUNCTION__
-		<< "()\n\n# class content for node " << nodeId << ", attribute " << atIdx
+		<< "()\n\n# class content for node " << rec.nodeId << ", attribute " << rec.atIdx
 		<< "\n#  - nb of threshold values=" << v_thresVal.size()
-		<< "\n#  - nb of points=" << v_dpidx.size()
+		<< "\n#  - nb of points=" << rec.nbPoints
 		<< '\n';
 
-	assert( v_thresVal.size() );
-//	if( v_thresVal.size() < 2 )
-//		fdata << "# (empty data)\n";
-
 	fdata << "\n# Columns:\n# thres_index binLow binHigh";
-	for( size_t c=0; c<data.nbClasses(); c++ )
+	for( size_t c=0; c<nbClasses; c++ )
 		fdata << " C" << c;
 	fdata << "\n\n";
 
 	for( size_t tIdx=0; tIdx<v_thresVal.size()+1; tIdx++ )
 	{
-		std::map<uint,size_t> ccount;                            // a map to count the number of points of each class in each bin
-
-		for( size_t i=0; i<v_dpidx.size(); i++ )
-		{
-			const auto& dp = data.getDataPoint(i);
-			const auto& atVal = dp.attribVal(atIdx);
-			if( !dp.isClassLess() )
-			{
-				const auto& classIdx = data.getIndexFromClass( dp.classVal() );
-
-				if( tIdx == 0 )                              // if attribute value is less than first threshold value
-				{
-					if( atVal < v_thresVal.front() )
-						ccount[ classIdx ]++;
-				}
-				else
-				{
-					if( tIdx == v_thresVal.size() )          // if attribute value is higher than last threshold value
-					{
-						if( atVal >= v_thresVal.back() )
-							ccount[ classIdx ]++;
-					}
-					else                                     // if attribute value is between threshold values
-					{
-						if( atVal >= v_thresVal[tIdx] && atVal < v_thresVal[tIdx+1] )
-							ccount[ classIdx ]++;
-					}
-				}
-			}
-		}
-
 		fdata << tIdx << sep;
 		if( tIdx == 0 )
-			fdata << "-inf " << v_thresVal.front();
+			fdata << "-inf";
 		else
-			if( tIdx == v_thresVal.size() )
-				fdata << v_thresVal.back() << " +inf";
-			else
-				fdata << v_thresVal[tIdx] << sep << v_thresVal[tIdx+1];
+			fdata << v_thresVal[tIdx-1];
+		fdata << sep;
+		if( tIdx == v_thresVal.size() )
+			fdata << "+inf";
+		else
+			fdata << v_thresVal[tIdx];
 
-		for( uint i=0; i<(uint)data.nbClasses(); i++ )
-			fdata << sep << ccount[i];
+		for( size_t c=0; c<nbClasses; c++ )
+			fdata << sep << rec.vClassHisto[ tIdx*nbClasses + c ];
 		fdata << '\n';
 	}
 	fdata << "\n# (EOF)\n";
 
-	auto fplot = priv::openOutputFile( oss.str(), priv::FT_PLT, data._fname );
+	auto pfplot = sink.openFile( hname, priv::FT_PLT, data_fn );
+	if( !pfplot )
+		return;
+	auto& fplot = *pfplot;
 	auto imwidth = std::min( (size_t)DTCPP_PLOT_MAX_WIDTH, 300 + v_thresVal.size()*12 );
 	fplot << "\nset terminal pngcairo size " << imwidth << ",600"
-		<< "\nset output '" << oss.str() << ".png'"
-//		<< "\nset label 'file: " << data._fname << "' at screen 0.01, screen .98 noenhanced"
+		<< "\nset output '" << hname << ".png'"
 		<< "\nset style data histogram"
 		<< "\nset style histogram rowstacked"
 		<< "\nset style fill solid border -1"
 		<< "\nset boxwidth 0.75"
 		<< "\nset grid"
-//		<< "\nset title 'Node "<< nodeId << ", Attribute " << atIdx << " (" << v_dpidx.size() << " pts)'"
 		<< "\nset xlabel '" << v_thresVal.size() << " threshold values'";
 
-	fplot << "\nplot '" << oss.str() << ".dat' using 4:xtic(1) ti '";
-
-
-	const auto& ibm  = data.getIndexBimap();
-	const auto& sibm = data.getStringIndexBimap();
-
-	if( !sibm.size() )            // if we don't have string classes
-		fplot << "class " << ibm.right.at(0) << "'";
-	else
-		fplot << "0:" << sibm.right.at(0) << "'";
-
-	for( uint i=0; i<(uint)data.nbClasses()-1; i++ )
-	{
-		fplot << ", '' using " << 5+i << " ti '";
-		if( !sibm.size() )                     // if no strings, just print the index
-			fplot << "class " << ibm.right.at(i+1);
-		else
-			fplot << i+1 << ":" << sibm.right.at(i+1);
-		fplot << "'";
-	}
+	fplot << "\nplot '" << hname << ".dat' using 4:xtic(1) ti '" << vLabels[0] << "'";
+	for( size_t c=1; c<nbClasses; c++ )
+		fplot << ", '' using " << 4+c << " ti '" << vLabels[c] << "'";
 	fplot << '\n';
 }
-#endif
 
 //---------------------------------------------------------------------
-/// Computes for each of the given thresholds values (\c v_thresVal) all the
-/// IG values and returns the best one.
-/**
-This function also produces a data file named \c out/thres_nX_atY.dat
-(with \c X the node ID and Y the attribute index).
-This file will hold for each threshold value the number of points lower and higher
-than that value, and the associated IG.
-*/
-AttributeData
-SearchBestIG(
-	uint                      nodeId,      ///< node Id (only needed to plot data)
-	uint                      atIdx,       ///< current attribute index
-	double                    giniCoeff,   ///< global Gini coeff
-	const std::vector<float>& v_thresVal,  ///< threshold values
-	const DataSet&            data,        ///< dataset
-	const std::vector<uint>&  v_dpidx,     ///< indexes of considered points in dataset
-	std::ostream&             fhtml        ///< html page, opened in caller function
-)
+inline
+void
+DiagSink::addSplitSearch( const SplitSearchRecord& rec, const DataSet& data )
 {
-	START;
-	std::ostringstream oss;
-	oss << "thres_n" << nodeId << "_at" << atIdx;
-	auto fdata = priv::openOutputFile( oss.str(), priv::FT_DAT, data._fname );
-	char sep = ' ';
-	fdata << "# thres_index thres_value nbPtsLower nbPtsHigher\n\n";
+	writeSplitSearchFiles( rec, data._fname, classLabels( data ), *this );
+}
+//---------------------------------------------------------------------
+inline
+void
+DiagSink::addTree( const std::string& name, const TrainingTree& tree, int foldIndex )
+{
+	if( auto pf = openFile( priv::dotFileName( name, foldIndex ), priv::FT_DOT, std::string() ) )
+		tree.printDot( *pf );
+}
 
-	fhtml << "<td>\n <img src='" << oss.str()
-		<< ".png'><br>\n <img src='thresClassHisto_n" << nodeId << "_at" << atIdx
-		<< ".png'>\n</td>\n";
+//---------------------------------------------------------------------
+// % % % % % % % % % % % % % %
+namespace priv {
+// % % % % % % % % % % % % % %
 
-	auto pwidth = std::min( (size_t)DTCPP_PLOT_MAX_WIDTH, 300+v_thresVal.size()*12 );
-	auto fplot = priv::openOutputFile( oss.str(), priv::FT_PLT, data._fname );
-	fplot << "\nset terminal pngcairo size " << pwidth << ",500\n"
-		<< "\nset datafile separator ' '"
-		<< "\nset grid"
-		<< "\nset xlabel 'Threshold index'"
-		<< "\nset xtics 1"
-		<< "\nset yrange [0:1]"
-		<< "\nset y2range [*:*]"
-		<< "\nset y2tics"
-		<< "\nset style data linespoints"
-		<< "\nset output '" << oss.str() << ".png'"
-//		<< "\nset title 'Attribute " << atIdx << " node " << nodeId << " (" << v_dpidx.size() << " pts)'"
-		<< "\nset xtics 1"
-		<< '\n';
-	if( v_thresVal.size() > 9 )
-		fplot << "set xtics 2\n";
-	if( v_thresVal.size() > 24 )
-		fplot << "set xtics 5\n";
+//---------------------------------------------------------------------
+/// Class counters used by the split kernels: fixed-size array for a number of classes \c K known at build time
+template<size_t K>
+struct KClassCounts
+{
+	explicit KClassCounts( size_t ) {}
+	static constexpr size_t size() { return K; }
+	size_t&       operator [] ( size_t c )       { return _count[c]; }
+	const size_t& operator [] ( size_t c ) const { return _count[c]; }
 
-	fplot << "set xlabel '" << v_thresVal.size()
-		<< " threshold values'\nplot '" << oss.str()
-		<< ".dat' using 1:(1.-abs($3-$4)/($3+$4)) lw 2 ti 'Pts balance',"
-		<< " '' using 1:5 lw 2 axes x1y2 ti 'IG'\n";
+	std::array<size_t,K> _count{};
+};
 
-#ifndef DTCPP_NEED_FOR_SPEED
-	generateClassHistoPerTVal( nodeId, atIdx, v_thresVal, data, v_dpidx );
-#endif
+/// Generic version (K=0), for any number of classes
+template<>
+struct KClassCounts<0>
+{
+	explicit KClassCounts( size_t nbClasses ) : _count( nbClasses, 0u ) {}
+	size_t size() const { return _count.size(); }
+	size_t&       operator [] ( size_t c )       { return _count[c]; }
+	const size_t& operator [] ( size_t c ) const { return _count[c]; }
 
-	std::vector<float> deltaGini( v_thresVal.size() );   // one value per threshold
-	std::vector<uint> nb_LT( v_thresVal.size(), 0u );    // will hold the nb of points lying below the threshold
-	for( size_t i=0; i<v_thresVal.size(); i++ )          // for each threshold value
-	{
-//		COUT << "thres " << i << "=" << v_thresVal[i] << '\n';
-		ClassCounter m_LT, m_HT;
+	std::vector<size_t> _count;
+};
 
-		size_t nb_HT = 0;
-		for( auto ptIdx: v_dpidx )                         // for each data point
+//---------------------------------------------------------------------
+/// Gini impurity kernel, for \c K classes (K=0: any number), see getGiniImpurity()
+/**
+With K known at build time, the loop gets unrolled. Null counts are skipped and classes processed in index order,
+so all the versions return exactly the same value.
+*/
+template<size_t K>
+double
+kernelGini( const ClassCountArray& vcount, size_t nbpts )
+{
+	assert( K == 0 || vcount.size() == K );
+	const size_t nbClasses = K ? K : vcount.size();
+	double giniCoeff = 1.;
+	for( size_t c=0; c<nbClasses; c++ )
+		if( vcount[c] )
 		{
-			const auto& point = data.getDataPoint(ptIdx);
-			if( !point.isClassLess() )
-			{
-				auto attribVal = point.attribVal( atIdx );
-#ifdef HANDLE_MISSING_VALUES
-				bool usePoint = true;
-				if( point.valueIsMissing( atIdx ) )
-				{
-					switch( DataSet::s_MissingValueStrategy )
-					{
-						case En_MVS::disablePoint: usePoint=false; break;
-						case En_MVS::setToMean: assert(0); ///\todoM we need to have access to the dataset stats
-							//attribVal = MEAN_VALUE_OF ATTRIBUTE
-						break;
-						default: assert(0);
-					}
-				}
-				if( usePoint )
-#endif
-				{
-					if( attribVal < v_thresVal[i] )
-					{
-						m_LT[ point.classVal() ]++;
-						nb_LT[i]++;
-					}
-					else
-					{
-						m_HT[ point.classVal() ]++;
-						nb_HT++;
-					}
-				}
-			}
+			auto v = 1. * vcount[c] / nbpts;
+			giniCoeff -= v*v;
 		}
-
-		auto g_LT = 1.;
-		for( auto p: m_LT )  // for the values that are Lower Than the threshold
+	return giniCoeff;
+}
+//---------------------------------------------------------------------
+/// Dominant class kernel, for \c K classes (K=0: any number), same as priv1::findDominantClass()
+template<size_t K>
+priv1::DominantClassInfo<size_t>
+kernelDominantClass( const ClassCountArray& vcount )
+{
+	assert( K == 0 || vcount.size() == K );
+	const size_t nbClasses = K ? K : vcount.size();
+	size_t vmax  = 0u;
+	size_t vmax2 = vmax;
+	size_t cmax  = size_t(-1);  // no class
+	for( size_t c=0; c<nbClasses; c++ )
+		if( vcount[c] > vmax )
 		{
-			auto val = 1. * p.second / nb_LT[i];
-			g_LT -= val*val;
+			vmax2 = vmax;
+			vmax = vcount[c];
+			cmax = c;
 		}
+	assert( vmax>0 );
+	return priv1::DominantClassInfo<size_t>{ cmax, vmax, 1.f * vmax2/vmax };
+}
+//---------------------------------------------------------------------
+/// Delta Gini sweep kernel, for \c K classes (K=0: any number), see computeDeltaGini()
+/**
+\c v_pts holds the (attribute value, class index) pairs, sorted on value, and \c v_thresIdx the indexes of the thresholds,
+in increasing value order.
+*/
+template<size_t K>
+void
+kernelSweepDeltaGini(
+	const std::vector<std::pair<float,ClassIndex>>& v_pts,
+	const ClassCountArray&    vcount_all,  ///< nb of points of each class in \c v_pts
+	double                    giniCoeff,
+	const std::vector<float>& v_thresVal,
+	const std::vector<size_t>& v_thresIdx,
+	std::vector<float>&       deltaGini,
+	std::vector<uint>&        nb_LT,
+	std::vector<size_t>&      nb_HT
+)
+{
+	KClassCounts<K> count_all( vcount_all.size() );
+	KClassCounts<K> count_LT( vcount_all.size() );
+	assert( count_all.size() == vcount_all.size() );
+	for( size_t c=0; c<count_all.size(); c++ )
+		count_all[c] = vcount_all[c];
+
+	size_t pos = 0;
+	for( auto i: v_thresIdx )
+	{
+		for( ; pos<v_pts.size() && v_pts[pos].first < v_thresVal[i]; pos++ )
+			count_LT[ v_pts[pos].second ]++;
+		nb_LT[i] = pos;
+		nb_HT[i] = v_pts.size() - pos;
 
+		auto g_LT = 1.;
 		auto g_HT = 1.;
-		for( auto p: m_HT )  // for the values that are Higher Than the threshold
+		for( size_t c=0; c<count_all.size(); c++ )
 		{
-			auto val = 1. * p.second / nb_HT;
-			g_HT -= val*val;
+			if( count_LT[c] )        // for the values that are Lower Than the threshold
+			{
+				auto val = 1. * count_LT[c] / nb_LT[i];
+				g_LT -= val*val;
+			}
+			auto count_HT = count_all[c] - count_LT[c];
+			if( count_HT )           // for the values that are Higher Than the threshold
+			{
+				auto val = 1. * count_HT / nb_HT[i];
+				g_HT -= val*val;
+			}
 		}
 		deltaGini[i] = giniCoeff - (g_LT + g_HT) / 2.;
-
-		fdata << i << sep << v_thresVal[i] << sep << nb_LT[i] << sep << nb_HT << sep << deltaGini[i] << '\n';
 	}
-
-// step 3 - find max value of the delta Gini
-	auto max_pos = std::max_element( std::begin( deltaGini ), std::end( deltaGini ) );
-//	auto max_pos = std::min_element( std::begin( deltaGini ), std::end( deltaGini ) );
-
-	auto best_thres_idx = std::distance( std::begin( deltaGini ), max_pos );
-
-	LOG( 3, "Best threshold for attribute=" <<  atIdx << " among " << v_thresVal.size() << " values is at pos " << best_thres_idx << "=" << v_thresVal.at( best_thres_idx ) );
-	return AttributeData(
-		atIdx,
-		*max_pos,
-		ThresholdVal(v_thresVal.at( best_thres_idx ) ),
-		nb_LT.at( best_thres_idx )
-	);
 }
-
 //---------------------------------------------------------------------
-/// Helper function, builds the vector of threshold values using sorting of the attribute values
-bool
-thres_useSorting(
-	uint                     atIdx,
-	const std::vector<uint>& v_dpidx,
-	const DataSet&           data,
-	const Params&            params,    ///< run-time parameters
-	std::vector<float>&      v_thresVal    ///< output vector
+/// Binary class version of the sweep: only the points of class 0 need to be counted
+template<>
+void
+kernelSweepDeltaGini<2>(
+	const std::vector<std::pair<float,ClassIndex>>& v_pts,
+	const ClassCountArray&    vcount_all,
+	double                    giniCoeff,
+	const std::vector<float>& v_thresVal,
+	const std::vector<size_t>& v_thresIdx,
+	std::vector<float>&       deltaGini,
+	std::vector<uint>&        nb_LT,
+	std::vector<size_t>&      nb_HT
 )
 {
-	std::vector<float> v_attribVal( v_dpidx.size() ); // pre-allocate vector size (faster than push_back)
-	for( size_t i=0; i<v_dpidx.size(); i++ )
-		v_attribVal[i] = data.getDataPoint( v_dpidx[i] ).attribVal( atIdx );
-
-	auto nbRemoval = removeDuplicates( v_attribVal, params );
-	LOG( 3, "Removal of " << nbRemoval << " attribute values over " << v_dpidx.size() << " points" );
+	assert( vcount_all.size() == 2 );
+	auto gini2 = []( size_t n0, size_t n1, size_t n )   // lambda
+	{
+		auto g = 1.;
+		if( n0 )
+		{
+			auto val = 1. * n0 / n;
+			g -= val*val;
+		}
+		if( n1 )
+		{
+			auto val = 1. * n1 / n;
+			g -= val*val;
+		}
+		return g;
+	};
 
-	if( v_attribVal.size() < 2 )         // if only one value, is pointless
+	size_t lt0 = 0;
+	size_t pos = 0;
+	for( auto i: v_thresIdx )
 	{
-		LOG( 3, "WARNING, unable to compute best threshold value for attribute " << atIdx << ", maybe check value of 'removalCoeff'" );
-		return false;
+		for( ; pos<v_pts.size() && v_pts[pos].first < v_thresVal[i]; pos++ )
+			lt0 += ( v_pts[pos].second == 0 );
+		nb_LT[i] = pos;
+		nb_HT[i] = v_pts.size() - pos;
+
+		auto lt1 = pos - lt0;
+		auto g_LT = gini2( lt0, lt1, nb_LT[i] );
+		auto g_HT = gini2( vcount_all[0] - lt0, vcount_all[1] - lt1, nb_HT[i] );
+		deltaGini[i] = giniCoeff - (g_LT + g_HT) / 2.;
 	}
-
-	v_thresVal.resize( v_attribVal.size()-1 );      // if 10 values, then only 9 thresholds
-	for( uint i=0; i<v_thresVal.size(); i++ )
-		v_thresVal[i] = ( v_attribVal.at(i) + v_attribVal.at(i+1) ) / 2.f; // threshold is mean value between the 2 attribute values
-	return true;
 }
 //---------------------------------------------------------------------
-/// Helper function, builds the vector of threshold values using histograms
-bool
-thres_useHistograms(
-	uint                     atIdx,     ///< attribute index we want to process
-	const std::vector<uint>& v_dpidx,   ///< datapoint indexes to consider
-	const DataSet&           data,
-	std::vector<float>&      v_thresVal    ///< output vector
-)
+/// Holds the split evaluation kernels to be used for a given number of classes, see selectSplitKernels()
+struct SplitKernels
 {
-	using PairAtvalClass = std::pair<float,ClassVal>;
-	std::vector<PairAtvalClass> v_pac( v_dpidx.size() ); // pre-allocate vector size (faster than push_back)
-	for( size_t i=0; i<v_dpidx.size(); i++ )
-	{
-		const auto& pt = data.getDataPoint( v_dpidx[i] );
-		if( !pt.isClassLess() )
-			v_pac[i] = std::make_pair( pt.attribVal( atIdx ), pt.classVal() );
-	}
+	size_t nbClasses = 0;          ///< nb of classes the kernels are specialized for (0: generic versions)
+
+	double (*gini)( const ClassCountArray&, size_t ) = kernelGini<0>;
+	priv1::DominantClassInfo<size_t> (*dominantClass)( const ClassCountArray& ) = kernelDominantClass<0>;
+	void (*sweepDeltaGini)(
+		const std::vector<std::pair<float,ClassIndex>>&,
+		const ClassCountArray&,
+		double,
+		const std::vector<float>&,
+		const std::vector<size_t>&,
+		std::vector<float>&,
+		std::vector<uint>&,
+		std::vector<size_t>&
+	) = kernelSweepDeltaGini<0>;
+};
 
-	auto pair_vb = getThresholds<float,ClassVal>( v_pac, 20 );
-	v_thresVal = std::move(pair_vb.first);
-	if( pair_vb.second == false )
-	{
-		LOG( 3, "WARNING, unable to fetch threshold value for attribute " << atIdx );
-		return false;
-	}
-	return true;
+/// Returns the kernels specialized for \c K classes
+template<size_t K>
+SplitKernels
+makeSplitKernels()
+{
+	SplitKernels sk;
+	sk.nbClasses      = K;
+	sk.gini           = kernelGini<K>;
+	sk.dominantClass  = kernelDominantClass<K>;
+	sk.sweepDeltaGini = kernelSweepDeltaGini<K>;
+	return sk;
 }
-
 //---------------------------------------------------------------------
-/// Compute best threshold for attribute \c atIdx, using the Gini Impurity, for the subset of data given by \c v_dpidx.
+/// Returns the split evaluation kernels to use for \c nbClasses classes: specialized versions for 2 to 8 classes, generic versions otherwise
 /**
-\return an object of type AttributeData
+This is done once at the beginning of the training (see TrainingTree::train()), the kernels are then handed over to the
+functions evaluating the splits.
+*/
+inline
+SplitKernels
+selectSplitKernels( size_t nbClasses )
+{
+	switch( nbClasses )
+	{
+		case 2: return makeSplitKernels<2>();
+		case 3: return makeSplitKernels<3>();
+		case 4: return makeSplitKernels<4>();
+		case 5: return makeSplitKernels<5>();
+		case 6: return makeSplitKernels<6>();
+		case 7: return makeSplitKernels<7>();
+		case 8: return makeSplitKernels<8>();
+		default: return SplitKernels();
+	}
+}
 
-This function actually computes a set of thresholds, then calls SearchBestIG() to find the best one.
+// % % % % % % % % % % % % % %
+} // namespace priv
+// % % % % % % % % % % % % % %
 
-Details:
-- Uses the Gini impurity coeff: https://en.wikipedia.org/wiki/Decision_tree_learning#Gini_impurity
-- for details, see
- - https://en.wikipedia.org/wiki/Information_gain_in_decision_trees
- - https://towardsdatascience.com/under-the-hood-decision-tree-454f8581684e
+// % % % % % % % % % % % % % %
+namespace priv {
+// % % % % % % % % % % % % % %
 
-\todoM problem: for a given attribute here, we might have (after processing the histogram of attribute values) all the points having same class.
-Thus, unable to find a threshold. How do we manage that
-*/
-//template<typename T>
-AttributeData
+//---------------------------------------------------------------------
+/// Tells if a point is used to evaluate the thresholds of an attribute: classless points are not, and
+/// neither are the points having a missing value for that attribute (depending on DataSet::s_MissingValueStrategy)
+class UsablePointFilter
+{
+	public:
+		UsablePointFilter( const DataSet& data, uint atIdx )
+			: _classIdxCol( data.getClassIndexColumn() )
+#ifdef HANDLE_MISSING_VALUES
+			, _missBm( data.getMissingBitmap( atIdx ) )   // null if no missing values for that attribute
+#endif
+		{
+			(void)atIdx;
+		}
+
+		bool operator () ( uint ptIdx ) const
+		{
+			if( _classIdxCol[ptIdx] == NoClassIndex )
+				return false;
+#ifdef HANDLE_MISSING_VALUES
+			if( _missBm && priv::testBit( _missBm, ptIdx ) )
+			{
+				switch( DataSet::s_MissingValueStrategy )
+				{
+					case En_MVS::disablePoint: return false;
+					case En_MVS::setToMean: assert(0); ///\todoM we need to have access to the dataset stats
+						//attribVal = MEAN_VALUE_OF ATTRIBUTE
+					break;
+					default: assert(0);
+				}
+			}
+#endif
+			return true;
+		}
+
+	private:
+		const ClassIndex* _classIdxCol;
+#ifdef HANDLE_MISSING_VALUES
+		const uint64_t*   _missBm;
+#endif
+};
+
+//---------------------------------------------------------------------
+/// Returns the indexes of the threshold values \c v_thresVal, in increasing value order
+std::vector<size_t>
+thresholdOrder( const std::vector<float>& v_thresVal )
+{
+	std::vector<size_t> v_thresIdx( v_thresVal.size() );
+	std::iota( v_thresIdx.begin(), v_thresIdx.end(), 0 );
+	if( !std::is_sorted( v_thresVal.begin(), v_thresVal.end() ) )
+		std::stable_sort(
+			v_thresIdx.begin(),
+			v_thresIdx.end(),
+			[&v_thresVal]( size_t i1, size_t i2 ){ return v_thresVal[i1] < v_thresVal[i2]; } // lambda
+		);
+	return v_thresIdx;
+}
+
+//---------------------------------------------------------------------
+/// Computes the delta Gini value of each threshold, given for each class the nb of points lying in each interval between two
+/// consecutive thresholds: <code>vcount[j*nbClasses+c]</code> is the nb of points of class \c c that are lower than threshold
+/// <code>v_thresIdx[j]</code>, but not lower than the previous one (the last interval holds the points above all the thresholds).
+/**
+The Gini values are computed exactly as in the sweep kernels (see kernelSweepDeltaGini()), so the results are the same.
+*/
+void
+deltaGiniFromBinCounts(
+	double                       giniCoeff,
+	const std::vector<size_t>&   v_thresIdx,   ///< threshold indexes, in increasing value order
+	const std::vector<uint32_t>& vcount,       ///< class counts of each interval
+	size_t                       nbClasses,
+	std::vector<float>&          deltaGini,
+	std::vector<uint>&           nb_LT,
+	std::vector<size_t>&         nb_HT
+)
+{
+	auto nbThres = v_thresIdx.size();
+	assert( vcount.size() == (nbThres+1) * nbClasses );
+	ClassCountArray count_all( nbClasses, 0u );
+	size_t nbPts = 0;
+	for( size_t i=0; i<vcount.size(); i++ )
+	{
+		count_all[ i % nbClasses ] += vcount[i];
+		nbPts += vcount[i];
+	}
+
+	deltaGini.resize( nbThres );
+	nb_LT.assign( nbThres, 0u );
+	nb_HT.assign( nbThres, 0u );
+	ClassCountArray count_LT( nbClasses, 0u );
+	size_t pos = 0;
+	for( size_t j=0; j<nbThres; j++ )
+	{
+		auto i = v_thresIdx[j];
+		for( size_t c=0; c<nbClasses; c++ )
+		{
+			count_LT[c] += vcount[ j*nbClasses + c ];
+			pos         += vcount[ j*nbClasses + c ];
+		}
+		nb_LT[i] = pos;
+		nb_HT[i] = nbPts - pos;
+
+		auto g_LT = 1.;
+		auto g_HT = 1.;
+		for( size_t c=0; c<nbClasses; c++ )
+		{
+			if( count_LT[c] )        // for the values that are Lower Than the threshold
+			{
+				auto val = 1. * count_LT[c] / nb_LT[i];
+				g_LT -= val*val;
+			}
+			auto count_HT = count_all[c] - count_LT[c];
+			if( count_HT )           // for the values that are Higher Than the threshold
+			{
+				auto val = 1. * count_HT / nb_HT[i];
+				g_HT -= val*val;
+			}
+		}
+		deltaGini[i] = giniCoeff - (g_LT + g_HT) / 2.;
+	}
+}
+
+// % % % % % % % % % % % % % %
+} // namespace priv
+// % % % % % % % % % % % % % %
+
+//---------------------------------------------------------------------
+/// Helper function for computeDeltaGini(), computes the delta Gini values by splitting the points into blocks, processed concurrently
+/**
+Each block of \c v_dpidx is handled by a task, that counts for each class the points lying in each interval between two
+consecutive thresholds (found by binary search, so the points need not be sorted).
+These counts are then summed over the blocks, and the delta Gini values are computed from them, see priv::deltaGiniFromBinCounts().
+*/
+void
+deltaGiniByBlocks(
+	uint                       atIdx,
+	double                     giniCoeff,
+	const std::vector<float>&  v_thresVal,
+	const std::vector<size_t>& v_thresIdx,   ///< threshold indexes, in increasing value order
+	const DataSet&             data,
+	const std::vector<uint>&   v_dpidx,
+	const priv::UsablePointFilter& usePoint, ///< returns false for the points that must be ignored
+	priv::ThreadPool&          pool,
+	std::vector<float>&        deltaGini,
+	std::vector<uint>&         nb_LT,
+	std::vector<size_t>&       nb_HT
+)
+{
+	const auto* atCol       = data.getColumn( atIdx );
+	const auto* classIdxCol = data.getClassIndexColumn();
+	auto nbClasses = data.nbClasses();
+	auto nbThres   = v_thresIdx.size();
+
+	std::vector<float> v_sortedThres( nbThres );
+	for( size_t j=0; j<nbThres; j++ )
+		v_sortedThres[j] = v_thresVal[ v_thresIdx[j] ];
+
+// step 1 - in each block, count the points of each class in each interval: interval j holds the
+// points that are lower than threshold j, but not lower than threshold j-1
+	auto nbBlocks = pool.nbThreads();
+	auto nbCounts = (nbThres+1) * nbClasses;
+	std::vector<std::vector<uint32_t>> v_blockCount( nbBlocks );
+	pool.parallelFor(
+		nbBlocks,
+		[&]( size_t b )                                      // lambda
+		{
+			auto& vcount = v_blockCount[b];
+			vcount.assign( nbCounts, 0u );
+			auto first = v_dpidx.begin() + b * v_dpidx.size() / nbBlocks;
+			auto last  = v_dpidx.begin() + (b+1) * v_dpidx.size() / nbBlocks;
+			for( auto it=first; it!=last; it++ )
+				if( usePoint( *it ) )
+				{
+					auto j = std::upper_bound( v_sortedThres.begin(), v_sortedThres.end(), atCol[*it] ) - v_sortedThres.begin();
+					vcount[ j*nbClasses + classIdxCol[*it] ]++;
+				}
+		}
+	);
+
+// step 2 - merge the blocks
+	auto& vcount = v_blockCount[0];
+	for( size_t b=1; b<nbBlocks; b++ )
+		for( size_t i=0; i<nbCounts; i++ )
+			vcount[i] += v_blockCount[b][i];
+
+// step 3 - single evaluation of the gain, for each threshold
+	priv::deltaGiniFromBinCounts( giniCoeff, v_thresIdx, vcount, nbClasses, deltaGini, nb_LT, nb_HT );
+}
+//---------------------------------------------------------------------
+/// Computes for each of the given thresholds values (\c v_thresVal) the delta Gini value, in a single sweep over the points
+/**
+The (attribute value, class) pairs of the points are sorted once (unless \c isSorted is true, meaning that \c v_dpidx
+is already sorted on the attribute value, see Params::usePresortedAttributes), then the thresholds are processed in
+increasing order, while updating the class counts of the points lying below the current threshold.
+This is \f$ O(n.log(n) + t.k) \f$ instead of \f$ O(n.t.log(k)) \f$ (n: nb of points, t: nb of thresholds, k: nb of classes).
+
+The Gini values are summed in increasing class value order, so the results are exactly the ones given by
+individually counting the points for each threshold.
+
+Classless points are ignored.
+
+The sweep itself is done by the kernel given by \c pKernels, or if null, by the one fitting the number of classes of \c data
+(see priv::selectSplitKernels()).
+
+If \c pPool is given (see Params::blockSplitMinSize), the points are not sorted but processed by blocks on several threads,
+see deltaGiniByBlocks(). This is not done if \c v_dpidx is already sorted, or if there are too many thresholds
+(more count values than points).
+*/
+void
+computeDeltaGini(
+	uint                      atIdx,       ///< attribute index
+	double                    giniCoeff,   ///< global Gini coeff
+	const std::vector<float>& v_thresVal,  ///< threshold values
+	const DataSet&            data,        ///< dataset
+	const std::vector<uint>&  v_dpidx,     ///< indexes of considered points in dataset
+	bool                      isSorted,    ///< true if \c v_dpidx is sorted on attribute value
+	std::vector<float>&       deltaGini,   ///< output: one value per threshold
+	std::vector<uint>&        nb_LT,       ///< output: nb of points lying below each threshold
+	std::vector<size_t>&      nb_HT,       ///< output: nb of points lying above (or equal to) each threshold
+	const priv::SplitKernels* pKernels = nullptr, ///< kernels to use, selected once per training
+	priv::ThreadPool*         pPool    = nullptr  ///< if not null, used to process the points by blocks
+)
+{
+	const auto* atCol       = data.getColumn( atIdx );
+	const auto* classIdxCol = data.getClassIndexColumn();
+	priv::UsablePointFilter usePoint( data, atIdx );
+
+// step 1 - the thresholds, in increasing order
+	auto v_thresIdx = priv::thresholdOrder( v_thresVal );
+
+	auto nbClasses = data.nbClasses();
+	if( pPool && pPool->nbThreads() > 1 && !isSorted && (v_thresVal.size()+1) * nbClasses * pPool->nbThreads() <= v_dpidx.size() )
+	{
+		deltaGiniByBlocks( atIdx, giniCoeff, v_thresVal, v_thresIdx, data, v_dpidx, usePoint, *pPool, deltaGini, nb_LT, nb_HT );
+		return;
+	}
+
+// step 2 - the (value,class index) pairs, sorted on value
+	std::vector<std::pair<float,ClassIndex>> v_pts;
+	v_pts.reserve( v_dpidx.size() );
+	ClassCountArray count_all( nbClasses, 0u );
+	for( auto ptIdx: v_dpidx )
+		if( usePoint( ptIdx ) )
+		{
+			auto cidx = classIdxCol[ptIdx];
+			v_pts.emplace_back( atCol[ptIdx], cidx );
+			count_all[cidx]++;
+		}
+	if( !isSorted )
+		std::sort(
+			v_pts.begin(),
+			v_pts.end(),
+			[]( const std::pair<float,ClassIndex>& p1, const std::pair<float,ClassIndex>& p2 ){ return p1.first < p2.first; } // lambda
+		);
+
+// step 3 - the sweep
+	deltaGini.resize( v_thresVal.size() );
+	nb_LT.assign( v_thresVal.size(), 0u );
+	nb_HT.assign( v_thresVal.size(), 0u );
+	if( pKernels )
+	{
+		assert( pKernels->nbClasses == 0 || pKernels->nbClasses == nbClasses );
+		pKernels->sweepDeltaGini( v_pts, count_all, giniCoeff, v_thresVal, v_thresIdx, deltaGini, nb_LT, nb_HT );
+	}
+	else
+		priv::selectSplitKernels( nbClasses ).sweepDeltaGini( v_pts, count_all, giniCoeff, v_thresVal, v_thresIdx, deltaGini, nb_LT, nb_HT );
+}
+//---------------------------------------------------------------------
+/// Computes for each of the given thresholds values (\c v_thresVal) all the
+/// IG values and returns the best one.
+/**
+If a diagnostic sink is given, this function also hands it the details of the search (see DiagSink::addSplitSearch()).
+By default, this produces a data file named \c thres_nX_atY.dat
+(with \c X the node ID and Y the attribute index, and a \c _fZ suffix for fold Z, see nodeFileName()).
+This file will hold for each threshold value the number of points lower and higher
+than that value, and the associated IG (see writeSplitSearchFiles()).
+*/
+AttributeData
+SearchBestIG(
+	uint                      nodeId,      ///< node Id (only needed to plot data)
+	uint                      atIdx,       ///< current attribute index
+	double                    giniCoeff,   ///< global Gini coeff
+	const std::vector<float>& v_thresVal,  ///< threshold values
+	const DataSet&            data,        ///< dataset
+	const std::vector<uint>&  v_dpidx,     ///< indexes of considered points in dataset
+	std::ostream&             fhtml,       ///< html page, opened in caller function
+	bool                      isSorted = false,  ///< true if \c v_dpidx is sorted on attribute value
+	const priv::SplitKernels* pKernels = nullptr, ///< kernels to use (if null, selected from the nb of classes)
+	priv::ThreadPool*         pPool    = nullptr, ///< if not null, the points are processed by blocks, see computeDeltaGini()
+	int                       foldIndex = -1,     ///< fold index, only used to name the files, see Params::foldIndex
+	DiagSink*                 pSink    = nullptr  ///< if not null (and enabled), receives the outcome of the search
+)
+{
+	START;
+	bool diag = pSink && pSink->enabled();
+	if( diag && pSink->htmlReport() )
+		fhtml << "<td>\n <img src='" << nodeFileName( "thres", nodeId, atIdx, foldIndex )
+			<< ".png'><br>\n <img src='" << nodeFileName( "thresClassHisto", nodeId, atIdx, foldIndex )
+			<< ".png'>\n</td>\n";
+
+	std::vector<float>  deltaGini;   // one value per threshold
+	std::vector<uint>   nb_LT;       // will hold the nb of points lying below the threshold
+	std::vector<size_t> nb_HT;
+	computeDeltaGini( atIdx, giniCoeff, v_thresVal, data, v_dpidx, isSorted, deltaGini, nb_LT, nb_HT, pKernels, pPool );
+
+	if( diag )
+	{
+		SplitSearchRecord rec;
+		rec.nodeId     = nodeId;
+		rec.atIdx      = atIdx;
+		rec.foldIndex  = foldIndex;
+		rec.nbPoints   = v_dpidx.size();
+		rec.vThresVal  = v_thresVal;
+		rec.vNbLT.assign( nb_LT.begin(), nb_LT.end() );
+		rec.vNbHT.assign( nb_HT.begin(), nb_HT.end() );
+		rec.vDeltaGini = deltaGini;
+#ifndef DTCPP_NEED_FOR_SPEED
+		rec.vClassHisto = classHistoPerTVal( atIdx, v_thresVal, data, v_dpidx );
+#endif
+		pSink->addSplitSearch( rec, data );
+	}
+
+// step 3 - find max value of the delta Gini
+	auto max_pos = std::max_element( std::begin( deltaGini ), std::end( deltaGini ) );
+//	auto max_pos = std::min_element( std::begin( deltaGini ), std::end( deltaGini ) );
+
+	auto best_thres_idx = std::distance( std::begin( deltaGini ), max_pos );
+
+	LOG( 3, "Best threshold for attribute=" <<  atIdx << " among " << v_thresVal.size() << " values is at pos " << best_thres_idx << "=" << v_thresVal.at( best_thres_idx ) );
+	return AttributeData(
+		atIdx,
+		*max_pos,
+		ThresholdVal(v_thresVal.at( best_thres_idx ) ),
+		nb_LT.at( best_thres_idx )
+	);
+}
+
+//---------------------------------------------------------------------
+/// Helper function for thres_useSorting(), builds the vector of threshold values from the attribute values of the points
+/// (\c v_attribVal, that gets sorted and cleared of its duplicates)
+bool
+thres_fromValues(
+	uint                     atIdx,
+	std::vector<float>&      v_attribVal,  ///< attribute values of the points, in any order (unless \c isSorted)
+	const Params&            params,       ///< run-time parameters
+	std::vector<float>&      v_thresVal,   ///< output vector
+	bool                     isSorted = false
+)
+{
+	auto nbPts = v_attribVal.size();
+	auto nbRemoval = removeDuplicates( v_attribVal, params, isSorted );
+	LOG( 3, "Removal of " << nbRemoval << " attribute values over " << nbPts << " points" );
+
+	if( v_attribVal.size() < 2 )         // if only one value, is pointless
+	{
+		LOG( 3, "WARNING, unable to compute best threshold value for attribute " << atIdx << ", maybe check value of 'removalCoeff'" );
+		return false;
+	}
+
+	v_thresVal.resize( v_attribVal.size()-1 );      // if 10 values, then only 9 thresholds
+	for( uint i=0; i<v_thresVal.size(); i++ )
+		v_thresVal[i] = ( v_attribVal.at(i) + v_attribVal.at(i+1) ) / 2.f; // threshold is mean value between the 2 attribute values
+	return true;
+}
+//---------------------------------------------------------------------
+/// Helper function, builds the vector of threshold values using sorting of the attribute values
+/**
+If \c isSorted is true, then the indexes in \c v_dpidx are already sorted on the attribute value,
+so this is linear in the nb of points.
+*/
+bool
+thres_useSorting(
+	uint                     atIdx,
+	const std::vector<uint>& v_dpidx,
+	const DataSet&           data,
+	const Params&            params,    ///< run-time parameters
+	std::vector<float>&      v_thresVal,   ///< output vector
+	bool                     isSorted = false
+)
+{
+	std::vector<float> v_attribVal( v_dpidx.size() ); // pre-allocate vector size (faster than push_back)
+	const auto* atCol = data.getColumn( atIdx );
+	for( size_t i=0; i<v_dpidx.size(); i++ )
+		v_attribVal[i] = atCol[ v_dpidx[i] ];
+	return thres_fromValues( atIdx, v_attribVal, params, v_thresVal, isSorted );
+}
+//---------------------------------------------------------------------
+/// Helper function for thres_useHistograms(), builds the vector of threshold values from the (attribute value, class index)
+/// pairs of the points (the classless points must not be given)
+bool
+thres_fromPairs(
+	uint                                             atIdx,
+	const std::vector<std::pair<float,ClassIndex>>& v_pac,
+	std::vector<float>&                              v_thresVal    ///< output vector
+)
+{
+	if( v_pac.size() < 2 )
+	{
+		LOG( 3, "WARNING, not enough points to fetch threshold value for attribute " << atIdx );
+		return false;
+	}
+
+	auto pair_vb = getThresholds<float,ClassIndex>( v_pac, 20 );
+	v_thresVal = std::move(pair_vb.first);
+	if( pair_vb.second == false )
+	{
+		LOG( 3, "WARNING, unable to fetch threshold value for attribute " << atIdx );
+		return false;
+	}
+	return true;
+}
+//---------------------------------------------------------------------
+/// Helper function, builds the vector of threshold values using histograms
+bool
+thres_useHistograms(
+	uint                     atIdx,     ///< attribute index we want to process
+	const std::vector<uint>& v_dpidx,   ///< datapoint indexes to consider
+	const DataSet&           data,
+	std::vector<float>&      v_thresVal    ///< output vector
+)
+{
+	using PairAtvalClass = std::pair<float,ClassIndex>;
+	std::vector<PairAtvalClass> v_pac;
+	v_pac.reserve( v_dpidx.size() );
+	const auto* atCol       = data.getColumn( atIdx );
+	const auto* classIdxCol = data.getClassIndexColumn();
+	for( auto idx: v_dpidx )
+		if( classIdxCol[idx] != NoClassIndex )               // classless points are not used
+			v_pac.emplace_back( atCol[idx], classIdxCol[idx] );
+	return thres_fromPairs( atIdx, v_pac, v_thresVal );
+}
+
+//---------------------------------------------------------------------
+/// Compute best threshold for attribute \c atIdx, using the Gini Impurity, for the subset of data given by \c v_dpidx.
+/**
+\return an object of type AttributeData
+
+This function actually computes a set of thresholds, then calls SearchBestIG() to find the best one.
+
+Details:
+- Uses the Gini impurity coeff: https://en.wikipedia.org/wiki/Decision_tree_learning#Gini_impurity
+- for details, see
+ - https://en.wikipedia.org/wiki/Information_gain_in_decision_trees
+ - https://towardsdatascience.com/under-the-hood-decision-tree-454f8581684e
+
+\todoM problem: for a given attribute here, we might have (after processing the histogram of attribute values) all the points having same class.
+Thus, unable to find a threshold. How do we manage that
+*/
+//template<typename T>
+AttributeData
 computeBestThreshold(
 	uint                     atIdx,     ///< attribute index we want to process
 	const std::vector<uint>& v_dpidx,   ///< datapoint indexes to consider
@@ -2925,7 +5827,10 @@ computeBestThreshold(
 	double                   giniCoeff, ///< Global Gini coeff for all the points
 	const Params&            params,    ///< run-time parameters
 	uint                     nodeId,
-	std::ostream&            fhtml
+	std::ostream&            fhtml,
+	const std::vector<uint>* pSortedIdx = nullptr, ///< if not null, same points as \c v_dpidx, sorted on attribute value
+	const priv::SplitKernels* pKernels  = nullptr, ///< split evaluation kernels (if null, selected from the nb of classes)
+	priv::ThreadPool*        pPool      = nullptr  ///< thread pool, used for large nodes (see Params::blockSplitMinSize)
 )
 {
 	START;
@@ -2934,8 +5839,15 @@ computeBestThreshold(
 	std::vector<float> v_thresVal;
 	if( params.useSortToFindThresholds )
 	{
-		if( false == thres_useSorting( atIdx, v_dpidx, data, params, v_thresVal ) )
-			return AttributeData();
+		if( pSortedIdx )
+		{
+			assert( pSortedIdx->size() == v_dpidx.size() );
+			if( false == thres_useSorting( atIdx, *pSortedIdx, data, params, v_thresVal, true ) )
+				return AttributeData();
+		}
+		else
+			if( false == thres_useSorting( atIdx, v_dpidx, data, params, v_thresVal ) )
+				return AttributeData();
 	}
 	else
 	{
@@ -2946,7 +5858,11 @@ computeBestThreshold(
 	LOG( 3, "found " << v_thresVal.size() << " thresholds, searching best one" );
 
 // step 2: compute IG for each threshold value
-	auto big = SearchBestIG( nodeId, atIdx, giniCoeff, v_thresVal, data, v_dpidx, fhtml );
+	if( v_dpidx.size() < params.blockSplitMinSize )
+		pPool = nullptr;
+	auto big = pSortedIdx
+		? SearchBestIG( nodeId, atIdx, giniCoeff, v_thresVal, data, *pSortedIdx, fhtml, true, pKernels, pPool, params.foldIndex, params.diagSink )
+		: SearchBestIG( nodeId, atIdx, giniCoeff, v_thresVal, data, v_dpidx, fhtml, false, pKernels, pPool, params.foldIndex, params.diagSink );
 
 	auto n1 = big._nbPtsLessThan;
 	auto n2 = v_dpidx.size() - n1;
@@ -3029,7 +5945,10 @@ struct AttribMap
 
 Two steps:
 - first, find for each attribute the best IG of that attribute
-- second, select the attribute that has the best one.
+- second, select the attribute that has the best one (if several, the one with the lowest index).
+
+If \c pPool is given and the node is large enough (see \c DTCPP_MIN_PARALLEL_SIZE), the attributes are processed
+concurrently. The html output of each attribute is then buffered, and written in attribute order.
 */
 //template<typename T>
 AttributeData
@@ -3038,9 +5957,12 @@ findBestAttribute(
 	const DataSet&           data,   ///< whole dataset
 	const Params&            params, ///< parameters
 	uint                     nodeId, ///< node Id, used to generate data and plot file for that node
-	const ClassCounter&      ccount, ///< class count (only non-classless points)
+	const ClassCountArray&   ccount, ///< class count (only non-classless points), indexed by class index
 	double                   giniImpurity,
-	std::ostream&            fhtml
+	std::ostream&            fhtml,
+	const std::vector<std::vector<uint>>* pvSortedIdx = nullptr, ///< if not null, for each attribute, the indexes sorted on attribute value
+	const priv::SplitKernels*             pKernels    = nullptr, ///< split evaluation kernels (if null, selected from the nb of classes)
+	priv::ThreadPool*                     pPool       = nullptr  ///< if not null, used to process the attributes concurrently
 )
 {
 	START;
@@ -3054,20 +5976,45 @@ findBestAttribute(
 	fhtml << "</tr>\n<tr><th>Node " << nodeId << "<br>" << vIdx.size() << " pts</th>\n";
 
 // step 1 - compute best IG/threshold for each attribute, only for the considered points
-	std::vector<AttributeData> v_IG;
+	auto nbAttribs = data.nbAttribs();
+	std::vector<AttributeData> v_best( nbAttribs );
+	auto processAttrib = [&]( size_t atIdx, std::ostream& f )   // lambda
+	{
+		v_best[atIdx] = computeBestThreshold(
+			atIdx, vIdx, data, giniImpurity, params, nodeId, f,
+			pvSortedIdx ? &(*pvSortedIdx)[atIdx] : nullptr,
+			pKernels,
+			pPool
+		);
+	};
+
+	if( pPool && pPool->nbThreads() > 1 && nbAttribs > 1 && vIdx.size() * nbAttribs >= DTCPP_MIN_PARALLEL_SIZE )
+	{
+		data.getClassIndexColumn();                  // so it is built (if needed) before the threads read it
+		std::vector<std::ostringstream> v_html( nbAttribs );
+		pPool->parallelFor(
+			nbAttribs,
+			[&]( size_t atIdx ){ processAttrib( atIdx, v_html[atIdx] ); }   // lambda
+		);
+		for( const auto& oss: v_html )
+			fhtml << oss.str();
+	}
+	else
+		for( size_t atIdx=0; atIdx<nbAttribs; atIdx++ )  // iterate on all the attributes
+			processAttrib( atIdx, fhtml );
+	fhtml << "</tr>\n";
 
-// for each attribute, we compute the best threshold
-	for( size_t atIdx=0; atIdx<data.nbAttribs(); atIdx++ )  // iterate on all the attributes
+// for each attribute, we keep the best threshold
+	std::vector<AttributeData> v_IG;
+	for( size_t atIdx=0; atIdx<nbAttribs; atIdx++ )
 	{
-		auto best = computeBestThreshold( atIdx, vIdx, data, giniImpurity, params, nodeId, fhtml );
-		if( best._unable )        // this means we couldn't find a threshold, so
-		{                         // we forget this one and we switch to the next attribute
+		if( v_best[atIdx]._unable )  // this means we couldn't find a threshold, so
+		{                            // we forget this one and we switch to the next attribute
 			LOG( 2, "unable to compute thresholds for attrib " << atIdx );
 		}
 		else
-			v_IG.push_back( best );
+			v_IG.push_back( v_best[atIdx] );
 	}
-	fhtml << "</tr>\n";
 
 	if( v_IG.empty() )
 		return AttributeData(); // unable
@@ -3094,13 +6041,40 @@ findBestAttribute(
 namespace priv {
 // % % % % % % % % % % % % % %
 
+//---------------------------------------------------------------------
+/// Sorts the point indexes of \c node on each attribute value, see Params::usePresortedAttributes
+/**
+This is done only once, at the root node: child nodes then inherit the sorted lists of their parent, see splitNode()
+*/
+void
+presortAttributes( NodeT& node, const DataSet& data )
+{
+	node.v_SortedIdx.resize( data.nbAttribs() );
+	for( size_t atIdx=0; atIdx<data.nbAttribs(); atIdx++ )
+	{
+		const auto* atCol = data.getColumn( atIdx );
+		auto& vSorted = node.v_SortedIdx[atIdx];
+		vSorted = node.v_Idx;
+		std::stable_sort(
+			vSorted.begin(),
+			vSorted.end(),
+			[atCol]( uint i1, uint i2 ){ return atCol[i1] < atCol[i2]; }   // lambda
+		);
+	}
+}
 //---------------------------------------------------------------------
 /// Helper function for splitNode()
+/**
+The node ids are the creation order in the tree, so that they do not depend on some global state
+and that several trees can be built at the same time (see crossValidate()).
+*/
 auto
-addChildPair( vertexT_t v, GraphT& graph, size_t nbElems )
+addChildPair( vertexT_t v, GraphT& graph, size_t nbElems1, size_t nbElems2=0 )
 {
 	auto v1 = boost::add_vertex(graph);
 	auto v2 = boost::add_vertex(graph);
+	graph[v1]._nodeId = static_cast<uint>( boost::num_vertices(graph) - 2 );
+	graph[v2]._nodeId = static_cast<uint>( boost::num_vertices(graph) - 1 );
 
 	graph[v1]._depth = graph[v]._depth+1;
 	graph[v2]._depth = graph[v]._depth+1;
@@ -3112,103 +6086,139 @@ addChildPair( vertexT_t v, GraphT& graph, size_t nbElems )
 
 //	COUT << "two nodes added, total nb=" << boost::num_vertices(graph) << "\n";
 
-	graph[v1].v_Idx.reserve( nbElems );
-	graph[v2].v_Idx.reserve( nbElems );
+	graph[v1].v_Idx.reserve( nbElems1 );
+	graph[v2].v_Idx.reserve( nbElems2 );
 	COUT << "created nodes " << graph[v1]._nodeId << " and " << graph[v2]._nodeId << '\n';
 	return std::make_pair(v1,v2);
 }
 //---------------------------------------------------------------------
-/// Recursive helper function, used by TrainingTree::p_buildTree()
-/**
-Computes the threshold, splits the dataset and assigns the split to 2 sub nodes (that get created)
-*/
-////template<typename T>
-void
-splitNode(
-	vertexT_t         v,         ///< current node id
-	GraphT&           graph,     ///< graph
-	const DataSet&    data,      ///< dataset
-	const Params&     params,    ///< parameters
-	uint&             maxDepth,  ///< maxDepth
-	std::ostream&     fhtml      ///< html graph page
-)
+/// State of a training, shared by all the splitNode() calls
+struct TrainContext
 {
-	START;
-
-	const auto& vIdx = graph[v].v_Idx; // vector holding the indexes of the datapoints for this node
-	LOG( 1, "Attempt to split node " << graph[v]._nodeId << " depth=" << graph[v]._depth << ", holding " << vIdx.size() << " points" );
-
-// step 1.1 - check if there are different output classes in the given data points
-// if not, then we are done
-
-	const auto classCountInfo = getNodeClassCount( vIdx, data );
-	const auto& classCount = classCountInfo.first;
-
-	if( classCount.size() == 1 )         // single class here
+	TrainContext( IndexSpill& sp, const SplitKernels& sk, ThreadPool* pool )
+		: spill(sp), kernels(sk), pPool(pool)
+	{}
+	IndexSpill&        spill;       ///< handles the memory budget of the index lists
+	const SplitKernels kernels;     ///< split evaluation kernels, see selectSplitKernels()
+	ThreadPool*        pPool;       ///< if not null, used to process concurrently the attributes and the subtrees
+	std::mutex         graphMutex;  ///< protects the graph structure, as nodes can be created concurrently
+	std::atomic<size_t> nbSiblingSubtractions{0};  ///< see TrainingInfo::nbSiblingSubtractions
+};
+//---------------------------------------------------------------------
+/// Helper function for splitNode() and growLevelWise(): returns the class count of the points of \c node and their number
+/// (classless points excluded), using the count set by splitPoints() if any
+std::pair<ClassCountArray,size_t>
+nodeClassCount( NodeT& node, const DataSet& data )
+{
+	if( node._classCount.empty() )
+		return getNodeClassCount( node.v_Idx, data );
+	auto nbPts = std::accumulate( node._classCount.begin(), node._classCount.end(), size_t(0) );
+	assert( nbPts != 0 );
+	return std::make_pair( std::move( node._classCount ), nbPts );
+}
+//---------------------------------------------------------------------
+/// Helper function for splitNode() and growLevelWise(): makes \c node a leaf of type \c type, holding the dominant class of its points
+void
+setLeaf( NodeT& node, NodeType type, const ClassCountArray& classCount, const DataSet& data, TrainContext& ctx )
+{
+	auto fdc = ctx.kernels.dominantClass( classCount );
+	node._type   = type;
+	node._nClass = data.getClassFromIndex( fdc.dominantClass );
+	node._nAmbig = fdc.ambig;
+	node._classCount = classCount;          // kept for pruning, see pruneSubtree()
+	ctx.spill.releaseSorted( node );
+	ctx.spill.storeIfOverBudget( node );
+}
+//---------------------------------------------------------------------
+/// Helper function for splitNode() and growLevelWise(): checks, from the class count of its points,
+/// if \c node must not be split (single class, max depth reached, or small Gini impurity).
+/// If so, it is made a leaf and the function returns true.
+bool
+nodeIsTerminal(
+	NodeT&                 node,
+	const DataSet&         data,
+	const Params&          params,
+	const ClassCountArray& classCount,   ///< class count of the points of the node, see getNodeClassCount()
+	size_t                 nbPts,        ///< nb of points of the node that have a class
+	TrainContext&          ctx
+)
+{
+	if( nbNonEmptyClasses( classCount ) == 1 )         // single class here
 	{
 		LOG( 1, "node has single class, STOP" );
-		graph[v]._nClass = classCount.begin()->first;          // no need to search for dominant class, there is only one !
-		graph[v]._type = NT_Final_SC;
-		graph[v]._nAmbig = 0.f;
-		return;
+		auto it = std::find_if( classCount.begin(), classCount.end(), []( size_t c ){ return c != 0; } );
+		node._nClass = data.getClassFromIndex( it - classCount.begin() );  // no need to search for dominant class, there is only one !
+		node._type = NT_Final_SC;
+		node._nAmbig = 0.f;
+		node._classCount = classCount;
+		ctx.spill.releaseSorted( node );
+		ctx.spill.storeIfOverBudget( node );
+		return true;
 	}
 
-	graph[v]._giniImpurity = getGiniImpurity( classCountInfo );
+	node._giniImpurity = ctx.kernels.gini( classCount, nbPts );
 
-	bool nodeIsLeave = false;
-	if( graph[v]._depth > params.maxTreeDepth )
+	if( node._depth > params.maxTreeDepth )
 	{
 		LOG( 1, "tree reached max depth (=" << params.maxTreeDepth << "), STOP" );
-		graph[v]._type = NT_Final_MD;
-		nodeIsLeave = true;
+		setLeaf( node, NT_Final_MD, classCount, data, ctx );
+		return true;
 	}
-	else
-		if( graph[v]._giniImpurity < params.minGiniCoeffForSplitting )
-		{
-			LOG( 1, "dataset is (almost or completely) pure, gini coeff=" << graph[v]._giniImpurity << ", STOP" );
-			graph[v]._type = NT_Final_GI_Small;
-			nodeIsLeave = true;
-		}
-
-	if( nodeIsLeave )
+	if( node._giniImpurity < params.minGiniCoeffForSplitting )
 	{
-		auto fdc = priv1::findDominantClass( classCount );
-		graph[v]._nClass = fdc.dominantClass;
-		graph[v]._nAmbig = fdc.ambig;
-		return;
+		LOG( 1, "dataset is (almost or completely) pure, gini coeff=" << node._giniImpurity << ", STOP" );
+		setLeaf( node, NT_Final_GI_Small, classCount, data, ctx );
+		return true;
 	}
+	return false;
+}
+//---------------------------------------------------------------------
+/// Helper function for splitNode() and growLevelWise(): turns \c v into a decision node using \c bestAttrib,
+/// and moves its points into two new child nodes, that are returned
+/**
+The class count of the points is computed only for the smallest child, the other one is obtained by subtracting it
+from the class count of the parent node. These are stored in the child nodes (see NodeT::_classCount).
 
-	// step 2 - find the best attribute to use to split the data, considering the data points of the current node
-	auto bestAttrib = findBestAttribute( vIdx, data, params, graph[v]._nodeId, classCount, graph[v]._giniImpurity, fhtml );
-	LOG( 1, "best attrib: " << bestAttrib );
+\note Only this class count is derived from the parent. The per-threshold counts (and the attribute histograms, when
+the thresholds are found by binning) are always computed from the node's own points, as the thresholds
+of a node do not match the ones of its parent.
+*/
+std::pair<vertexT_t,vertexT_t>
+splitPoints(
+	vertexT_t              v,
+	GraphT&                graph,
+	const DataSet&         data,
+	const AttributeData&   bestAttrib,
+	const ClassCountArray& classCount,    ///< class count of the points of \c v
+	uint&                  maxDepth,
+	TrainContext&          ctx
+)
+{
+	const auto& vIdx = graph[v].v_Idx;
+	auto& vSorted = graph[v].v_SortedIdx;
 
-	if( bestAttrib._unable )
-	{
-		LOG( 1, "unable to find good attribute" );
-		graph[v]._type = NT_Final_SplitTooSmall;
-		auto fdc = priv1::findDominantClass( classCount );
-		graph[v]._nClass = fdc.dominantClass;
-		graph[v]._nAmbig = fdc.ambig;
-		return;
-	}
-//
-// !!! from here, a split will occur !!!
-//
 	graph[v]._attrIndex = bestAttrib._atIndex;
 	graph[v]._threshold = bestAttrib._threshold.get();
 	graph[v]._giniImpurity = -1.f;
 	if( graph[v]._type != NT_Root )   // so the root... stays the root !
 		graph[v]._type = NT_Decision;
 
-// step 3 - different classes here: we create two child nodes and split the dataset
-	auto v1v2 = addChildPair( v, graph, vIdx.size() );
+	const auto* atCol = data.getColumn( bestAttrib._atIndex );
+	auto nbLow = std::count_if(     // count first, so we allocate exactly what is needed
+		vIdx.begin(),
+		vIdx.end(),
+		[&]( uint idx ){ return atCol[idx] < bestAttrib._threshold.get(); }   // lambda
+	);
+	std::unique_lock<std::mutex> graphLock( ctx.graphMutex );
+	auto v1v2 = addChildPair( v, graph, nbLow, vIdx.size() - nbLow );
+	graphLock.unlock();
 	auto v1 = v1v2.first;
 	auto v2 = v1v2.second;
 	maxDepth = std::max( maxDepth, graph[v1]._depth );
 
 	for( auto idx: vIdx )           // separate the data points into two sets
 	{
-		auto attrVal = data.getDataPoint( idx ).attribVal( bestAttrib._atIndex );
+		auto attrVal = atCol[idx];
 		if( attrVal < bestAttrib._threshold.get() )
 			graph[v1].v_Idx.push_back( idx );
 		else
@@ -3216,11 +6226,405 @@ splitNode(
 	}
 	LOG( 1, "after node split: v1: "<< graph[v1].v_Idx.size() << " points, v2: "<< graph[v2].v_Idx.size() << " points" );
 
-	if( graph[v1].v_Idx.size() )
-		splitNode( v1, graph, data, params, maxDepth, fhtml );
+	auto vSmall = graph[v1].v_Idx.size() <= graph[v2].v_Idx.size() ? v1 : v2;
+	auto vLarge = vSmall == v1 ? v2 : v1;
+	auto& countSmall = graph[vSmall]._classCount;
+	auto& countLarge = graph[vLarge]._classCount;
+	const auto* classIdxCol = data.getClassIndexColumn();
+	countSmall.assign( classCount.size(), 0u );
+	for( auto idx: graph[vSmall].v_Idx )
+		if( classIdxCol[idx] != NoClassIndex )
+			countSmall[ classIdxCol[idx] ]++;
+	countLarge.resize( classCount.size() );
+	for( size_t c=0; c<classCount.size(); c++ )
+		countLarge[c] = classCount[c] - countSmall[c];
+	ctx.nbSiblingSubtractions++;
+
+	if( !vSorted.empty() )          // the two childs inherit the sorted lists (stable partition keeps the order)
+	{
+		graph[v1].v_SortedIdx.resize( vSorted.size() );
+		graph[v2].v_SortedIdx.resize( vSorted.size() );
+		for( size_t at=0; at<vSorted.size(); at++ )
+		{
+			auto& vs1 = graph[v1].v_SortedIdx[at];
+			auto& vs2 = graph[v2].v_SortedIdx[at];
+			vs1.reserve( nbLow );
+			vs2.reserve( vIdx.size() - nbLow );
+			for( auto idx: vSorted[at] )
+			{
+				if( atCol[idx] < bestAttrib._threshold.get() )
+					vs1.push_back( idx );
+				else
+					vs2.push_back( idx );
+			}
+		}
+	}
+
+	graph[v1]._nbPoints = graph[v1].v_Idx.size();
+	graph[v2]._nbPoints = graph[v2].v_Idx.size();
+	auto nbLists = 1 + vSorted.size();
+	ctx.spill.add( nbLists * vIdx.size() );          // the two childs
+	ctx.spill.remove( nbLists * vIdx.size() );       // the current node, no longer needed
+	std::vector<std::vector<uint>>().swap( vSorted );  // (release memory)
+	std::vector<uint>().swap( graph[v].v_Idx );
+	return v1v2;
+}
+//---------------------------------------------------------------------
+/// Recursive helper function, used by TrainingTree::p_buildTree()
+/**
+Computes the threshold, splits the dataset and assigns the split to 2 sub nodes (that get created)
+
+If a thread pool is available, the two subtrees are built concurrently when both child nodes hold at least
+\c DTCPP_MIN_SUBTREE_TASK_SIZE points. The html output of each subtree is then buffered and written in the
+same order as with a single thread.
+This is not done if a memory budget is set (see Params::memoryBudget), as spilling relies on the depth-first order.
+*/
+////template<typename T>
+void
+splitNode(
+	vertexT_t         v,         ///< current node id
+	GraphT&           graph,     ///< graph
+	const DataSet&    data,      ///< dataset
+	const Params&     params,    ///< parameters
+	uint&             maxDepth,  ///< maxDepth
+	std::ostream&     fhtml,     ///< html graph page
+	TrainContext&     ctx        ///< training state
+)
+{
+	START;
+	const auto& vIdx = graph[v].v_Idx; // vector holding the indexes of the datapoints for this node
+	graph[v]._nbPoints = vIdx.size();
+	LOG( 1, "Attempt to split node " << graph[v]._nodeId << " depth=" << graph[v]._depth << ", holding " << vIdx.size() << " points" );
+
+// step 1 - check if there are different output classes in the given data points, and if the node can be split
+// if not, then we are done
+	const auto classCountInfo = nodeClassCount( graph[v], data );
+	const auto& classCount = classCountInfo.first;
+	if( nodeIsTerminal( graph[v], data, params, classCount, classCountInfo.second, ctx ) )
+		return;
+
+// step 2 - find the best attribute to use to split the data, considering the data points of the current node
+	auto& vSorted = graph[v].v_SortedIdx;
+	auto bestAttrib = findBestAttribute(
+		vIdx, data, params, graph[v]._nodeId, classCount, graph[v]._giniImpurity, fhtml,
+		vSorted.empty() ? nullptr : &vSorted,
+		&ctx.kernels,
+		ctx.pPool
+	);
+	LOG( 1, "best attrib: " << bestAttrib );
+
+	if( bestAttrib._unable )
+	{
+		LOG( 1, "unable to find good attribute" );
+		setLeaf( graph[v], NT_Final_SplitTooSmall, classCount, data, ctx );
+		return;
+	}
+//
+// !!! from here, a split will occur !!!
+//
+// step 3 - different classes here: we create two child nodes and split the dataset
+	auto v1v2 = splitPoints( v, graph, data, bestAttrib, classCount, maxDepth, ctx );
+	auto v1 = v1v2.first;
+	auto v2 = v1v2.second;
+
+	if(
+		ctx.pPool && ctx.pPool->nbThreads() > 1 && !params.memoryBudget
+		&& std::min( graph[v1]._nbPoints, graph[v2]._nbPoints ) >= DTCPP_MIN_SUBTREE_TASK_SIZE
+	)
+	{
+		std::array<vertexT_t,2>          vChild{ { v1, v2 } };
+		std::array<uint,2>               vMaxDepth{ { maxDepth, maxDepth } };
+		std::array<std::ostringstream,2> vHtml;
+		ctx.pPool->parallelFor(
+			2,
+			[&]( size_t i ){ splitNode( vChild[i], graph, data, params, vMaxDepth[i], vHtml[i], ctx ); }   // lambda
+		);
+		maxDepth = std::max( vMaxDepth[0], vMaxDepth[1] );
+		fhtml << vHtml[0].str() << vHtml[1].str();
+		return;
+	}
 
+	if( graph[v1].v_Idx.size() )
+	{
+		ctx.spill.storeIfOverBudget( graph[v2] );    // will wait until v1 subtree is done
+		splitNode( v1, graph, data, params, maxDepth, fhtml, ctx );
+	}
+	ctx.spill.load( graph[v2] );
 	if( graph[v2].v_Idx.size() )
-		splitNode( v2, graph, data, params, maxDepth, fhtml );
+		splitNode( v2, graph, data, params, maxDepth, fhtml, ctx );
+}
+
+//---------------------------------------------------------------------
+/// Helper function for growLevelWise(): finds, for each node of a level, the best threshold on attribute \c atIdx
+/**
+\c vSlot gives for each point of the dataset the index in \c vNode of the node holding it (or \c NoSlot).
+The attribute column is read twice:
+- first to gather the values of the points of each node, from which the threshold values of the node are computed
+(see thres_fromValues() and thres_useHistograms()). With the sorting method this is a sequential pass, but with
+the histogram method the values are gathered in the order of the node's points (NodeT::v_Idx), as splitNode() does:
+this way the histograms get the exact same input, even if the points are shuffled,
+- then (sequentially) to count, for each node, the points of each class lying between two consecutive thresholds.
+
+The delta Gini values are then computed from these counts (see deltaGiniFromBinCounts()),
+and the best threshold is selected as in computeBestThreshold().
+*/
+void
+bestThresholdsOfLevel(
+	uint                             atIdx,   ///< attribute index
+	const std::vector<uint32_t>&     vSlot,   ///< node index of each point
+	const std::vector<const NodeT*>& vNode,   ///< the nodes of the level to process
+	const DataSet&                   data,
+	const Params&                    params,
+	std::vector<AttributeData>&      vBest    ///< output: one per node
+)
+{
+	constexpr auto NoSlot = std::numeric_limits<uint32_t>::max();
+	const auto* atCol       = data.getColumn( atIdx );
+	const auto* classIdxCol = data.getClassIndexColumn();
+	UsablePointFilter usePoint( data, atIdx );
+	auto nbNodes   = vNode.size();
+	auto nbClasses = data.nbClasses();
+	auto nbPts     = data.size();
+
+// step 1 - threshold values of each node (none if unable to compute them)
+	std::vector<std::vector<float>> vThresVal( nbNodes );
+	if( params.useSortToFindThresholds )
+	{
+		std::vector<std::vector<float>> vVal( nbNodes );
+		for( size_t s=0; s<nbNodes; s++ )
+			vVal[s].reserve( vNode[s]->_nbPoints );
+		for( size_t i=0; i<nbPts; i++ )
+			if( vSlot[i] != NoSlot )
+				vVal[ vSlot[i] ].push_back( atCol[i] );
+		for( size_t s=0; s<nbNodes; s++ )
+		{
+			thres_fromValues( atIdx, vVal[s], params, vThresVal[s] );
+			std::vector<float>().swap( vVal[s] );
+		}
+	}
+	else                 // the histograms are built from the points in the node's order, exactly as in splitNode()
+		for( size_t s=0; s<nbNodes; s++ )
+			if( !thres_useHistograms( atIdx, vNode[s]->v_Idx, data, vThresVal[s] ) )
+				vThresVal[s].clear();
+
+// step 2 - for each node, count the points of each class in each interval between two consecutive thresholds
+	std::vector<std::vector<size_t>>   vThresIdx( nbNodes );
+	std::vector<std::vector<float>>    vSortedThres( nbNodes );
+	std::vector<std::vector<uint32_t>> vCount( nbNodes );
+	for( size_t s=0; s<nbNodes; s++ )
+		if( !vThresVal[s].empty() )
+		{
+			vThresIdx[s] = thresholdOrder( vThresVal[s] );
+			for( auto j: vThresIdx[s] )
+				vSortedThres[s].push_back( vThresVal[s][j] );
+			vCount[s].assign( (vThresVal[s].size()+1) * nbClasses, 0u );
+		}
+	for( size_t i=0; i<nbPts; i++ )
+	{
+		auto s = vSlot[i];
+		if( s == NoSlot || vCount[s].empty() || !usePoint( i ) )
+			continue;
+		const auto& vth = vSortedThres[s];
+		auto j = std::upper_bound( vth.begin(), vth.end(), atCol[i] ) - vth.begin();
+		vCount[s][ j*nbClasses + classIdxCol[i] ]++;
+	}
+
+// step 3 - best threshold of each node
+	vBest.assign( nbNodes, AttributeData() );
+	std::vector<float>  deltaGini;
+	std::vector<uint>   nb_LT;
+	std::vector<size_t> nb_HT;
+	for( size_t s=0; s<nbNodes; s++ )
+	{
+		if( vCount[s].empty() )
+			continue;
+		deltaGiniFromBinCounts( vNode[s]->_giniImpurity, vThresIdx[s], vCount[s], nbClasses, deltaGini, nb_LT, nb_HT );
+		auto best = std::max_element( deltaGini.begin(), deltaGini.end() ) - deltaGini.begin();
+		auto n1 = nb_LT[best];
+		auto n2 = vNode[s]->_nbPoints - n1;
+		if( n1 < params.minNbPoints || n2 < params.minNbPoints )
+		{
+			LOG( 1, "not enough points if splitting on best threshold for attribute " << atIdx << ": n1=" << n1 << " n2=" << n2 );
+			continue;
+		}
+		vBest[s] = AttributeData( atIdx, deltaGini[best], ThresholdVal( vThresVal[s][best] ), n1 );
+	}
+}
+//---------------------------------------------------------------------
+/// Grows the tree level by level, starting from node \c vRoot. This is an alternative to splitNode(), see Params::levelWiseGrowth
+/**
+All the nodes of a level (same depth) are processed together. The points are tagged with the index of their node in the level,
+so that a few sequential passes over each attribute column are enough to find the best split of all the nodes
+(see bestThresholdsOfLevel()).
+The data is thus read as a stream, and the cost of a level is \f$ O(n.a) \f$ (n: nb of points, a: nb of attributes),
+whatever the nb of nodes. If a thread pool is available, the attributes are processed concurrently.
+
+The tree is the same as the one built by splitNode() (whatever the order of the points), but the node ids follow the breadth-first order.
+No per node plots are generated.
+*/
+void
+growLevelWise(
+	vertexT_t         vRoot,     ///< initial node
+	GraphT&           graph,     ///< graph
+	const DataSet&    data,      ///< dataset
+	const Params&     params,    ///< parameters
+	uint&             maxDepth,  ///< maxDepth
+	std::ostream&     fhtml,     ///< html graph page
+	TrainContext&     ctx        ///< training state
+)
+{
+	START;
+	constexpr auto NoSlot = std::numeric_limits<uint32_t>::max();
+	auto nbAttribs = data.nbAttribs();
+	std::vector<uint32_t> vSlot( data.size() );
+
+	fhtml << "<tr><th>Level-wise growth, no plots</th></tr>\n";
+	std::vector<vertexT_t> vLevel( 1, vRoot );
+	while( !vLevel.empty() )
+	{
+		LOG( 1, "Processing " << vLevel.size() << " nodes at depth " << graph[vLevel[0]]._depth );
+
+// step 1 - tag the points with the index of their node, and get the class count of each node (already known,
+// except for the root node, see splitPoints())
+		std::fill( vSlot.begin(), vSlot.end(), NoSlot );
+		std::vector<ClassCountArray> vClassCount( vLevel.size() );
+		std::vector<size_t>          vNbPts( vLevel.size() );
+		for( size_t s=0; s<vLevel.size(); s++ )
+		{
+			auto& node = graph[vLevel[s]];
+			node._nbPoints = node.v_Idx.size();
+			for( auto idx: node.v_Idx )
+				vSlot[idx] = static_cast<uint32_t>(s);
+			auto classCountInfo = nodeClassCount( node, data );
+			vClassCount[s] = std::move( classCountInfo.first );
+			vNbPts[s]      = classCountInfo.second;
+		}
+
+// step 2 - the nodes that need to be split get a new index, the points of the other ones are untagged
+		std::vector<uint32_t>     vOpenIdx( vLevel.size(), NoSlot );
+		std::vector<size_t>       vOpen;              // indexes in vLevel of the nodes to split
+		std::vector<const NodeT*> vOpenNode;
+		for( size_t s=0; s<vLevel.size(); s++ )
+		{
+			auto& node = graph[vLevel[s]];
+			LOG( 1, "Attempt to split node " << node._nodeId << " depth=" << node._depth << ", holding " << node._nbPoints << " points" );
+			if( !nodeIsTerminal( node, data, params, vClassCount[s], vNbPts[s], ctx ) )
+			{
+				vOpenIdx[s] = static_cast<uint32_t>( vOpen.size() );
+				vOpen.push_back( s );
+				vOpenNode.push_back( &node );
+			}
+		}
+		for( auto& slot: vSlot )
+			if( slot != NoSlot )
+				slot = vOpenIdx[slot];
+
+// step 3 - best threshold of each node, for each attribute
+		std::vector<std::vector<AttributeData>> vBest( nbAttribs );   // for each attribute, one per node
+		auto processAttrib = [&]( size_t atIdx )                      // lambda
+		{
+			bestThresholdsOfLevel( atIdx, vSlot, vOpenNode, data, params, vBest[atIdx] );
+		};
+		if( ctx.pPool && ctx.pPool->nbThreads() > 1 && nbAttribs > 1 && !vOpen.empty() )
+			ctx.pPool->parallelFor( nbAttribs, processAttrib );
+		else
+			for( size_t atIdx=0; atIdx<nbAttribs; atIdx++ )
+				processAttrib( atIdx );
+
+// step 4 - split the nodes on their best attribute; the childs make the next level
+		std::vector<vertexT_t> vNext;
+		for( size_t o=0; o<vOpen.size(); o++ )
+		{
+			auto v = vLevel[ vOpen[o] ];
+			AttributeData bestAttrib;
+			for( size_t atIdx=0; atIdx<nbAttribs; atIdx++ )   // same choice as in findBestAttribute(): first highest gain
+				if( !vBest[atIdx][o]._unable && ( bestAttrib._unable || bestAttrib._gain < vBest[atIdx][o]._gain ) )
+					bestAttrib = vBest[atIdx][o];
+			LOG( 1, "best attrib: " << bestAttrib );
+			fhtml << "<tr><th>Node " << graph[v]._nodeId << "<br>" << graph[v]._nbPoints << " pts</th>\n<td>";
+
+			if( bestAttrib._unable )
+			{
+				LOG( 1, "unable to find good attribute" );
+				fhtml << "no split</td></tr>\n";
+				setLeaf( graph[v], NT_Final_SplitTooSmall, vClassCount[ vOpen[o] ], data, ctx );
+				continue;
+			}
+			fhtml << "attribute " << bestAttrib._atIndex << ", threshold " << bestAttrib._threshold << "</td></tr>\n";
+			auto v1v2 = splitPoints( v, graph, data, bestAttrib, vClassCount[ vOpen[o] ], maxDepth, ctx );
+			if( graph[v1v2.first].v_Idx.size() )
+				vNext.push_back( v1v2.first );
+			if( graph[v1v2.second].v_Idx.size() )
+				vNext.push_back( v1v2.second );
+		}
+		vLevel = std::move( vNext );
+	}
+}
+
+//---------------------------------------------------------------------
+/// Recursive helper function for TrainingTree::p_pruning(): prunes the subtree of \c v, and returns the nb of merges done
+/**
+If both childs of \c v end up as leaves of the same class, they are removed and \c v becomes a leaf
+(of type \c NT_Merged, unless it is the root node), holding the points and the class count of its two childs.
+The Gini impurity of the merged node is computed from these class counts, so no point is read.
+*/
+size_t
+pruneSubtree( vertexT_t v, GraphT& graph, const DataSet& data, IndexSpill& spill )
+{
+	if( graph[v].isLeave() || boost::out_degree( v, graph ) == 0 )
+		return 0;
+	assert( boost::out_degree( v, graph ) == 2 );
+	auto edges = boost::out_edges( v, graph );
+	auto et = edges.first++;
+	auto ef = edges.first;
+	if( graph[*ef].edgeSide )
+		std::swap( et, ef );
+	auto v1 = boost::target( *et, graph );     // created first, see addChildPair()
+	auto v2 = boost::target( *ef, graph );
+
+	auto nbRemoval = pruneSubtree( v1, graph, data, spill );
+	nbRemoval     += pruneSubtree( v2, graph, data, spill );
+
+	auto& node1 = graph[v1];
+	auto& node2 = graph[v2];
+	if( !node1.isLeave() || !node2.isLeave() || node1._nClass != node2._nClass )
+		return nbRemoval;
+
+	auto& node = graph[v];
+	node._nClass = node1._nClass;
+	if( node._type != NT_Root )
+	{
+		node._type = NT_Merged;
+
+		spill.load( node1 );
+		spill.load( node2 );
+		auto count1 = std::move( node1._classCount );
+		auto count2 = std::move( node2._classCount );
+		if( count1.empty() )
+			count1 = getNodeClassCount( node1.v_Idx, data ).first;
+		if( count2.empty() )
+			count2 = getNodeClassCount( node2.v_Idx, data ).first;
+		std::transform( count1.begin(), count1.end(), count2.begin(), count1.begin(), std::plus<size_t>() );
+		auto nbPts = std::accumulate( count1.begin(), count1.end(), size_t(0) );
+
+		node._giniImpurity = getGiniImpurity( std::make_pair( count1, nbPts ) );
+		node._nAmbig       = priv1::findDominantClass( count1 ).ambig;
+		node._classCount   = std::move( count1 );
+
+		auto n1size = node1.v_Idx.size();
+		node1.v_Idx.resize( n1size + node2.v_Idx.size() );
+		std::copy( node2.v_Idx.begin(), node2.v_Idx.end(), node1.v_Idx.begin()+n1size );
+		node.v_Idx = std::move( node1.v_Idx );  // merged node now holds the points of its two childs
+		spill.storeIfOverBudget( node );
+	}
+	else
+		spill.remove( node1.v_Idx.size() + node2.v_Idx.size() );
+
+	boost::clear_vertex(  v1, graph );
+	boost::clear_vertex(  v2, graph );
+	boost::remove_vertex( v1, graph );
+	boost::remove_vertex( v2, graph );
+	return nbRemoval + 1;
 }
 
 //---------------------------------------------------------------------
@@ -3233,176 +6637,155 @@ splitNode(
 /**
 \return The number of removal operations (\b not the number of removed nodes!)
 
-Algorithm:
-\verbatim
-DO
-	iterate through the vertices, until we have a removal:
-		IF vertex it is a leave:
-		THEN
-			go up one step and check other child
-			IF other child is a leave AND has same class
-			THEN
-				Merge the two vertices:
-					tag parent as Leave
-					remove the two childs
-				removal = true
-WHILE( no more removals )
-\endverbatim
-
-\note Could have tried something else:
-check each node one by one and find if there is another node of same depth AND same class
-that has the same parent.
-
-\todoM integrate this in the main training function, so for end-user it gets automatically done.
+The tree is processed in a single post-order traversal (see priv::pruneSubtree()): once the subtrees of both
+childs of a node are pruned, these childs get merged if they are two leaves of the same class.
+Thus a merge can make the parent node itself a leaf, that can then be merged at the upper level.
+
+The result does not depend on the order of the merges, so this gives the same tree as repeatedly merging
+any pair of same-class sibling leaves until there is none left.
 */
 size_t
-TrainingTree::p_pruning( const DataSet& data )
+TrainingTree::p_pruning( const DataSet& data, priv::IndexSpill& spill )
 {
 	START;
-
 	LOG( 1, "start pruning, nb nodes=" + std::to_string( boost::num_vertices( _graph ) ) );
-
-	size_t iter = 0;
-	size_t nbRemoval = 0;
-	bool removalHappened = false;
-	do{
-		COUT << "iter=" << iter++ << " nb vertices=" << boost::num_vertices( _graph ) << std::endl;
-		removalHappened = false;
-		std::set<uint> nodeSet;
-
-		for(
-			auto pit = boost::vertices( _graph );                // iterate on all the vertices
-			pit.first != pit.second && !removalHappened;         // but stop if a removal happened
-			pit.first++
-		)
-		{
-			auto v1    = *pit.first;
-			auto& node1 = _graph[v1];  // not const because in case of merging, the indexes vector will be added with the one from the other node
-//			COUT << "current node:" << node1._nodeId << " class=" << node1._class << " depth="<< node1._depth << '\n';
-			nodeSet.insert( node1._nodeId );
-			if( node1.isLeave() && boost::num_vertices( _graph ) != 1)    // we only care about the leaves (and quit if only 1 node left)
-			{
-				assert( boost::in_degree( v1, _graph )  == 1 );
-				auto pe_in = boost::in_edges( v1, _graph );       // get the ingoing edges (only 1 actually)
-				auto v0 = boost::source( *pe_in.first, _graph );  // get source vertex
-				assert( boost::out_degree( v0, _graph ) == 2 );
-
-				auto pedges = boost::out_edges( v0, _graph );     // get the out-edges
-				auto eit1 = pedges.first++;
-				auto eit2 = pedges.first;
-
-				edge_t other = *eit1;                         // if the first edge is
-				if( other == *pe_in.first )                   // the one used to get here,
-					other = *eit2;                            // then swap
-
-				auto v2 = boost::target( other, _graph );     // other child
-				const auto& node2 = _graph[v2];
-				if( nodeSet.find( node2._nodeId ) == nodeSet.end() )  // if not already parsed
-				{
-					nodeSet.insert( node2._nodeId );                  // then, add it to the set of nodes already parsed
-					if( node2.isLeave() )                             // if node is a leave of the tree
-						if( node1._nClass == node2._nClass )            // and is same class !
-						{
-							_graph[v0]._nClass = node1._nClass;  // change status of source node
-							if( _graph[v0]._type != NT_Root )
-							{
-								_graph[v0]._type = NT_Merged;
-
-								auto n1size = node1.v_Idx.size();
-								node1.v_Idx.resize( n1size + node2.v_Idx.size() );
-								std::copy( node2.v_Idx.begin(), node2.v_Idx.end(), node1.v_Idx.begin()+n1size );
-
-								auto pm = getNodeClassCount( node1.v_Idx, data );
-								_graph[v0]._giniImpurity = getGiniImpurity( pm );
-								_graph[v0]._nAmbig       = priv1::findDominantClass( pm.first ).ambig;
-							}
-							boost::clear_vertex(  v1, _graph );
-							boost::clear_vertex(  v2, _graph );
-							boost::remove_vertex( v1, _graph );
-							boost::remove_vertex( v2, _graph );
-							nbRemoval++;
-							removalHappened = true;
-							break;
-						}
-				}
-			}
-		}
-	}
-	while( removalHappened );
-	return nbRemoval;
+	return priv::pruneSubtree( _initialVertex, _graph, data, spill );
 }
 //---------------------------------------------------------------------
 /// Train tree using data.
 //template<typename T>
 TrainingInfo
 TrainingTree::train( const DataSet& data, const Params& params )
+{
+	std::vector<uint> v_idx( data.size() );  // create vector holding indexes of all the data points
+	std::iota( v_idx.begin(), v_idx.end(), 0 );
+	return p_train( data, std::move(v_idx), params );
+}
+//---------------------------------------------------------------------
+/// Train tree using the points of a view (a fold, for example)
+TrainingInfo
+TrainingTree::train( const DataSetView& view, const Params& params )
+{
+	return p_train( view.parent(), view.getIndexes(), params );
+}
+//---------------------------------------------------------------------
+/// Train tree using the points of \c data given by the indexes in \c v_idx
+TrainingInfo
+TrainingTree::p_train( const DataSet& data, std::vector<uint> v_idx, const Params& params )
 {
 	TrainingInfo info;
 	clear();
-	if( p_buildTree( data, params ))
+	priv::IndexSpill spill( params.memoryBudget );
+	if( p_buildTree( data, std::move(v_idx), params, spill, info ))
 	{
-		*params.outputHtml << "<h3>B2 - Generated Tree</h3>\n<p>Leave Type Legend:</p>\n<ul>\n"
-			<< "<li>MGI: Min Gini Impurity</li>\n"
-			<< "<li>SC: Single Class</li>\n"
-			<< "<li>MD: Max Depth</li>\n"
-			<< "<li>STS: Split Too Small</li>\n"
-			<< "<li>MP: Merged by pruning</li>\n"
-			<< "</ul>\n";
+		if( params.outputHtml )
+			*params.outputHtml << "<h3>B2 - Generated Tree</h3>\n<p>Leave Type Legend:</p>\n<ul>\n"
+				<< "<li>MGI: Min Gini Impurity</li>\n"
+				<< "<li>SC: Single Class</li>\n"
+				<< "<li>MD: Max Depth</li>\n"
+				<< "<li>STS: Split Too Small</li>\n"
+				<< "<li>MP: Merged by pruning</li>\n"
+				<< "</ul>\n";
 
 		info.trainingSuccess = true;
-		if( params.generateDotFiles )
-			printDot( "initial", params );
-
-		info.nbRemovals = p_pruning( data );
-		if( params.generateDotFiles )
-			printDot( "pruned", params );
+		auto addTree = [&]( const std::string& name )   // lambda
+		{
+			if( !params.diagSink || !params.diagSink->enabled() )
+				return;
+			if( params.outputHtml && params.diagSink->htmlReport() )
+				*params.outputHtml << "<h4>" << name << " tree</h4>\n<img src='" << priv::dotFileName( name, params.foldIndex ) << ".png'>\n";
+			params.diagSink->addTree( name, *this, params.foldIndex );
+		};
+		addTree( "initial" );
+
+		info.nbRemovals = p_pruning( data, spill );
+		addTree( "pruned" );
 	}
 	else
-		*params.outputHtml << "<h3>Tree build failure !!</h3>\n";
+		if( params.outputHtml )
+			*params.outputHtml << "<h3>Tree build failure !!</h3>\n";
 
+	info.nbSpilledLists = spill.nbStored();
+	for( auto pit = boost::vertices( _graph ); pit.first != pit.second; pit.first++ )
+		_graph[*pit.first]._spillOffset = -1;            // spill file gets closed now
+	p_setLeafClassIndexes();
 	return info;
 }
 //---------------------------------------------------------------------
+/// Sets in each leaf the index of its class in the class index map, so classifying a dataset needs no lookup
+void
+TrainingTree::p_setLeafClassIndexes()
+{
+	for( auto pit = boost::vertices( _graph ); pit.first != pit.second; pit.first++ )
+	{
+		auto& node = _graph[*pit.first];
+		auto it = _tClassIndexMap.left.find( node._nClass );
+		node._nClassIndex = ( it == _tClassIndexMap.left.end() ? size_t(-1) : it->second );
+	}
+}
+//---------------------------------------------------------------------
 /// Train tree using data.
 //template<typename T>
 bool
-TrainingTree::p_buildTree( const DataSet& data, const Params& params )
+TrainingTree::p_buildTree( const DataSet& data, std::vector<uint> v_idx, const Params& params, priv::IndexSpill& spill, TrainingInfo& info )
 {
 	START;
 	LOG( 0, "Start training" );
 	p_check();
 
 	_dataFileName = data._fname;
+	_nbAttribs    = data.nbAttribs();
 
 	auto nbAttribs = data.nbAttribs();
 	if( !nbAttribs )
 		throw std::runtime_error( "no attributes!" );
-	if( data.size()<2 )
+	if( v_idx.size()<2 )
 		throw std::runtime_error( "no enough data points!" );
 
-	std::vector<uint> v_idx;
-	v_idx.reserve( data.size() );
 #ifdef HANDLE_OUTLIERS
-	if( data.nbOutliers() )                     // if outliers there,
-	{                                           // then we put in the
-		for( size_t i=0; i<data.size(); i++ )   // set of indexes only
-			if( !data.pointIsOutlier(i) )       // the points that are not outliers
-				v_idx.push_back( i );
-	}
-	else
+	if( data.nbOutliers() )                     // if outliers there, then we keep in the set of indexes only the points that are not outliers
+		v_idx.erase(
+			std::remove_if( v_idx.begin(), v_idx.end(), [&data](uint i){ return data.pointIsOutlier(i); } ),
+			v_idx.end()
+		);
 #endif
-	{
-		v_idx.resize( data.size() );  // create vector holding indexes of all the data points
-		std::iota( v_idx.begin(), v_idx.end(), 0 );
-	}
 
 //	auto fhtml = priv::openOutputFile( "training", priv::FT_HTML, data._fname );
-	auto& fhtml = *params.outputHtml;
-	fhtml << "<h2>B - Tree build </h2>\n<h3>B1 - Point balance and IG vs. threshold value for each node</h2>\n<table>\n";
-
-	_graph[_initialVertex].v_Idx = v_idx;
+	std::ostream nullHtml( nullptr );                 // discards everything
+	auto& fhtml = ( params.outputHtml && params.diagSink && params.diagSink->htmlReport() )
+		? *params.outputHtml
+		: nullHtml;                                   // the per node report shows the diagnostic files, so is useless without them
+	if( params.outputHtml )
+		*params.outputHtml << "<h2>B - Tree build </h2>\n";
+	fhtml << "<h3>B1 - Point balance and IG vs. threshold value for each node</h2>\n<table>\n";
+
+	spill.add( v_idx.size() );
+	_graph[_initialVertex].v_Idx = std::move( v_idx );
+	bool levelWise = params.levelWiseGrowth && !params.memoryBudget;
+	if( params.useSortToFindThresholds && params.usePresortedAttributes && !levelWise )
+	{
+		priv::presortAttributes( _graph[_initialVertex], data );
+		spill.add( nbAttribs * _graph[_initialVertex].v_Idx.size() );
+	}
 	COUT << "INITIAL ID=" << _graph[_initialVertex]._nodeId << '\n';
-	priv::splitNode( _initialVertex, _graph, data, params, _maxDepth, fhtml ); // Call the "split" function (recursive)
+	auto kernels = priv::selectSplitKernels( data.nbClasses() );    // chosen once for the whole tree
+	LOG( 1, "using split kernels for " << kernels.nbClasses << " classes (0: generic)" );
+	std::unique_ptr<priv::ThreadPool> pool;
+	if( params.nbThreads > 1 )
+	{
+		LOG( 1, "training using " << params.nbThreads << " threads" );
+		pool = std::make_unique<priv::ThreadPool>( params.nbThreads );
+		data.getClassIndexColumn();                  // so it is built (if needed) before the threads read it
+	}
+	priv::TrainContext ctx( spill, kernels, pool.get() );
+	if( levelWise )
+	{
+		LOG( 1, "level-wise growth" );
+		priv::growLevelWise( _initialVertex, _graph, data, params, _maxDepth, fhtml, ctx );
+	}
+	else
+		priv::splitNode( _initialVertex, _graph, data, params, _maxDepth, fhtml, ctx ); // Call the "split" function (recursive)
+	info.nbSiblingSubtractions = ctx.nbSiblingSubtractions;
 
 	fhtml << "</table>\n";
 
@@ -3437,16 +6820,20 @@ TrainingTree::classify( const DataPoint& point ) const
 	}
 #endif
 
+	return _graph[ p_findLeaf( point ) ]._nClass;
+}
+//---------------------------------------------------------------------
+/// Returns the leaf reached by data point \c point
+vertexT_t
+TrainingTree::p_findLeaf( const DataPoint& point ) const
+{
 	vertexT_t v = _initialVertex;   // initialize to first node
 	bool done = false;
 	do
 	{
 		assert( _graph[v]._type != NT_undef );
 		if( _graph[v]._type != NT_Root && _graph[v]._type != NT_Decision ) // then, we are done !
-		{
 			done = true;
-			retval = _graph[v]._nClass;
-		}
 		else
 		{
 			auto attrIndex = _graph[v]._attrIndex;  // get attrib index that this node handles
@@ -3468,13 +6855,31 @@ TrainingTree::classify( const DataPoint& point ) const
 		}
 	}
 	while( !done );
-	return retval;
+	return v;
 }
 
 //---------------------------------------------------------------------
 /// Classify \c dataset and returns performance score
 ConfusionMatrix
 TrainingTree::classify( const DataSet& dataset ) const
+{
+	return p_classify( dataset, nullptr );
+}
+//---------------------------------------------------------------------
+/// Classify the points of \c view and returns performance score
+ConfusionMatrix
+TrainingTree::classify( const DataSetView& view ) const
+{
+	return p_classify( view.parent(), &view.getIndexes() );
+}
+//---------------------------------------------------------------------
+/// Classify the points of \c data given by \c pvIdx (or all the points if null) and returns performance score
+/**
+The true classes are taken from the class index column of the dataset, and the predicted ones from the
+class index stored in the leaves, so no class value lookup is needed per point.
+*/
+ConfusionMatrix
+TrainingTree::p_classify( const DataSet& data, const std::vector<uint>* pvIdx ) const
 {
 //	if( _nbClasses < 2 )  // if 0 or 1 class, then nothing to classify
 //		throw std::runtime_error( "nothing to classify, dataset holds " + std::to_string(_nbClasses) + " classes" );
@@ -3482,19 +6887,1017 @@ TrainingTree::classify( const DataSet& dataset ) const
 	p_check();
 
 	ConfusionMatrix confmat( _tClassIndexMap );
-	if( nbLeaves() > 1)
+	if( nbLeaves() < 2 )
+	{
+		std::cerr << "Error, unable to classify dataset, tree has " << nbLeaves() << " leave!\n";
+		return confmat;
+	}
+
+	std::vector<size_t> vTrueIndex( data.nbClasses(), size_t(-1) );  // dataset class index => confusion matrix index
+	for( const auto& ci: data.getClassIndexMap().left )
+	{
+		auto it = _tClassIndexMap.left.find( ci.first );
+		if( it != _tClassIndexMap.left.end() )
+			vTrueIndex[ci.second] = it->second;
+	}
+
+	const auto* classIdxCol = data.getClassIndexColumn();
+	auto nbPts = pvIdx ? pvIdx->size() : data.size();
+	for( size_t i=0; i<nbPts; i++ )
+	{
+		auto ptIdx = pvIdx ? (*pvIdx)[i] : i;
+		auto cidx = classIdxCol[ptIdx];
+		if( cidx == NoClassIndex )
+			continue;
+		auto datapoint = data.getDataPoint( ptIdx );
+#ifdef HANDLE_MISSING_VALUES
+		if( datapoint.nbMissingValues() )
+		{
+			std::cerr << "Error, unable to classify point " << ptIdx << ", has missing attribute values\n";
+			continue;
+		}
+#endif
+		const auto& leaf = _graph[ p_findLeaf( datapoint ) ];
+		if( vTrueIndex[cidx] != size_t(-1) && leaf._nClassIndex != size_t(-1) )
+			confmat.addIndex( vTrueIndex[cidx], leaf._nClassIndex );
+		else
+			confmat.add( datapoint.classVal(), leaf._nClass );   // class unknown to the tree, will throw
+	}
+	return confmat;
+}
+//---------------------------------------------------------------------
+/// Builds from the tree an InferenceTree, holding all the nodes in a single array with the given layout
+/**
+Children of a decision node are always stored next to each other (lower one first).
+The nodes of an untrained tree (no leaves) are not copied, and the returned tree classifies nothing.
+*/
+InferenceTree
+TrainingTree::compile( En_TreeLayout layout ) const
+{
+	START;
+	InferenceTree itree;
+	itree._tClassIndexMap = _tClassIndexMap;
+	itree._layout = layout;
+	itree._nbAttribs = _nbAttribs;
+	if( !nbLeaves() )
+		return itree;
+
+	std::vector<InferenceNode> vNodes;
+	vNodes.reserve( boost::num_vertices( _graph ) );
+	vNodes.resize( 1 );
+	std::vector<vertexT_t> vVert( 1, _initialVertex );     // training graph vertex of each node
+
+	auto expand = [&]( size_t i )   // lambda: fills node i, and adds its childs (if any) at the end. Returns true if it has childs
+	{
+		const auto& node = _graph[vVert[i]];
+		assert( node._type != NT_undef );
+		if( node._type != NT_Root && node._type != NT_Decision )
+		{
+			vNodes[i].attrIndex = InferenceNode::Leaf;
+			itree._leafIdx      = static_cast<uint32_t>( i );
+			vNodes[i].threshold = 0.f;
+			vNodes[i].child     = static_cast<uint32_t>( node._nClassIndex );
+			vNodes[i].classVal  = node._nClass.get();
+			return false;
+		}
+		assert( boost::out_degree( vVert[i], _graph ) == 2 );
+		auto edges = boost::out_edges( vVert[i], _graph );
+		auto et = edges.first++;
+		auto ef = edges.first;
+		if( _graph[*ef].edgeSide )
+			std::swap( et, ef );
+
+		vNodes[i].attrIndex = static_cast<uint32_t>( node._attrIndex );
+		vNodes[i].threshold = node._threshold;
+		vNodes[i].child     = static_cast<uint32_t>( vNodes.size() );
+		vNodes[i].classVal  = -1;
+		vNodes.resize( vNodes.size() + 2 );
+		vVert.push_back( boost::target( *et, _graph ) );
+		vVert.push_back( boost::target( *ef, _graph ) );
+		return true;
+	};
+
+	if( layout == En_TreeLayout::BreadthFirst )
+		for( size_t i=0; i<vNodes.size(); i++ )            // children get added at the end, so this follows the levels
+			expand( i );
+	else
 	{
-		for( const auto& datapoint: dataset )
-			if( !datapoint.isClassLess() )
+		std::vector<size_t> stack( 1, 0 );
+		while( !stack.empty() )
+		{
+			auto i = stack.back();
+			stack.pop_back();
+			if( expand( i ) )
 			{
-				auto cla1 = datapoint.classVal();
-				auto cla2 = classify( datapoint );
-				confmat.add( cla1, cla2 );
+				stack.push_back( vNodes[i].child+1 );
+				stack.push_back( vNodes[i].child );          // lower child is processed first
 			}
+		}
 	}
-	else
-		std::cerr << "Error, unable to classify dataset, tree has " << nbLeaves() << " leave!\n";
-	return confmat;
+	itree.p_setNodes( std::move( vNodes ) );
+	return itree;
+}
+//---------------------------------------------------------------------
+/// Makes the tree use the nodes of \c vNodes
+void
+InferenceTree::p_setNodes( std::vector<InferenceNode>&& vNodes )
+{
+	auto pv = std::make_shared<const std::vector<InferenceNode>>( std::move( vNodes ) );
+	_pNodes   = pv->data();
+	_nbNodes  = pv->size();
+	_pStorage = pv;
+}
+//---------------------------------------------------------------------
+/// Saves the tree in a binary model file, that can be reloaded with loadModel(). Returns false on failure
+/**
+- See priv::ModelHeader for the file layout: the nodes are stored as they are in memory, with the class index map
+and the string labels (see assignLabels()).
+- The file is first written under a temporary name and then renamed, so that concurrent processes
+never see a partially written file.
+- The format is little-endian, so this fails on a big-endian machine.
+*/
+bool
+InferenceTree::saveModel( const std::string& fname ) const
+{
+	START;
+	static_assert( sizeof(ClassVal) == sizeof(int32_t), "ClassVal must be a 32 bits integer" );
+	if( !priv::isLittleEndian() )
+		return false;
+
+	priv::ModelHeader h;
+	std::memset( &h, 0, sizeof(h) );
+	std::memcpy( h.magic, priv::ModelMagic, sizeof(h.magic) );
+	h.version    = priv::ModelVersion;
+	h.byteOrder  = 0x01020304;
+	h.layout     = static_cast<uint32_t>( _layout );
+	h.leafIdx    = _leafIdx;
+	h.nbAttribs  = static_cast<uint32_t>( _nbAttribs );
+	h.offNodes   = priv::roundUp64( sizeof(h) );
+	h.nbNodes    = _nbNodes;
+	h.offClasses = priv::roundUp64( h.offNodes + _nbNodes * sizeof(InferenceNode) );
+	h.nbClasses  = _tClassIndexMap.size();
+	h.offLabels  = priv::roundUp64( h.offClasses + h.nbClasses * 2 * sizeof(uint32_t) );
+	h.nbLabels   = _classLabels.size();
+
+	auto ftmp = fname + ".tmp" + std::to_string( std::random_device()() );
+	{
+		std::ofstream f( ftmp, std::ios::binary );
+		if( !f.is_open() )
+			return false;
+
+		f.seekp( h.offNodes );
+		f.write( reinterpret_cast<const char*>( _pNodes ), _nbNodes * sizeof(InferenceNode) );
+		f.seekp( h.offClasses );
+		for( const auto& ci: _tClassIndexMap.left )
+		{
+			uint32_t val[2] = { static_cast<uint32_t>( ci.first.get() ), static_cast<uint32_t>( ci.second ) };
+			f.write( reinterpret_cast<const char*>( val ), sizeof(val) );
+		}
+		f.seekp( h.offLabels );
+		for( const auto& lab: _classLabels.left )
+		{
+			uint32_t val[2] = { static_cast<uint32_t>( lab.second ), static_cast<uint32_t>( lab.first.size() ) };
+			f.write( reinterpret_cast<const char*>( val ), sizeof(val) );
+			f.write( lab.first.data(), lab.first.size() );
+		}
+		h.fileSize = static_cast<uint64_t>( f.tellp() );
+		f.seekp( 0 );
+		f.write( reinterpret_cast<const char*>( &h ), sizeof(h) );
+		if( !f )
+		{
+			f.close();
+			std::remove( ftmp.c_str() );
+			return false;
+		}
+	}
+	if( std::rename( ftmp.c_str(), fname.c_str() ) != 0 )
+	{
+		std::remove( ftmp.c_str() );
+		return false;
+	}
+	return true;
+}
+//---------------------------------------------------------------------
+/// Loads a binary model file created by saveModel(), returns false on failure (tree left unchanged)
+/**
+The file is mapped in memory, and the tree directly uses the nodes from there: nothing is allocated per node,
+and processes loading the same model share a single copy of it (the page cache).
+Only the class index map and the labels are copied.
+
+The nodes are only checked (children stored after their parent and inside the array, attribute indexes lower
+than nbAttribs(), valid class indexes), so that a corrupted file can not make the classification read outside of
+the array, or loop. The class index map must hold \c nbClasses distinct class values, with indexes forming
+a permutation of [0,nbClasses), so that the leaves class indexes are valid confusion matrix indexes.
+The caller must give points with at least nbAttribs() values.
+*/
+bool
+InferenceTree::loadModel( const std::string& fname )
+{
+	START;
+	std::shared_ptr<priv::MappedFile> pmap;
+	try
+	{
+		pmap = std::make_shared<priv::MappedFile>( fname );
+	}
+	catch( const boost::interprocess::interprocess_exception& )
+	{
+		return false;
+	}
+	const char* data  = pmap->data();
+	size_t      fsize = pmap->size();
+
+	priv::ModelHeader h;
+	if( fsize < sizeof(h) )
+		return false;
+	std::memcpy( &h, data, sizeof(h) );
+	if( std::memcmp( h.magic, priv::ModelMagic, sizeof(h.magic) ) != 0
+		|| h.version != priv::ModelVersion
+		|| h.byteOrder != 0x01020304
+		|| h.fileSize != fsize
+		|| h.layout > static_cast<uint32_t>( En_TreeLayout::BreadthFirst )
+		|| h.offNodes % alignof(InferenceNode) != 0
+	)
+		return false;
+
+	auto inFile = [fsize]( uint64_t offset, uint64_t nb, uint64_t elemSize )   // lambda
+	{
+		return offset <= fsize && nb <= ( fsize - offset ) / elemSize;
+	};
+	if( !inFile( h.offNodes, h.nbNodes, sizeof(InferenceNode) )
+		|| !inFile( h.offClasses, h.nbClasses, 2 * sizeof(uint32_t) )
+		|| !inFile( h.offLabels, 0, 1 )
+		|| ( h.nbNodes && ( h.leafIdx >= h.nbNodes ) )
+	)
+		return false;
+
+	const auto* nodes = reinterpret_cast<const InferenceNode*>( data + h.offNodes );
+	for( uint64_t i=0; i<h.nbNodes; i++ )
+	{
+		const auto& node = nodes[i];
+		if( node.isLeaf() )
+		{
+			if( node.child != uint32_t(-1) && node.child >= h.nbClasses )
+				return false;
+		}
+		else
+			if( node.child <= i || node.child >= h.nbNodes - 1 || node.attrIndex >= h.nbAttribs )
+				return false;
+	}
+	if( h.nbNodes && !nodes[h.leafIdx].isLeaf() )
+		return false;
+
+	ClassIndexMap cim;
+	const char* pcl = data + h.offClasses;
+	for( uint64_t i=0; i<h.nbClasses; i++ )
+	{
+		uint32_t val[2];
+		std::memcpy( val, pcl + i * sizeof(val), sizeof(val) );
+		if( val[1] >= h.nbClasses )
+			return false;
+		cim.insert( ClassIndexMap::value_type( ClassVal( static_cast<int32_t>( val[0] ) ), val[1] ) );
+	}
+	if( cim.size() != h.nbClasses )        // a repeated class value or index was dropped by the bimap
+		return false;
+
+	ClassStringIndexBiMap bimap;
+	const char* plab = data + h.offLabels;
+	for( uint64_t i=0; i<h.nbLabels; i++ )
+	{
+		uint32_t val[2];
+		if( !inFile( plab - data, 1, sizeof(val) ) )
+			return false;
+		std::memcpy( val, plab, sizeof(val) );
+		plab += sizeof(val);
+		if( !inFile( plab - data, val[1], 1 ) )
+			return false;
+		bimap.insert( ClassStringIndexBiMap::value_type( std::string( plab, val[1] ), val[0] ) );
+		plab += val[1];
+	}
+
+	_pNodes         = h.nbNodes ? nodes : nullptr;
+	_nbNodes        = h.nbNodes;
+	_pStorage       = pmap;
+	_layout         = static_cast<En_TreeLayout>( h.layout );
+	_leafIdx        = h.leafIdx;
+	_nbAttribs      = h.nbAttribs;
+	_tClassIndexMap = std::move( cim );
+	_classLabels    = std::move( bimap );
+	return true;
+}
+//---------------------------------------------------------------------
+/// Returns class of a point given by the values of its attributes, in attribute order (-1 if the tree is empty)
+ClassVal
+InferenceTree::classify( const float* pAttribVal ) const
+{
+	if( !_nbNodes )
+	{
+		std::cerr << "Error, unable to classify point, tree has no leaves!\n";
+		return ClassVal(-1);
+	}
+	return ClassVal( _pNodes[ p_findLeaf( [pAttribVal]( uint32_t at ){ return pAttribVal[at]; } ) ].classVal );
+}
+//---------------------------------------------------------------------
+/// Returns class of data point as classified by tree (-1 if the tree is empty)
+ClassVal
+InferenceTree::classify( const DataPoint& point ) const
+{
+	if( !_nbNodes )
+	{
+		std::cerr << "Error, unable to classify point, tree has no leaves!\n";
+		return ClassVal(-1);
+	}
+	p_checkNbAttribs( point.nbAttribs() );
+#ifdef HANDLE_MISSING_VALUES
+	if( point.nbMissingValues() )
+	{
+		std::cerr << "Error, unable to classify point, has missing attribute values\n";
+		return ClassVal(-1);
+	}
+#endif
+	return ClassVal( _pNodes[ p_findLeaf( [&point]( uint32_t at ){ return point.attribVal( at ); } ) ].classVal );
+}
+//---------------------------------------------------------------------
+/// Classify \c dataset and returns performance score
+ConfusionMatrix
+InferenceTree::classify( const DataSet& dataset ) const
+{
+	return p_classify( dataset, nullptr );
+}
+//---------------------------------------------------------------------
+/// Classify the points of \c view and returns performance score
+ConfusionMatrix
+InferenceTree::classify( const DataSetView& view ) const
+{
+	return p_classify( view.parent(), &view.getIndexes() );
+}
+//---------------------------------------------------------------------
+/// Batch version of p_findLeaf(): the points go down the tree together, one level at a time, so that
+/// the memory accesses of the different points overlap (the next node of each point gets prefetched)
+template<typename F>
+void
+InferenceTree::p_findLeavesScalar( size_t first, size_t nb, F attribVal, uint32_t* pLeaf ) const
+{
+	assert( nb <= DTCPP_INFERENCE_BATCH );
+	const auto* nodes = _pNodes;
+	std::fill( pLeaf, pLeaf+nb, 0u );
+	bool active = true;
+	while( active )
+	{
+		active = false;
+		for( size_t l=0; l<nb; l++ )
+		{
+			const auto& node = nodes[pLeaf[l]];
+			if( node.isLeaf() )
+				continue;
+			active = true;
+			pLeaf[l] = node.child + !( attribVal( first+l, node.attrIndex ) < node.threshold );
+			__builtin_prefetch( nodes + pLeaf[l] );
+		}
+	}
+}
+
+#if defined(__SSE2__) && defined(DTCPP_SIMD_INFERENCE)
+//---------------------------------------------------------------------
+/// Same as p_findLeavesScalar(), but the comparison with the thresholds and the selection of the next nodes
+/// are done on 4 points at a time, with SSE2 instructions.
+/**
+The points left once \c nb is reached start on a leaf (\c _leafIdx), so they never move.
+*/
+template<typename F>
+void
+InferenceTree::p_findLeavesSSE2( size_t first, size_t nb, F attribVal, uint32_t* pLeaf ) const
+{
+	static_assert( DTCPP_INFERENCE_BATCH % 4 == 0, "DTCPP_INFERENCE_BATCH must be a multiple of 4" );
+	assert( nb <= DTCPP_INFERENCE_BATCH );
+	const auto* nodes = _pNodes;
+	alignas(16) uint32_t idx[DTCPP_INFERENCE_BATCH];
+	for( size_t l=0; l<DTCPP_INFERENCE_BATCH; l++ )
+		idx[l] = ( l<nb ? 0u : _leafIdx );
+
+	const __m128i one  = _mm_set1_epi32( 1 );
+	const __m128i leaf = _mm_set1_epi32( -1 );             // see InferenceNode::Leaf
+	bool active = true;
+	while( active )
+	{
+		active = false;
+		for( size_t l=0; l<DTCPP_INFERENCE_BATCH; l+=4 )
+		{
+			const auto* n0 = nodes + idx[l];
+			const auto* n1 = nodes + idx[l+1];
+			const auto* n2 = nodes + idx[l+2];
+			const auto* n3 = nodes + idx[l+3];
+			auto r0 = _mm_loadu_ps( reinterpret_cast<const float*>( n0 ) );     // one node per register
+			auto r1 = _mm_loadu_ps( reinterpret_cast<const float*>( n1 ) );
+			auto r2 = _mm_loadu_ps( reinterpret_cast<const float*>( n2 ) );
+			auto r3 = _mm_loadu_ps( reinterpret_cast<const float*>( n3 ) );
+			_MM_TRANSPOSE4_PS( r0, r1, r2, r3 );                                 // now: attributes, thresholds, childs, classes
+			auto isLeaf = _mm_cmpeq_epi32( _mm_castps_si128( r0 ), leaf );
+			if( _mm_movemask_epi8( isLeaf ) == 0xFFFF )      // all 4 points are done
+				continue;
+			active = true;
+			auto val = _mm_setr_ps(
+				n0->isLeaf() ? 0.f : attribVal( first+l,   n0->attrIndex ),
+				n1->isLeaf() ? 0.f : attribVal( first+l+1, n1->attrIndex ),
+				n2->isLeaf() ? 0.f : attribVal( first+l+2, n2->attrIndex ),
+				n3->isLeaf() ? 0.f : attribVal( first+l+3, n3->attrIndex )
+			);
+			auto lt   = _mm_castps_si128( _mm_cmplt_ps( val, r1 ) );      // -1 if lower, else 0
+			auto next = _mm_add_epi32( _mm_castps_si128( r2 ), _mm_add_epi32( one, lt ) );
+			auto cur  = _mm_load_si128( reinterpret_cast<const __m128i*>( idx+l ) );
+			_mm_store_si128(
+				reinterpret_cast<__m128i*>( idx+l ),
+				_mm_or_si128( _mm_and_si128( isLeaf, cur ), _mm_andnot_si128( isLeaf, next ) )
+			);
+			for( size_t k=0; k<4; k++ )
+				__builtin_prefetch( nodes + idx[l+k] );
+		}
+	}
+	std::copy( idx, idx+nb, pLeaf );
+}
+#endif
+
+//---------------------------------------------------------------------
+/// Writes in \c pOut the class of the \c nbPts points whose attribute values are given by <code>attribVal(pointIndex,attribIndex)</code>
+template<typename F>
+void
+InferenceTree::p_predict( size_t nbPts, F attribVal, ClassVal* pOut ) const
+{
+	if( !_nbNodes )
+	{
+		std::cerr << "Error, unable to classify points, tree has no leaves!\n";
+		std::fill( pOut, pOut+nbPts, ClassVal(-1) );
+		return;
+	}
+	uint32_t vLeaf[DTCPP_INFERENCE_BATCH];
+	for( size_t i0=0; i0<nbPts; i0+=DTCPP_INFERENCE_BATCH )
+	{
+		auto nb = std::min( nbPts-i0, size_t(DTCPP_INFERENCE_BATCH) );
+		p_findLeaves( i0, nb, attribVal, vLeaf );
+		for( size_t l=0; l<nb; l++ )
+			pOut[i0+l] = ClassVal( _pNodes[vLeaf[l]].classVal );
+	}
+}
+//---------------------------------------------------------------------
+/// Batch classification of \c nbRows points stored by rows: the values of point \c i are at <code>pRows + i*rowStride</code>.
+/// The classes are written in \c pOut (that must hold \c nbRows values)
+void
+InferenceTree::predictRows( const float* pRows, size_t nbRows, size_t rowStride, ClassVal* pOut ) const
+{
+	p_predict( nbRows, [pRows,rowStride]( size_t i, uint32_t at ){ return pRows[i*rowStride + at]; }, pOut );
+}
+//---------------------------------------------------------------------
+/// Batch classification of \c nbRows points stored by columns: the value of attribute \c a of point \c i is <code>pCols[a][i]</code>.
+/// The classes are written in \c pOut (that must hold \c nbRows values)
+void
+InferenceTree::predictColumns( const float* const* pCols, size_t nbRows, ClassVal* pOut ) const
+{
+	p_predict( nbRows, [pCols]( size_t i, uint32_t at ){ return pCols[at][i]; }, pOut );
+}
+//---------------------------------------------------------------------
+/// Returns the class of each point of the dataset (-1 for points with missing values)
+std::vector<ClassVal>
+InferenceTree::predict( const DataSet& data ) const
+{
+	p_checkNbAttribs( data.nbAttribs() );
+	std::vector<const float*> vCol( data.nbAttribs() );
+	for( size_t at=0; at<vCol.size(); at++ )
+		vCol[at] = data.getColumn( at );
+	std::vector<ClassVal> vOut( data.size() );
+	predictColumns( vCol.data(), data.size(), vOut.data() );
+#ifdef HANDLE_MISSING_VALUES
+	for( size_t i=0; i<data.size(); i++ )
+		if( data.nbMissingValues( i ) )
+			vOut[i] = ClassVal(-1);
+#endif
+	return vOut;
+}
+//---------------------------------------------------------------------
+/// Returns the class of each point of the view, in the view order (-1 for points with missing values)
+std::vector<ClassVal>
+InferenceTree::predict( const DataSetView& view ) const
+{
+	const auto& data = view.parent();
+	const auto& vIdx = view.getIndexes();
+	p_checkNbAttribs( data.nbAttribs() );
+	std::vector<const float*> vCol( data.nbAttribs() );
+	for( size_t at=0; at<vCol.size(); at++ )
+		vCol[at] = data.getColumn( at );
+	const auto* pCol = vCol.data();
+	const auto* pIdx = vIdx.data();
+
+	std::vector<ClassVal> vOut( vIdx.size() );
+	p_predict( vIdx.size(), [pCol,pIdx]( size_t i, uint32_t at ){ return pCol[at][pIdx[i]]; }, vOut.data() );
+#ifdef HANDLE_MISSING_VALUES
+	for( size_t i=0; i<vIdx.size(); i++ )
+		if( data.nbMissingValues( vIdx[i] ) )
+			vOut[i] = ClassVal(-1);
+#endif
+	return vOut;
+}
+//---------------------------------------------------------------------
+/// Classify the points of \c data given by \c pvIdx (or all the points if null) and returns performance score,
+/// see TrainingTree::p_classify(). Points are classified by batches, see p_findLeaves()
+ConfusionMatrix
+InferenceTree::p_classify( const DataSet& data, const std::vector<uint>* pvIdx ) const
+{
+	START;
+	if( _tClassIndexMap.size() == 0 )
+		throw std::runtime_error( "program error, tree has no Class to Index map assigned" );
+
+	ConfusionMatrix confmat( _tClassIndexMap );
+	if( nbLeaves() < 2 )
+	{
+		std::cerr << "Error, unable to classify dataset, tree has " << nbLeaves() << " leave!\n";
+		return confmat;
+	}
+	p_checkNbAttribs( data.nbAttribs() );
+
+	std::vector<size_t> vTrueIndex( data.nbClasses(), size_t(-1) );  // dataset class index => confusion matrix index
+	for( const auto& ci: data.getClassIndexMap().left )
+	{
+		auto it = _tClassIndexMap.left.find( ci.first );
+		if( it != _tClassIndexMap.left.end() )
+			vTrueIndex[ci.second] = it->second;
+	}
+
+	std::vector<const float*> vCol( data.nbAttribs() );
+	for( size_t at=0; at<vCol.size(); at++ )
+		vCol[at] = data.getColumn( at );
+	const auto* pCol = vCol.data();
+	auto pointIndex = [pvIdx]( size_t i ) -> size_t   // lambda
+	{
+		return pvIdx ? (*pvIdx)[i] : i;
+	};
+
+	const auto* classIdxCol = data.getClassIndexColumn();
+	auto nbPts = pvIdx ? pvIdx->size() : data.size();
+	uint32_t vLeaf[DTCPP_INFERENCE_BATCH];
+	for( size_t i0=0; i0<nbPts; i0+=DTCPP_INFERENCE_BATCH )
+	{
+		auto nb = std::min( nbPts-i0, size_t(DTCPP_INFERENCE_BATCH) );
+		p_findLeaves( i0, nb, [pCol,&pointIndex]( size_t i, uint32_t at ){ return pCol[at][pointIndex(i)]; }, vLeaf );
+		for( size_t l=0; l<nb; l++ )
+		{
+			auto ptIdx = pointIndex( i0+l );
+			auto cidx = classIdxCol[ptIdx];
+			if( cidx == NoClassIndex )
+				continue;
+#ifdef HANDLE_MISSING_VALUES
+			if( data.nbMissingValues( ptIdx ) )
+			{
+				std::cerr << "Error, unable to classify point " << ptIdx << ", has missing attribute values\n";
+				continue;
+			}
+#endif
+			const auto& leaf = _pNodes[ vLeaf[l] ];
+			if( vTrueIndex[cidx] != size_t(-1) && leaf.child != uint32_t(-1) )
+				confmat.addIndex( vTrueIndex[cidx], leaf.child );
+			else
+				confmat.add( data.getDataPoint( ptIdx ).classVal(), ClassVal( leaf.classVal ) );   // class unknown to the tree, will throw
+		}
+	}
+	return confmat;
+}
+//---------------------------------------------------------------------
+/// Holds the results of a k-fold cross validation, see crossValidate()
+struct CrossValidationInfo
+{
+	std::vector<TrainingInfo>    vTrainInfo; ///< one per fold
+	std::vector<ConfusionMatrix> vConfMat;   ///< one per fold, computed on the test points of that fold
+	std::vector<std::string>     vLog;       ///< log lines of each fold (see LOG), only filled if verbose
+
+/// Returns the index of the first fold whose training failed, or -1 if none
+	int failedFold() const
+	{
+		for( size_t i=0; i<vTrainInfo.size(); i++ )
+			if( !vTrainInfo[i].trainingSuccess )
+				return static_cast<int>(i);
+		return -1;
+	}
+};
+//---------------------------------------------------------------------
+/// k-fold cross validation: for each fold \c i, trains \c vTree[i] on the other folds of \c view
+/// and classifies the points of fold \c i with it. The nb of folds is the size of \c vTree.
+/**
+The folds are processed concurrently by at most \c nbWorkers threads, each fold training using
+<code>max(1,params.nbThreads/nbWorkers)</code> threads (see Params::nbThreads).
+
+The results do not depend on the nb of workers, and are stored in fold order:
+- the html output of each fold is buffered, then added to \c params.outputHtml (if not null) in fold order,
+- the log output of each fold is buffered, and returned in CrossValidationInfo::vLog,
+so the folds do not get their output mixed.
+*/
+CrossValidationInfo
+crossValidate(
+	std::vector<TrainingTree>& vTree,         ///< trees to train, one per fold
+	const DataSetView&         view,          ///< points to use, usually shuffled before
+	const Params&              params,        ///< run-time parameters (Params::foldIndex and Params::outputHtml are set per fold)
+	uint                       nbWorkers = 1  ///< max nb of folds processed at the same time
+)
+{
+	START;
+	auto nbFolds = vTree.size();
+	if( nbFolds < 2 )
+		throw std::runtime_error( "cross validation requires at least 2 folds" );
+
+	const auto& data = view.parent();
+	data.getClassIndexColumn();                  // so it is built (if needed) before the threads read it
+
+	CrossValidationInfo cvi;
+	cvi.vTrainInfo.resize( nbFolds );
+	cvi.vConfMat.resize( nbFolds, ConfusionMatrix( data.getClassIndexMap() ) );
+	cvi.vLog.resize( nbFolds );
+	std::vector<std::ostringstream> vHtml( nbFolds );
+
+	nbWorkers = std::max( 1u, std::min( nbWorkers, static_cast<uint>(nbFolds) ) );
+	auto foldParams = params;
+	foldParams.nbThreads = std::max( 1u, params.nbThreads / nbWorkers );
+
+	priv::ThreadPool pool( nbWorkers );
+	pool.parallelFor(
+		nbFolds,
+		[&]( size_t i )                                   // lambda
+		{
+			std::ostringstream oslog;
+			priv1::logStream() = &oslog;                  // restored by the pool once this is done
+
+			auto fparams = foldParams;
+			fparams.foldIndex  = static_cast<int>(i);
+			fparams.outputHtml = &vHtml[i];
+
+			auto p_data_subsets = view.getFolds( i, nbFolds );
+			vTree[i].assignCIM( data.getClassIndexMap() );
+			cvi.vTrainInfo[i] = vTree[i].train( p_data_subsets.first, fparams );
+			if( cvi.vTrainInfo[i].trainingSuccess )
+				cvi.vConfMat[i] = vTree[i].classify( p_data_subsets.second );
+			cvi.vLog[i] = oslog.str();
+		}
+	);
+
+	if( params.outputHtml )
+		for( const auto& oss: vHtml )
+			*params.outputHtml << oss.str();
+	return cvi;
+}
+//---------------------------------------------------------------------
+/// Diagnostic sink recording a compact binary trace of the training, see Params::diagSink
+/**
+No file is written during the training: the outcome of each threshold search (see SplitSearchRecord)
+and the trees are appended to a memory buffer, that can be saved afterwards with save().
+The data/plot files, the DOT files and the html report can then be produced from that file by writeTraceReport()
+(see the \c dectree-report app), so the per node html report is not written in Params::outputHtml.
+
+The training still does the computations the plots need: the class histogram of each threshold search
+(see classHistoPerTVal(), unless \c DTCPP_NEED_FOR_SPEED is defined) and the copy of the search outcome in the buffer.
+
+Only the training is recorded: the attribute histograms of the dataset (data and plot files written by DataSet::computeStats())
+are not part of the trace, and are still written directly in the \c out folder.
+
+A same sink can be shared by concurrent trainings (see crossValidate()).
+*/
+class TraceDiagSink : public DiagSink
+{
+	public:
+		bool enabled() const override { return true; }
+/// The html report is produced by writeTraceReport()
+		bool htmlReport() const override { return false; }
+/// Not used, as the records are kept in memory
+		std::unique_ptr<std::ostream> openFile( const std::string&, priv::EN_FileType, const std::string& ) override
+		{
+			return std::unique_ptr<std::ostream>();
+		}
+		void addSplitSearch( const SplitSearchRecord& rec, const DataSet& data ) override;
+		void addTree( const std::string& name, const TrainingTree& tree, int foldIndex ) override;
+		bool save( const std::string& fname ) const;
+/// Nb of records (split searches and trees) held
+		size_t nbRecords() const
+		{
+			std::lock_guard<std::mutex> lock( _mtx );
+			return _nbRecords;
+		}
+
+	private:
+		void p_append( const std::string& rec );
+
+	private:
+		mutable std::mutex       _mtx;
+		std::string              _buf;           ///< the records, see priv::TraceHeader
+		uint64_t                 _nbRecords = 0;
+		std::string              _dataFileName;
+		std::vector<std::string> _vLabels;       ///< class labels, see classLabels()
+};
+
+//---------------------------------------------------------------------
+inline
+void
+TraceDiagSink::p_append( const std::string& rec )
+{
+	std::lock_guard<std::mutex> lock( _mtx );
+	_buf.append( rec );
+	_nbRecords++;
+}
+//---------------------------------------------------------------------
+/// Records the outcome of a threshold search
+inline
+void
+TraceDiagSink::addSplitSearch( const SplitSearchRecord& rec, const DataSet& data )
+{
+	std::string buf;
+	buf.reserve( 32 + rec.vThresVal.size() * 20 + rec.vClassHisto.size() * 4 );
+	priv::traceWrite( buf, priv::TR_SplitSearch );
+	priv::traceWrite( buf, rec.nodeId );
+	priv::traceWrite( buf, rec.atIdx );
+	priv::traceWrite( buf, rec.foldIndex );
+	priv::traceWrite( buf, rec.nbPoints );
+	priv::traceWrite( buf, rec.vThresVal );
+	priv::traceWrite( buf, rec.vNbLT );
+	priv::traceWrite( buf, rec.vNbHT );
+	priv::traceWrite( buf, rec.vDeltaGini );
+	priv::traceWrite( buf, rec.vClassHisto );
+	{
+		std::lock_guard<std::mutex> lock( _mtx );
+		if( _vLabels.empty() )                       // first record
+		{
+			_dataFileName = data._fname;
+			_vLabels = classLabels( data );
+		}
+	}
+	p_append( buf );
+}
+
+// % % % % % % % % % % % % % %
+namespace priv {
+// % % % % % % % % % % % % % %
+//---------------------------------------------------------------------
+/// Recursive function used to record a tree in a training trace, adds node \c vert and its childs to \c vNodes
+inline
+void
+traceNodes( const GraphT& graph, vertexT_t vert, int32_t parent, bool edgeSide, std::vector<TraceNode>& vNodes )
+{
+	const auto& node = graph[vert];
+	TraceNode tn;
+	tn.parent       = parent;
+	tn.nodeId       = node._nodeId;
+	tn.type         = node._type;
+	tn.nClass       = node._nClass.get();
+	tn.attrIndex    = static_cast<uint32_t>( node._attrIndex );
+	tn.threshold    = node._threshold;
+	tn.giniImpurity = node._giniImpurity;
+	tn.nAmbig       = node._nAmbig;
+	tn.edgeSide     = edgeSide;
+	tn.depth        = node._depth;
+	tn.nbPoints     = node._nbPoints;
+	vNodes.push_back( tn );
+
+	auto idx = static_cast<int32_t>( vNodes.size()-1 );
+	for( auto pit=boost::out_edges( vert, graph ); pit.first != pit.second; pit.first++ )
+		traceNodes( graph, boost::target( *pit.first, graph ), idx, graph[*pit.first].edgeSide, vNodes );
+}
+// % % % % % % % % % % % % % %
+} // namespace priv
+// % % % % % % % % % % % % % %
+
+//---------------------------------------------------------------------
+/// Records the nodes of a tree
+inline
+void
+TraceDiagSink::addTree( const std::string& name, const TrainingTree& tree, int foldIndex )
+{
+	std::vector<priv::TraceNode> vNodes;
+	vNodes.reserve( boost::num_vertices( tree._graph ) );
+	priv::traceNodes( tree._graph, tree._initialVertex, -1, false, vNodes );
+
+	std::string buf;
+	priv::traceWrite( buf, priv::TR_Tree );
+	priv::traceWrite( buf, static_cast<int32_t>( foldIndex ) );
+	priv::traceWrite( buf, name );
+	priv::traceWrite( buf, tree._dataFileName );
+	priv::traceWrite( buf, static_cast<uint64_t>( tree.nbLeaves() ) );
+	priv::traceWrite( buf, vNodes );
+	p_append( buf );
+}
+//---------------------------------------------------------------------
+/// Saves the trace in file \c fname, returns false on failure, see priv::TraceHeader
+/**
+The file is first written under a temporary name, then renamed, so a failure never leaves a truncated file.
+*/
+inline
+bool
+TraceDiagSink::save( const std::string& fname ) const
+{
+	std::lock_guard<std::mutex> lock( _mtx );
+	priv::TraceHeader h;
+	std::memset( &h, 0, sizeof(h) );
+	std::memcpy( h.magic, priv::TraceMagic, sizeof(h.magic) );
+	h.version   = priv::TraceVersion;
+	h.byteOrder = 0x01020304;
+	h.nbRecords = _nbRecords;
+	h.nbLabels  = static_cast<uint32_t>( _vLabels.size() );
+
+	std::string head;
+	priv::traceWrite( head, h );
+	priv::traceWrite( head, _dataFileName );
+	for( const auto& lab: _vLabels )
+		priv::traceWrite( head, lab );
+
+	auto ftmp = fname + ".tmp" + std::to_string( std::random_device()() );
+	std::ofstream f( ftmp, std::ios::binary );
+	if( !f.is_open() )
+		return false;
+	f.write( head.data(), head.size() );
+	f.write( _buf.data(), _buf.size() );
+	f.close();
+	if( !f || std::rename( ftmp.c_str(), fname.c_str() ) != 0 )
+	{
+		std::remove( ftmp.c_str() );
+		return false;
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------
+/// Produces from a training trace file (see TraceDiagSink) the files that are otherwise written during the training,
+/// returns false if the file is not a valid trace
+/**
+All the files are opened through \c sink (see FileDiagSink to have them in the \c out folder):
+- the data/plot files of each split search, see writeSplitSearchFiles()
+- the DOT file of each tree, see DiagSink::addTree()
+- an html report (\c training.html) showing, for each node, the plots of the split searches, and the trees
+*/
+inline
+bool
+writeTraceReport( const std::string& fname, DiagSink& sink )
+{
+	START;
+	std::unique_ptr<priv::MappedFile> pmap;
+	try
+	{
+		pmap = std::make_unique<priv::MappedFile>( fname );
+	}
+	catch( const boost::interprocess::interprocess_exception& )
+	{
+		return false;
+	}
+	priv::TraceReader rd( pmap->data(), pmap->size() );
+
+	priv::TraceHeader h;
+	if( !rd.read( h )
+		|| std::memcmp( h.magic, priv::TraceMagic, sizeof(h.magic) ) != 0
+		|| h.version != priv::TraceVersion
+		|| h.byteOrder != 0x01020304
+	)
+		return false;
+
+	std::string dataFileName;
+	if( !rd.read( dataFileName ) )
+		return false;
+	std::vector<std::string> vLabels;
+	for( uint32_t i=0; i<h.nbLabels; i++ )   // read one at a time, so a corrupted nb of labels fails as soon as the data ends
+	{
+		std::string lab;
+		if( !rd.read( lab ) )
+			return false;
+		vLabels.push_back( std::move(lab) );
+	}
+
+	struct TreeRecord
+	{
+		int32_t     foldIndex = -1;
+		std::string name;
+		std::string dataFileName;
+		uint64_t    nbLeaves = 0;
+		std::vector<priv::TraceNode> vNodes;
+	};
+	std::vector<SplitSearchRecord> vRec;
+	std::vector<TreeRecord>        vTree;
+	std::set<int32_t>              foldSet;
+	for( uint64_t i=0; i<h.nbRecords; i++ )
+	{
+		uint8_t type = 0;
+		if( !rd.read( type ) )
+			return false;
+		if( type == priv::TR_SplitSearch )
+		{
+			SplitSearchRecord rec;
+			if( !rd.read( rec.nodeId ) || !rd.read( rec.atIdx ) || !rd.read( rec.foldIndex ) || !rd.read( rec.nbPoints )
+				|| !rd.read( rec.vThresVal ) || !rd.read( rec.vNbLT ) || !rd.read( rec.vNbHT ) || !rd.read( rec.vDeltaGini )
+				|| !rd.read( rec.vClassHisto )
+			)
+				return false;
+			auto nbThres = rec.vThresVal.size();
+			if( rec.vNbLT.size() != nbThres || rec.vNbHT.size() != nbThres || rec.vDeltaGini.size() != nbThres
+				|| ( !rec.vClassHisto.empty() && rec.vClassHisto.size() != (nbThres+1) * vLabels.size() )
+			)
+				return false;
+			foldSet.insert( rec.foldIndex );
+			vRec.push_back( std::move(rec) );
+		}
+		else
+		{
+			if( type != priv::TR_Tree )
+				return false;
+			TreeRecord tr;
+			if( !rd.read( tr.foldIndex ) || !rd.read( tr.name ) || !rd.read( tr.dataFileName ) || !rd.read( tr.nbLeaves )
+				|| !rd.read( tr.vNodes ) || tr.vNodes.empty()
+			)
+				return false;
+			for( size_t n=0; n<tr.vNodes.size(); n++ )
+				if( (n == 0) != (tr.vNodes[n].parent == -1) || tr.vNodes[n].parent >= static_cast<int32_t>(n) )
+					return false;
+			foldSet.insert( tr.foldIndex );
+			vTree.push_back( std::move(tr) );
+		}
+	}
+	if( !rd.atEnd() )
+		return false;
+
+// records of concurrent threads may be interleaved
+	std::stable_sort(
+		vRec.begin(),
+		vRec.end(),
+		[]( const SplitSearchRecord& r1, const SplitSearchRecord& r2 )   // lambda
+		{
+			return std::make_tuple( r1.foldIndex, r1.nodeId, r1.atIdx ) < std::make_tuple( r2.foldIndex, r2.nodeId, r2.atIdx );
+		}
+	);
+
+	std::ostream nullHtml( nullptr );
+	auto pfhtml = sink.openFile( "training", priv::FT_HTML, dataFileName );
+	auto& fhtml = pfhtml ? *pfhtml : nullHtml;
+
+	auto itRec = vRec.begin();
+	for( auto fold: foldSet )
+	{
+		fhtml << "<h2>B - Tree build" << ( fold == -1 ? "" : " (fold " + std::to_string(fold) + ")" ) << "</h2>\n"
+			<< "<h3>B1 - Point balance and IG vs. threshold value for each node</h3>\n<table>\n";
+		while( itRec != vRec.end() && itRec->foldIndex == fold )
+		{
+			auto itNext = std::find_if(
+				itRec,
+				vRec.end(),
+				[itRec]( const SplitSearchRecord& r ){ return r.foldIndex != itRec->foldIndex || r.nodeId != itRec->nodeId; }   // lambda
+			);
+			fhtml << "<tr><th></th>\n";
+			for( auto it=itRec; it!=itNext; it++ )
+				fhtml << "<th>Attribute " << it->atIdx << "</th>\n";
+			fhtml << "</tr>\n<tr><th>Node " << itRec->nodeId << "<br>" << itRec->nbPoints << " pts</th>\n";
+			for( auto it=itRec; it!=itNext; it++ )
+			{
+				fhtml << "<td>\n <img src='" << nodeFileName( "thres", it->nodeId, it->atIdx, it->foldIndex )
+					<< ".png'><br>\n <img src='" << nodeFileName( "thresClassHisto", it->nodeId, it->atIdx, it->foldIndex )
+					<< ".png'>\n</td>\n";
+				writeSplitSearchFiles( *it, dataFileName, vLabels, sink );
+			}
+			fhtml << "</tr>\n";
+			itRec = itNext;
+		}
+		fhtml << "</table>\n";
+
+		bool first = true;
+		for( const auto& tr: vTree )
+		{
+			if( tr.foldIndex != fold )
+				continue;
+			if( first )
+				fhtml << "<h3>B2 - Generated Tree</h3>\n<p>Leave Type Legend:</p>\n<ul>\n"
+					<< "<li>MGI: Min Gini Impurity</li>\n"
+					<< "<li>SC: Single Class</li>\n"
+					<< "<li>MD: Max Depth</li>\n"
+					<< "<li>STS: Split Too Small</li>\n"
+					<< "<li>MP: Merged by pruning</li>\n"
+					<< "</ul>\n";
+			first = false;
+
+			GraphT graph;
+			std::vector<vertexT_t> vVert( tr.vNodes.size() );
+			for( size_t n=0; n<tr.vNodes.size(); n++ )
+			{
+				const auto& tn = tr.vNodes[n];
+				vVert[n] = boost::add_vertex( graph );
+				auto& node = graph[vVert[n]];
+				node._nodeId       = tn.nodeId;
+				node._type         = static_cast<NodeType>( tn.type );
+				node._nClass       = ClassVal( tn.nClass );
+				node._attrIndex    = tn.attrIndex;
+				node._threshold    = tn.threshold;
+				node._giniImpurity = tn.giniImpurity;
+				node._nAmbig       = tn.nAmbig;
+				node._depth        = tn.depth;
+				node._nbPoints     = tn.nbPoints;
+				if( tn.parent != -1 )
+				{
+					auto e = boost::add_edge( vVert[tn.parent], vVert[n], graph );
+					graph[e.first].edgeSide = tn.edgeSide;
+				}
+			}
+			auto dotName = priv::dotFileName( tr.name, tr.foldIndex );
+			fhtml << "<h4>" << tr.name << " tree</h4>\n<img src='" << dotName << ".png'>\n";
+			if( auto pfdot = sink.openFile( dotName, priv::FT_DOT, std::string() ) )
+				priv::printDotTree( *pfdot, graph, vVert[0], tr.dataFileName, tr.nbLeaves );
+		}
+	}
+	fhtml << "</body></html>\n";
+	return true;
 }
 //---------------------------------------------------------------------
 /// Print the scores for all available performance criterions, for the given ConfusionMatrix
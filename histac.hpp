@@ -30,11 +30,41 @@ struct HParams
 
 };
 //---------------------------------------------------------------------
+/// Class counter, indexed by the class index (grows when needed), also holds the number of non-empty classes
+struct BinClassCount
+{
+	std::vector<size_t> _vCount;       ///< number of pts per class index
+	size_t              _nbClasses=0;  ///< number of classes with at least one point
+
+	void add( size_t cidx, size_t n=1 )
+	{
+		if( cidx >= _vCount.size() )
+			_vCount.resize( cidx+1, 0u );
+		if( !_vCount[cidx] )
+			_nbClasses++;
+		_vCount[cidx] += n;
+	}
+	void clear()
+	{
+		_vCount.clear();
+		_nbClasses = 0;
+	}
+/// Returns the index of the first non-empty class (or size() if none)
+	size_t firstClass() const
+	{
+		size_t c = 0;
+		while( c<_vCount.size() && !_vCount[c] )
+			c++;
+		return c;
+	}
+	size_t nbClasses() const { return _nbClasses; }
+};
+//---------------------------------------------------------------------
 /// Variable bin-size histogram, used to find the best thresholds on the attribute values
 /**
 template arguments:
 - 1st argument type is the floating-point type (\c float or \c double)
-- 2nd type is the key used for the mapping (class type, see dtcpp::ClassVal)
+- 2nd type is the integral class index, in the range 0..K-1 (see dtcpp::ClassIndex)
 */
 template<typename U,typename KEY>
 struct VBS_Histogram
@@ -46,9 +76,9 @@ struct VBS_Histogram
 	{
 		friend struct VBS_Histogram;
 
-		static int sBinIdCounter;
+		static thread_local int sBinIdCounter;  // (thread_local, as histograms can be built concurrently on several attributes)
 		private:
-			std::map<KEY,size_t> _mClassCounter;  ///< number of pts per class
+			BinClassCount        _classCounter;   ///< number of pts per class
 			T                    _startValue;     ///< bin left border
 			T                    _endValue;       ///< bin right border
 			std::vector<size_t>  _vIdxPt;         ///< indexes of the points in original dataset
@@ -76,14 +106,14 @@ struct VBS_Histogram
 					return false;
 				if( _doNotSplit )
 					return false;
-				if( _mClassCounter.size() < 2 )  // single class, no need to split
+				if( _classCounter.nbClasses() < 2 )  // single class, no need to split
 					return false;
 				return true;
 			}
 /// Returns the number of points in the bin
 			size_t size()      const { return _vIdxPt.size(); }
 /// Returns the number of classes in the bin
-			size_t nbClasses() const { return _mClassCounter.size(); }
+			size_t nbClasses() const { return _classCounter.nbClasses(); }
 			std::pair<T,T> getBorders() const
 			{
 				return std::make_pair( _startValue, _endValue );
@@ -96,12 +126,13 @@ struct VBS_Histogram
 				if( b._doNotSplit )
 					f << "NS, ";
 				f  << b.nbClasses() << "classes: ";
-				for( const auto& pc: b._mClassCounter )
-					f << "C" << pc.first << "=" << pc.second << ", ";
+				for( size_t c=0; c<b._classCounter._vCount.size(); c++ )
+					if( b._classCounter._vCount[c] )
+						f << "C" << c << "=" << b._classCounter._vCount[c] << ", ";
 //				f << "range=" << b._startValue << "-" << b._endValue << ' ';
 
 //				if( b.nbClasses() == 1 )
-//					f << '(' << b._mClassCounter.begin()->first << ") ";
+//					f << '(' << b._classCounter.firstClass() << ") ";
 #ifdef BIN_PRINT_POINTS
 				f << " points: ";
 					priv::printVector( f, b._vIdxPt );
@@ -119,8 +150,9 @@ struct VBS_Histogram
 		std::list<HBin<U>>   _lBins;                       ///< list of bins
 	private:
 		size_t               _bMaxDepth = 10;
+		size_t               _splitDepth = 0;              ///< current recursion depth of p_splitBin()
 		size_t               _nbPts=0;                     ///< Total nb of points. \warning Can be different than the input vector size because some data points can be discarded
-		std::map<KEY,size_t> _mCCount;                     ///< nb of points per class, for the whole histogram
+		BinClassCount        _classCount;                  ///< nb of points per class, for the whole histogram
 		HParams              _hparams;                     ///< general parameters
 
 	public: // TEMP
@@ -165,7 +197,7 @@ struct VBS_Histogram
 
 template<typename U,typename KEY>
 template<typename T>
-int VBS_Histogram<U,KEY>::HBin<T>::sBinIdCounter=0;
+thread_local int VBS_Histogram<U,KEY>::HBin<T>::sBinIdCounter=0;
 //---------------------------------------------------------------------
 /// Constructor, creates bins evenly spaced
 /**
@@ -228,9 +260,9 @@ VBS_Histogram<T,KEY>::p_assignToBin( const std::pair<T,KEY>& pac, size_t idx )
 		if( pac.first >= bin._startValue && pac.first < bin._endValue )
 		{
 			bin._vIdxPt.push_back( idx );
-			bin._mClassCounter[pac.second]++;
+			bin._classCounter.add( pac.second );
 			keepOn = false;
-			_mCCount[pac.second]++;
+			_classCount.add( pac.second );
 		}
 	}
 
@@ -238,8 +270,8 @@ VBS_Histogram<T,KEY>::p_assignToBin( const std::pair<T,KEY>& pac, size_t idx )
 	{             // if point did not fit in any of the other bins, then we put it in the last bin
 		auto& bin = _lBins.back();
 		bin._vIdxPt.push_back( idx );
-		bin._mClassCounter[pac.second]++;
-		_mCCount[pac.second]++;
+		bin._classCounter.add( pac.second );
+		_classCount.add( pac.second );
 	}
 }
 
@@ -264,14 +296,13 @@ VBS_Histogram<T,KEY>::printInfo( std::ostream& f, const char* msg ) const
 	f << "\n - nb bins=" << nbBins()
 		<< ", tagged as \"no split\"=" << nbNoSplit
 		<< "\n - nb pts=" << nbPts()
-		<< "\n - nb classes=" << _mCCount.size()
+		<< "\n - nb classes=" << _classCount.nbClasses()
 		<< '\n';
 
 	f << " * Classes:\n";
-	for( const auto& cla: _mCCount )
-		f << " Class " << cla.first << ": " << cla.second << " pts\n";
-
-//	priv::printMap( f, _mCCount );
+	for( size_t c=0; c<_classCount._vCount.size(); c++ )
+		if( _classCount._vCount[c] )
+			f << " Class " << c << ": " << _classCount._vCount[c] << " pts\n";
 }
 //---------------------------------------------------------------------
 template<typename T,typename KEY>
@@ -304,16 +335,15 @@ bool
 VBS_Histogram<T,KEY>::p_splitBin( decltype( _lBins.begin() ) it, char side )
 {
 	assert( p_src );
-	static size_t depth_sb;
-	depth_sb++;
+	_splitDepth++;
 
 	bool retval = false;
 	auto& bin = *it;                // current bin
 	auto it_next = std::next(it);  // next one (will insert before this one)
-	COUT << side << ": depth=" << depth_sb << " start split " << bin << '\n';
+	COUT << side << ": depth=" << _splitDepth << " start split " << bin << '\n';
 
 //	print( std::cout );
-	if( depth_sb >= _bMaxDepth )
+	if( _splitDepth >= _bMaxDepth )
 	{
 		COUT << "Reached MAX DEPTH! bin=" << bin << '\n';
 		_reachedMaxDepth++;
@@ -325,7 +355,7 @@ VBS_Histogram<T,KEY>::p_splitBin( decltype( _lBins.begin() ) it, char side )
 			break;
 			case EN_MDB::discardNonMajPoints:
 			{
-				auto fdc = priv1::findDominantClass( bin._mClassCounter );
+				auto fdc = priv1::findDominantClass( bin._classCounter._vCount );
 				if( fdc.ambig < 0.9 )        /// \todoM magic value, store in some parameter
 				{
 					COUT << "nbpts BEFORE=" << _nbPts << '\n';
@@ -336,13 +366,13 @@ VBS_Histogram<T,KEY>::p_splitBin( decltype( _lBins.begin() ) it, char side )
 					for( const auto idx: bin._vIdxPt )   // parse the points
 					{
 						const auto& pt = p_src->at(idx); // and add only the points
-						if( pt.second == fdc.dominantClass )      // that are of dominant class
+						if( static_cast<size_t>(pt.second) == fdc.dominantClass )  // that are of dominant class
 							vec1.push_back( idx );
 					}
 					bin._vIdxPt = std::move(vec1);
 
-					bin._mClassCounter.clear();
-					bin._mClassCounter[fdc.dominantClass] = fdc.dcCount;
+					bin._classCounter.clear();
+					bin._classCounter.add( fdc.dominantClass, fdc.dcCount );
 					_nbPts += bin.size();
 				}
 			}
@@ -351,7 +381,7 @@ VBS_Histogram<T,KEY>::p_splitBin( decltype( _lBins.begin() ) it, char side )
 			default: assert(0);
 		}
 		COUT << "AFTER bin:" << bin << '\n' << " nbpts AFTER=" << _nbPts << '\n';
-		depth_sb--;
+		_splitDepth--;
 		return false;
 	}
 
@@ -371,8 +401,8 @@ VBS_Histogram<T,KEY>::p_splitBin( decltype( _lBins.begin() ) it, char side )
 			vec1.reserve( bin.size() );
 			vec2.reserve( bin.size() );
 
-			std::map<KEY,size_t> mapCount1;
-			std::map<KEY,size_t> mapCount2;
+			BinClassCount count1;
+			BinClassCount count2;
 
 			for( const auto idx: bin._vIdxPt )  // parse the points
 			{
@@ -380,12 +410,12 @@ VBS_Histogram<T,KEY>::p_splitBin( decltype( _lBins.begin() ) it, char side )
 				if( pt.first >= midValue )         // the two bins
 				{
 					vec2.push_back( idx );
-					mapCount2[ pt.second ]++;
+					count2.add( pt.second );
 				}
 				else
 				{
 					vec1.push_back( idx );
-					mapCount1[ pt.second ]++;
+					count1.add( pt.second );
 				}
 			}
 
@@ -395,12 +425,12 @@ VBS_Histogram<T,KEY>::p_splitBin( decltype( _lBins.begin() ) it, char side )
 //			if( vec1.size() != 0 )
 			{
 				bin._vIdxPt           = std::move(vec1);
-				bin._mClassCounter    = std::move(mapCount1);
+				bin._classCounter     = std::move(count1);
 			}
 //			if( vec2.size() != 0 )
 			{
 				newBin._vIdxPt        = std::move(vec2);
-				newBin._mClassCounter = std::move(mapCount2);
+				newBin._classCounter  = std::move(count2);
 			}
 			_lBins.insert( it_next, newBin );  // insert the new bin in histogram
 
@@ -415,7 +445,7 @@ VBS_Histogram<T,KEY>::p_splitBin( decltype( _lBins.begin() ) it, char side )
 	else
 		COUT << "NOT splittable\n";
 
-	depth_sb--;
+	_splitDepth--;
 	return retval;
 }
 
@@ -505,11 +535,11 @@ VBS_Histogram<T,KEY>::mergeSearch()
 
 				if( b1.nbClasses() == 1 && b2.nbClasses() == 1 )  // if the 2 bins only hold 1 class
 				{
-					auto itc1 = b1._mClassCounter.begin();
-					auto itc2 = b2._mClassCounter.begin();
-					if( itc1->first  == itc2->first  )             // if they hold the same class
+					auto c1 = b1._classCounter.firstClass();
+					auto c2 = b2._classCounter.firstClass();
+					if( c1 == c2 )                                 // if they hold the same class
 					{
-						COUT << "same class (" << itc1->first  << "), merging bins\n";
+						COUT << "same class (" << c1 << "), merging bins\n";
 						b1._vIdxPt.insert(                        // then copy the points from b2 into b1
 							b1._vIdxPt.end(),
 							b2._vIdxPt.begin(),
@@ -0,0 +1,24 @@
+/**
+\file
+\brief Wrapper used to build a shared library from the C++ code of a tree, generated by \c dectree
+with the \c -cg switch (see dtcpp::TrainingTree::printCode() and the \c model target of the makefile).
+\author S. Kramm - 2021
+*/
+
+#include "tree_model.h"
+
+/// Returns the class value of the point whose attribute values are given by \c v
+extern "C"
+int
+dtcpp_classify( const float* v )
+{
+	return dtcpp_model::classify( v );
+}
+//---------------------------------------------------------------------
+/// Returns the string label of class value \c c, or null if there is none
+extern "C"
+const char*
+dtcpp_class_label( int c )
+{
+	return dtcpp_model::classLabel( c );
+}
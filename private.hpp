@@ -8,9 +8,35 @@
 #define PRIVATE_HG
 
 #include <iostream>
+#include <mutex>
 
 #define DTCPP_PLOT_MAX_WIDTH 1500
 
+/// Minimal size (in bytes) of the chunks of a data file parsed by separate threads, see Fparams::nbThreads
+#ifndef DTCPP_MIN_CHUNK_SIZE
+	#define DTCPP_MIN_CHUNK_SIZE (1<<20)
+#endif
+
+/// Minimal size of a node (nb of points x nb of attributes) for its attributes to be processed by several threads, see Params::nbThreads
+#ifndef DTCPP_MIN_PARALLEL_SIZE
+	#define DTCPP_MIN_PARALLEL_SIZE (1<<14)
+#endif
+
+/// Minimal nb of points of both child nodes for their subtrees to be built by separate threads, see Params::nbThreads
+#ifndef DTCPP_MIN_SUBTREE_TASK_SIZE
+	#define DTCPP_MIN_SUBTREE_TASK_SIZE (1<<11)
+#endif
+
+/// Nb of points going down the tree together in the batch classification, see InferenceTree::predict(). Must be a multiple of 4
+#ifndef DTCPP_INFERENCE_BATCH
+	#define DTCPP_INFERENCE_BATCH 16
+#endif
+
+/// If defined (and SSE2 is available), the batch classification compares the points with the thresholds 4 at a time,
+/// with SSE2 instructions (see InferenceTree::p_findLeavesSSE2()). Not the default: gathering the attribute values dominates,
+/// and this was measured a bit slower than the scalar path on trees fitting in cache
+//#define DTCPP_SIMD_INFERENCE
+
 #ifdef DEBUG_START
 	#define START if(1) std::cout << "* Start: " << __FUNCTION__ << "()\n"
 	#ifndef DEBUG
@@ -30,9 +56,11 @@
 	{ \
 		if( g_params.verbose && level<=g_params.verboseLevel ) \
 		{ \
-			std::cout << std::setfill('0') << std::setw(4) << g_params.timer.getDuration(level); \
-			priv1::spaceLog( level ); \
-			std::cout << " E" << std::setfill('0') << std::setw(4) << priv1::logCount(level)++ << '-' << __FUNCTION__ << "(): " << msg << '\n'; \
+			std::lock_guard<std::mutex> logLock( priv1::logMutex() ); \
+			auto& logOut = *priv1::logStream(); \
+			logOut << std::setfill('0') << std::setw(4) << g_params.timer.getDuration(level); \
+			priv1::spaceLog( logOut, level ); \
+			logOut << " E" << std::setfill('0') << std::setw(4) << priv1::logCount(level)++ << '-' << __FUNCTION__ << "(): " << msg << '\n'; \
 		} \
 	}
 
@@ -54,13 +82,30 @@ uint& logCount(uint level)
 	return s_logCount[level];
 }
 
+//---------------------------------------------------------------------
+/// Used in logging macro, so that log lines from different threads do not get mixed (see Params::nbThreads)
+std::mutex& logMutex()
+{
+	static std::mutex s_logMutex;
+	return s_logMutex;
+}
+
+//---------------------------------------------------------------------
+/// Stream the logging macro writes to, for the current thread (\c std::cout by default).
+/// Redirected by crossValidate() so that the folds trained concurrently have separate logs
+std::ostream*& logStream()
+{
+	static thread_local std::ostream* s_logStream = &std::cout;
+	return s_logStream;
+}
+
 //---------------------------------------------------------------------
 /// Used in logging macro, see macro LOG
-void spaceLog( int n )
+void spaceLog( std::ostream& f, int n )
 {
-	std::cout << ':';
+	f << ':';
 	for( int i=0; i<n; i++ )
-		std::cout << " |";
+		f << " |";
 }
 
 //---------------------------------------------------------------------
@@ -139,6 +184,30 @@ findDominantClass( const std::map<C,size_t>& mcount )
 	return DominantClassInfo<C>{ cmax, vmax, 1.f * vmax2/vmax };
 }
 
+/// Same as above, but for a class-counting vector, indexed by class index (null counts are ignored)
+inline
+DominantClassInfo<size_t>
+findDominantClass( const std::vector<size_t>& vcount )
+{
+	assert( std::count_if( vcount.begin(), vcount.end(), []( size_t c ){ return c != 0; } ) > 1 );
+
+	size_t vmax  = 0u;
+	size_t vmax2 = vmax;
+	size_t cmax  = size_t(-1);  // no class
+
+	for( size_t c=0; c<vcount.size(); c++ )
+	{
+		if( vcount[c] > vmax )
+		{
+			vmax2 = vmax;
+			vmax = vcount[c];
+			cmax = c;
+		}
+	}
+	assert( vmax>0 );
+	return DominantClassInfo<size_t>{ cmax, vmax, 1.f * vmax2/vmax };
+}
+
 //---------------------------------------------------------------------
 /// General utility function
 template<typename T>
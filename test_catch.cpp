@@ -11,8 +11,13 @@
 //#define DEBUG
 //#define DEBUG_START
 #define TESTMODE
+#define DTCPP_MIN_CHUNK_SIZE 256   // so that parallel parsing gets used on the small sample files
+#define DTCPP_MIN_SUBTREE_TASK_SIZE 100   // so that subtrees get built by separate threads on the test datasets
+#define DTCPP_SIMD_INFERENCE              // so that both batch classification paths get tested
 #include "dtcpp.h"
 
+#include <regex>
+
 
 using namespace dtcpp;
 
@@ -116,6 +121,88 @@ TEST_CASE( "dataset", "[dataset]" )
 	CHECK( dataset.nbClasses() == 1 );
 }
 //-------------------------------------------------------------------------------------------
+TEST_CASE( "dataset columns", "[dscol]" )
+{
+	DataSet dataset(3); // 3 attributes
+	dataset.addPoint( DataPoint( std::vector<float>{ 1., 2., 3. }, ClassVal(1) ) );
+	dataset.addPoint( DataPoint( std::vector<float>{ 4., 5., 6. }, ClassVal(2) ) );
+	dataset.addPoint( DataPoint( std::vector<float>{ 7., 8., 9. } ) );
+
+	CHECK( dataset.getColumn(0)[1] == 4. );
+	CHECK( dataset.getColumn(2)[2] == 9. );
+	CHECK( reinterpret_cast<uintptr_t>( dataset.getColumn(1) ) % 64 == 0 );  // aligned on cache line
+	CHECK( dataset.getClassColumn()[1] == ClassVal(2) );
+	CHECK( dataset.isClassLess(2) );
+
+	const auto& pt = dataset.getDataPoint(1);   // row view
+	CHECK( pt.isView() );
+	CHECK( pt.nbAttribs() == 3 );
+	CHECK( pt.attribVal(1) == 5. );
+	CHECK( pt.classVal() == ClassVal(2) );
+
+	size_t c = 0;
+	for( const auto& p: dataset )
+		CHECK( p.attribVal(0) == dataset.getColumn(0)[c++] );
+	CHECK( c == 3 );
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "dataset view", "[dsview]" )
+{
+	Fparams fparams;
+	fparams.sep = ',';
+	fparams.classAsString = true;
+	DataSet ds;
+	REQUIRE( ds.load( "sample_data/iris.data", fparams ) );
+
+	DataSetView view( ds );
+	CHECK( view.size() == ds.size() );
+	view.shuffle();
+	CHECK( view.size() == ds.size() );
+	auto vIdx = view.getIndexes();
+	std::sort( vIdx.begin(), vIdx.end() );
+	for( size_t i=0; i<vIdx.size(); i++ )     // still a permutation
+		CHECK( vIdx[i] == i );
+	CHECK( view.getDataPoint(5).attribVal(2) == ds.getColumn(2)[ view.parentIndex(5) ] );
+
+	{
+		auto folds = view.getFolds( 1, 3 );
+		CHECK( folds.first.size()  == 100 );
+		CHECK( folds.second.size() == 50 );
+		CHECK( folds.second.parentIndex(0) == view.parentIndex(50) );
+	}
+	{
+		auto folds = ds.getStratifiedFolds( 2, 5 );   // iris holds 50 pts of each class
+		CHECK( folds.first.size()  == 120 );
+		CHECK( folds.second.size() == 30 );
+		CHECK( folds.second.nbClasses() == 3 );
+		for( int c=0; c<3; c++ )
+		{
+			CHECK( folds.first.getClassCount( ClassVal(c) )  == 40 );
+			CHECK( folds.second.getClassCount( ClassVal(c) ) == 10 );
+		}
+	}
+
+// training on a view must give the same tree as training on a copy of the same points
+	auto folds = view.getFolds( 0, 3 );
+	DataSet ds_copy( ds.nbAttribs() );
+	for( size_t i=0; i<folds.first.size(); i++ )
+		ds_copy.addPoint( folds.first.getDataPoint(i) );
+
+	std::ostringstream oss;
+	Params params;
+	params.outputHtml = &oss;
+	TrainingTree tt1( ds.getClassIndexMap() ), tt2( ds.getClassIndexMap() );
+	auto ti1 = tt1.train( folds.first, params );
+	auto ti2 = tt2.train( ds_copy, params );
+	CHECK( ti1.nbRemovals == ti2.nbRemovals );
+	CHECK( tt1.nbLeaves() == tt2.nbLeaves() );
+	CHECK( tt1.maxDepth() == tt2.maxDepth() );
+	auto cm = tt1.classify( folds.second );
+	CHECK( cm.nbValues() == 50 );
+	for( size_t i=0; i<ds.size(); i++ )
+		CHECK( tt1.classify( ds.getDataPoint(i) ) == tt2.classify( ds.getDataPoint(i) ) );
+}
+//-------------------------------------------------------------------------------------------
 TEST_CASE( "confusion matrix", "[cmat]" )
 {
 // a sample confusion matrix (column: real class, lines, predicted class)
@@ -196,6 +283,225 @@ TEST_CASE( "computeBestThreshold", "[cbt]" )
 	auto ba = findBestAttribute( v_dpidx, dataset, params, 0, pm.first, giniCoeff, f );
 }
 //-------------------------------------------------------------------------------------------
+/// Helper function for the "single sweep Gini" test: previous version of the threshold search,
+/// that counts all the points for each threshold
+std::vector<float>
+deltaGiniScan( uint atIdx, double giniCoeff, const std::vector<float>& v_thresVal, const DataSet& data, const std::vector<uint>& v_dpidx )
+{
+	std::vector<float> deltaGini( v_thresVal.size() );
+	for( size_t i=0; i<v_thresVal.size(); i++ )
+	{
+		ClassCounter m_LT, m_HT;
+		size_t nb_LT = 0, nb_HT = 0;
+		for( auto ptIdx: v_dpidx )
+		{
+			auto cval = data.classVal( ptIdx );
+			if( cval != ClassVal(-1) )
+			{
+				if( data.getColumn( atIdx )[ptIdx] < v_thresVal[i] )
+				{
+					m_LT[ cval ]++;
+					nb_LT++;
+				}
+				else
+				{
+					m_HT[ cval ]++;
+					nb_HT++;
+				}
+			}
+		}
+		auto g_LT = 1.;
+		for( auto p: m_LT )
+		{
+			auto val = 1. * p.second / nb_LT;
+			g_LT -= val*val;
+		}
+		auto g_HT = 1.;
+		for( auto p: m_HT )
+		{
+			auto val = 1. * p.second / nb_HT;
+			g_HT -= val*val;
+		}
+		deltaGini[i] = giniCoeff - (g_LT + g_HT) / 2.;
+	}
+	return deltaGini;
+}
+
+TEST_CASE( "single sweep Gini", "[sweep]" )
+{
+	Fparams fparams;
+	fparams.sep = ',';
+	fparams.classIsfirst = true;
+	DataSet ds;
+	REQUIRE( ds.load( "sample_data/wine.data", fparams ) );
+
+	Params params;
+	std::ofstream f;
+	auto v_all = setAllDataPoints( ds );
+	std::vector<uint> v_half;                 // a subset of the points, not ordered
+	for( size_t i=0; i<ds.size(); i+=2 )
+		v_half.push_back( v_all[ds.size()-1-i] );
+
+	for( const auto& v_dpidx: { v_all, v_half } )
+	{
+		auto giniCoeff = getGiniImpurity( getNodeClassCount( v_dpidx, ds ) );
+		for( uint at=0; at<ds.nbAttribs(); at++ )
+		{
+			std::vector<float> v_thresVal;
+			REQUIRE( thres_useSorting( at, v_dpidx, ds, params, v_thresVal ) );
+			std::reverse( v_thresVal.begin(), v_thresVal.end() );     // so thresholds are not sorted
+
+			std::vector<float>  deltaGini;
+			std::vector<uint>   nb_LT;
+			std::vector<size_t> nb_HT;
+			computeDeltaGini( at, giniCoeff, v_thresVal, ds, v_dpidx, false, deltaGini, nb_LT, nb_HT );
+			auto deltaGini2 = deltaGiniScan( at, giniCoeff, v_thresVal, ds, v_dpidx );
+			CHECK( deltaGini == deltaGini2 );   // exactly the same values
+
+			auto ad = SearchBestIG( 0, at, giniCoeff, v_thresVal, ds, v_dpidx, f );
+			auto best = std::max_element( deltaGini2.begin(), deltaGini2.end() ) - deltaGini2.begin();
+			CHECK( ad._threshold.get() == v_thresVal[best] );
+			CHECK( ad._gain == deltaGini2[best] );
+			CHECK( ad._nbPtsLessThan + nb_HT[best] == v_dpidx.size() );
+		}
+	}
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "block split evaluation", "[blocks]" )
+{
+	std::mt19937 rng( 7 );
+	DataSet ds( 2 );
+	for( int i=0; i<20000; i++ )
+	{
+		float v = rng()%1000 / 10.;
+		int c = ( v > 30. ) + ( v > 70. );
+		if( rng()%5 == 0 )
+			c = rng()%3;
+		if( i%100 == 0 )
+			ds.addPoint( DataPoint( std::vector<float>{ v, 0. } ) );     // classless
+		else
+			ds.addPoint( DataPoint( std::vector<float>{ v, 0. }, ClassVal(c) ) );
+	}
+	std::vector<uint> v_dpidx;
+	for( uint i=0; i<ds.size(); i+=3 )
+		v_dpidx.push_back( i );
+	std::vector<float> v_thresVal;                 // not sorted, with duplicates, and some below/above all the values
+	for( int i=0; i<60; i++ )
+		v_thresVal.push_back( int( rng()%1100 ) / 10. - 5. );
+	v_thresVal.push_back( v_thresVal[3] );
+
+	auto giniCoeff = getGiniImpurity( getNodeClassCount( v_dpidx, ds ) );
+	dtcpp::priv::ThreadPool pool( 4 );
+	std::vector<float>  dg1, dg2;
+	std::vector<uint>   nlt1, nlt2;
+	std::vector<size_t> nht1, nht2;
+	computeDeltaGini( 0, giniCoeff, v_thresVal, ds, v_dpidx, false, dg1, nlt1, nht1 );
+	computeDeltaGini( 0, giniCoeff, v_thresVal, ds, v_dpidx, false, dg2, nlt2, nht2, nullptr, &pool );
+	CHECK( dg1  == dg2 );               // exactly the same values
+	CHECK( nlt1 == nlt2 );
+	CHECK( nht1 == nht2 );
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "class index", "[cidx]" )
+{
+	DataSet ds( 2 );
+	ds.addPoint( DataPoint( std::vector<float>{ 1., 2. }, ClassVal(7) ) );
+	ds.addPoint( DataPoint( std::vector<float>{ 1., 3. }, ClassVal(3) ) );
+	ds.addPoint( DataPoint( std::vector<float>{ 1., 4. } ) );               // classless
+	ds.addPoint( DataPoint( std::vector<float>{ 1., 5. }, ClassVal(7) ) );
+
+	auto checkColumn = [&]()        // lambda: column must be consistent with the class index map
+	{
+		const auto* cidx = ds.getClassIndexColumn();
+		for( size_t i=0; i<ds.size(); i++ )
+			if( ds.classVal(i) == ClassVal(-1) )
+				CHECK( cidx[i] == NoClassIndex );
+			else
+				CHECK( cidx[i] == ds.getIndexFromClass( ds.classVal(i) ) );
+	};
+
+	CHECK( ds.nbClasses() == 2 );
+	CHECK( ds.getIndexFromClass( ClassVal(3) ) == 0 );   // indexes follow the class values order
+	CHECK( ds.getIndexFromClass( ClassVal(7) ) == 1 );
+	const auto* cidx = ds.getClassIndexColumn();
+	CHECK( cidx[0] == 1 );
+	CHECK( cidx[1] == 0 );
+	CHECK( cidx[2] == NoClassIndex );
+	CHECK( cidx[3] == 1 );
+
+	auto ncc = getNodeClassCount( std::vector<uint>{ 0, 1, 2, 3 }, ds );
+	CHECK( ncc.first  == ClassCountArray{ 1, 2 } );
+	CHECK( ncc.second == 3 );
+	CHECK( getGiniImpurity( ncc ) == Approx( 1. - 1./9. - 4./9. ) );
+
+	ds.addPoint( DataPoint( std::vector<float>{ 1., 6. }, ClassVal(1) ) ); // new class: indexes are shifted
+	CHECK( ds.nbClasses() == 3 );
+	CHECK( ds.getIndexFromClass( ClassVal(1) ) == 0 );
+	CHECK( ds.getIndexFromClass( ClassVal(7) ) == 2 );
+	checkColumn();
+
+	ds.shuffle();
+	checkColumn();
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "split kernels", "[kernels]" )
+{
+	for( size_t k=0; k<=9; k++ )
+		CHECK( priv::selectSplitKernels( k ).nbClasses == ( k>=2 && k<=8 ? k : 0 ) );
+
+	std::mt19937 rng( 42 );
+	const priv::SplitKernels generic;
+	for( size_t k=2; k<=9; k++ )                // 9: generic fallback
+	{
+		auto kernels = priv::selectSplitKernels( k );
+		for( int iter=0; iter<20; iter++ )
+		{
+			ClassCountArray vcount( k );
+			size_t nbpts = 0;
+			for( auto& c: vcount )
+			{
+				c = rng()%4 ? rng()%50 : 0;        // some classes are empty
+				nbpts += c;
+			}
+			auto c1 = rng()%k;                     // at least 2 non-empty classes
+			vcount[c1] += 1;
+			vcount[ (c1 + 1 + rng()%(k-1)) % k ] += 2;
+			nbpts += 3;
+
+			CHECK( kernels.gini( vcount, nbpts ) == getGiniImpurity( std::make_pair( vcount, nbpts ) ) );
+			auto fdc1 = kernels.dominantClass( vcount );
+			auto fdc2 = priv1::findDominantClass( vcount );
+			CHECK( fdc1.dominantClass == fdc2.dominantClass );
+			CHECK( fdc1.dcCount       == fdc2.dcCount );
+			CHECK( fdc1.ambig         == fdc2.ambig );
+
+			std::vector<std::pair<float,ClassIndex>> v_pts;   // the sweep, on random points
+			ClassCountArray count_all( k, 0u );
+			for( int i=0; i<200; i++ )
+			{
+				auto c = rng()%k;
+				v_pts.emplace_back( rng()%100, c );
+				count_all[c]++;
+			}
+			std::sort( v_pts.begin(), v_pts.end(), []( const std::pair<float,ClassIndex>& p1, const std::pair<float,ClassIndex>& p2 ){ return p1.first < p2.first; } );
+			std::vector<float> v_thresVal;
+			for( float t=0.5; t<100.; t+=7. )
+				v_thresVal.push_back( t );
+			std::vector<size_t> v_thresIdx( v_thresVal.size() );
+			std::iota( v_thresIdx.begin(), v_thresIdx.end(), 0 );
+
+			std::vector<float>  dg1( v_thresVal.size() ), dg2( v_thresVal.size() );
+			std::vector<uint>   nlt1( v_thresVal.size() ), nlt2( v_thresVal.size() );
+			std::vector<size_t> nht1( v_thresVal.size() ), nht2( v_thresVal.size() );
+			kernels.sweepDeltaGini( v_pts, count_all, 0.6, v_thresVal, v_thresIdx, dg1, nlt1, nht1 );
+			generic.sweepDeltaGini( v_pts, count_all, 0.6, v_thresVal, v_thresIdx, dg2, nlt2, nht2 );
+			CHECK( dg1  == dg2 );               // exactly the same values
+			CHECK( nlt1 == nlt2 );
+			CHECK( nht1 == nht2 );
+		}
+	}
+}
+//-------------------------------------------------------------------------------------------
 TEST_CASE( "getGiniImpurity", "[GI]" )
 {
 	{
@@ -240,6 +546,709 @@ TEST_CASE( "removeDuplicates", "[RD]" )
 	}
 }
 //-------------------------------------------------------------------------------------------
+TEST_CASE( "presorted attributes", "[presort]" )
+{
+	Fparams fparams;
+	fparams.sep = ',';
+	fparams.classIsfirst = true;
+	DataSet ds;
+	REQUIRE( ds.load( "sample_data/wine.data", fparams ) );
+
+	Params params;
+	params.useSortToFindThresholds = true;
+	std::ostringstream oss;
+	params.outputHtml = &oss;
+
+// same thresholds as when sorting the values of the node
+	NodeT node;
+	node.v_Idx = setAllDataPoints( ds );
+	dtcpp::priv::presortAttributes( node, ds );
+	REQUIRE( node.v_SortedIdx.size() == ds.nbAttribs() );
+	auto pm = getNodeClassCount( node.v_Idx, ds );
+	auto giniCoeff = getGiniImpurity( pm );
+	for( uint at=0; at<ds.nbAttribs(); at++ )
+	{
+		const auto* col = ds.getColumn( at );
+		const auto& vs = node.v_SortedIdx[at];
+		CHECK( std::is_sorted( vs.begin(), vs.end(), [col]( uint i1, uint i2 ){ return col[i1] < col[i2]; } ) );
+		auto ad1 = computeBestThreshold( at, node.v_Idx, ds, giniCoeff, params, 0, oss );
+		auto ad2 = computeBestThreshold( at, node.v_Idx, ds, giniCoeff, params, 0, oss, &vs );
+		CHECK( ad1._threshold == ad2._threshold );
+		CHECK( ad1._gain == ad2._gain );
+		CHECK( ad1._nbPtsLessThan == ad2._nbPtsLessThan );
+	}
+
+// same tree
+	TrainingTree tt1( ds.getClassIndexMap() ), tt2( ds.getClassIndexMap() ), tt3( ds.getClassIndexMap() );
+	auto ti1 = tt1.train( ds, params );
+	params.usePresortedAttributes = true;
+	auto ti2 = tt2.train( ds, params );
+	params.memoryBudget = 1;       // sorted lists also get moved out of memory
+	auto ti3 = tt3.train( ds, params );
+	CHECK( ti3.nbSpilledLists > 0 );
+	CHECK( ti1.nbRemovals == ti2.nbRemovals );
+	CHECK( ti1.nbRemovals == ti3.nbRemovals );
+	CHECK( tt1.nbLeaves() == tt2.nbLeaves() );
+	CHECK( tt1.nbLeaves() == tt3.nbLeaves() );
+	CHECK( tt1.maxDepth() == tt2.maxDepth() );
+	for( size_t i=0; i<ds.size(); i++ )
+	{
+		CHECK( tt1.classify( ds.getDataPoint(i) ) == tt2.classify( ds.getDataPoint(i) ) );
+		CHECK( tt1.classify( ds.getDataPoint(i) ) == tt3.classify( ds.getDataPoint(i) ) );
+	}
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "thread pool", "[pool]" )
+{
+	dtcpp::priv::ThreadPool pool( 4 );
+	CHECK( pool.nbThreads() == 4 );
+
+	std::vector<size_t> vec( 1000, 0u );
+	pool.parallelFor( vec.size(), [&]( size_t i ){ vec[i] = i*i; } );
+	for( size_t i=0; i<vec.size(); i++ )
+		CHECK( vec[i] == i*i );
+
+	std::vector<std::vector<int>> vv( 10, std::vector<int>( 10, 0 ) );   // nested loops
+	pool.parallelFor( 10, [&]( size_t i ){ pool.parallelFor( 10, [&]( size_t j ){ vv[i][j] = i+j; } ); } );
+	for( size_t i=0; i<10; i++ )
+		for( size_t j=0; j<10; j++ )
+			CHECK( vv[i][j] == int(i+j) );
+
+	CHECK_THROWS_AS( pool.parallelFor( 10, []( size_t i ){ if( i==5 ) throw std::runtime_error( "err" ); } ), std::runtime_error );
+
+	dtcpp::priv::ThreadPool pool1( 1 );      // no worker thread, all done by the caller
+	int sum = 0;
+	pool1.parallelFor( 10, [&]( size_t i ){ sum += i; } );
+	CHECK( sum == 45 );
+}
+//-------------------------------------------------------------------------------------------
+/// Helper function, returns true if the subtrees starting at \c v1 and \c v2 are the same (node ids excepted)
+bool
+sameTree( const GraphT& g1, vertexT_t v1, const GraphT& g2, vertexT_t v2 )
+{
+	const auto& n1 = g1[v1];
+	const auto& n2 = g2[v2];
+	if( n1._type != n2._type || n1._nbPoints != n2._nbPoints || n1._depth != n2._depth )
+		return false;
+	if( n1.isLeave() )
+		return n1._nClass == n2._nClass;
+	if( n1._attrIndex != n2._attrIndex || n1._threshold != n2._threshold )
+		return false;
+
+	auto childs = []( const GraphT& g, vertexT_t v )   // lambda: returns the (true,false) child nodes
+	{
+		std::array<vertexT_t,2> vc;
+		for( auto pit=boost::out_edges( v, g ); pit.first != pit.second; pit.first++ )
+			vc[ g[*pit.first].edgeSide ? 0 : 1 ] = boost::target( *pit.first, g );
+		return vc;
+	};
+	auto c1 = childs( g1, v1 );
+	auto c2 = childs( g2, v2 );
+	return sameTree( g1, c1[0], g2, c2[0] ) && sameTree( g1, c1[1], g2, c2[1] );
+}
+/// Helper function, returns true if both trees are the same (node ids excepted)
+bool
+sameTree( const TrainingTree& tt1, const TrainingTree& tt2 )
+{
+	return sameTree( tt1._graph, tt1._initialVertex, tt2._graph, tt2._initialVertex );
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "parallel training", "[partrain]" )
+{
+	std::mt19937 rng( 123 );
+	std::uniform_real_distribution<float> dist( 0., 100. );
+	DataSet ds( 8 );
+	for( int i=0; i<2500; i++ )              // large enough so that the attributes of the first nodes and the subtrees get processed in parallel
+	{
+		std::vector<float> v( 8 );
+		for( auto& a: v )
+			a = dist( rng );
+		int c = ( v[0] + v[3] > 100. ) + ( v[5] > 60. ) + ( rng()%10 == 0 ? 1 : 0 );
+		ds.addPoint( DataPoint( v, ClassVal(c) ) );
+	}
+	REQUIRE( ds.size() * ds.nbAttribs() >= DTCPP_MIN_PARALLEL_SIZE );
+
+	Params params;
+	std::ostringstream oss1, oss2;
+	FileDiagSink sink;
+	params.diagSink = &sink;
+	for( bool useSort: { true, false } )
+	{
+		params.useSortToFindThresholds = useSort;
+		TrainingTree tt1( ds.getClassIndexMap() ), tt2( ds.getClassIndexMap() );
+		params.nbThreads  = 1;
+		params.blockSplitMinSize = Params().blockSplitMinSize;
+		params.outputHtml = &oss1;
+		auto ti1 = tt1.train( ds, params );
+		params.nbThreads  = 4;
+		params.blockSplitMinSize = 500;      // so that the points of the first nodes get processed by blocks
+		params.outputHtml = &oss2;
+		auto ti2 = tt2.train( ds, params );
+
+		std::regex reNodeId( "(Node |_n)[0-9]+" );     // node ids depend on the node creation order
+		CHECK( std::regex_replace( oss1.str(), reNodeId, "$1#" ) == std::regex_replace( oss2.str(), reNodeId, "$1#" ) );  // html output is in the same order
+		CHECK( sameTree( tt1, tt2 ) );
+		CHECK( ti1.nbRemovals == ti2.nbRemovals );
+		CHECK( tt1.nbLeaves() == tt2.nbLeaves() );
+		CHECK( tt1.maxDepth() == tt2.maxDepth() );
+		for( size_t i=0; i<ds.size(); i++ )
+			CHECK( tt1.classify( ds.getDataPoint(i) ) == tt2.classify( ds.getDataPoint(i) ) );
+	}
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "cross validation", "[cv]" )
+{
+	std::mt19937 rng( 456 );
+	std::uniform_real_distribution<float> dist( 0., 100. );
+	DataSet ds( 4 );
+	for( int i=0; i<600; i++ )
+	{
+		std::vector<float> v( 4 );
+		for( auto& a: v )
+			a = dist( rng );
+		int c = ( v[0] > 40. ) + ( v[1] + v[2] > 120. ) + ( rng()%8 == 0 ? 1 : 0 );
+		ds.addPoint( DataPoint( v, ClassVal(c) ) );
+	}
+	DataSetView dsview( ds );
+	dsview.shuffle();
+
+	Params params;
+	params.useSortToFindThresholds = true;
+	FileDiagSink sink;
+	params.diagSink = &sink;
+	const size_t nbFolds = 5;
+
+	std::vector<TrainingTree> vTree1( nbFolds ), vTree2( nbFolds );
+	std::ostringstream oss1, oss2;
+	params.outputHtml = &oss1;
+	auto cvi1 = crossValidate( vTree1, dsview, params );
+	params.outputHtml = &oss2;
+	params.nbThreads  = 3;
+	auto cvi2 = crossValidate( vTree2, dsview, params, 3 );       // 3 folds at a time, one thread each
+
+	CHECK( cvi1.failedFold() == -1 );
+	CHECK( cvi2.failedFold() == -1 );
+	CHECK( oss1.str() == oss2.str() );                            // html output of the folds is not mixed
+	CHECK( oss1.str().find( "_at0_f4.png" ) != std::string::npos );
+	REQUIRE( cvi1.vConfMat.size() == nbFolds );
+	REQUIRE( cvi2.vConfMat.size() == nbFolds );
+	REQUIRE( cvi2.vLog.size() == nbFolds );
+	for( size_t i=0; i<nbFolds; i++ )
+	{
+		std::ostringstream ocm1, ocm2;
+		ocm1 << cvi1.vConfMat[i];
+		ocm2 << cvi2.vConfMat[i];
+		CHECK( ocm1.str() == ocm2.str() );                        // same results, in the same order
+		CHECK( cvi1.vConfMat[i].nbValues() == dsview.getFolds( i, nbFolds ).second.size() );
+		CHECK( sameTree( vTree1[i], vTree2[i] ) );
+		CHECK( cvi1.vTrainInfo[i].nbRemovals == cvi2.vTrainInfo[i].nbRemovals );
+	}
+
+	std::vector<TrainingTree> vTree3( 1 );
+	CHECK_THROWS( crossValidate( vTree3, dsview, params ) );
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "level-wise growth", "[levelwise]" )
+{
+	std::mt19937 rng( 789 );
+	std::uniform_real_distribution<float> dist( 0., 100. );
+	DataSet ds( 5 );
+	for( int i=0; i<1500; i++ )
+	{
+		std::vector<float> v( 5 );
+		for( auto& a: v )
+			a = std::round( dist( rng ) );      // so that there are some equal values
+		int c = ( v[0] + v[3] > 100. ) + ( v[4] > 70. ) + ( rng()%10 == 0 ? 1 : 0 );
+		ds.addPoint( DataPoint( v, ClassVal(c) ) );
+	}
+
+	DataSetView shuffled( ds );         // points not in index order, as in folds (see crossValidate())
+	shuffled.shuffle();
+
+	Params params;
+	std::ostringstream oss;
+	params.outputHtml = &oss;
+	for( bool useView: { false, true } )
+	for( bool useSort: { true, false } )
+		for( uint nbThreads: { 1u, 3u } )
+		{
+			params.useSortToFindThresholds = useSort;
+			params.nbThreads = nbThreads;
+			TrainingTree tt1( ds.getClassIndexMap() ), tt2( ds.getClassIndexMap() );
+			params.levelWiseGrowth = false;
+			auto ti1 = useView ? tt1.train( shuffled, params ) : tt1.train( ds, params );
+			params.levelWiseGrowth = true;
+			auto ti2 = useView ? tt2.train( shuffled, params ) : tt2.train( ds, params );
+
+			CHECK( ti2.trainingSuccess );
+			CHECK( sameTree( tt1, tt2 ) );
+			CHECK( ti1.nbRemovals == ti2.nbRemovals );
+			CHECK( tt1.nbLeaves() == tt2.nbLeaves() );
+			CHECK( tt1.maxDepth() == tt2.maxDepth() );
+			for( size_t i=0; i<ds.size(); i+=7 )
+				CHECK( tt1.classify( ds.getDataPoint(i) ) == tt2.classify( ds.getDataPoint(i) ) );
+		}
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "sibling subtraction", "[sibsub]" )
+{
+	Fparams fparams;
+	fparams.sep = ',';
+	fparams.classIsfirst = true;
+	DataSet ds;
+	REQUIRE( ds.load( "sample_data/wine.data", fparams ) );
+
+	Params params;
+	std::ostringstream oss;
+	params.useSortToFindThresholds = true;
+	params.outputHtml = &oss;
+	for( bool levelWise: { false, true } )
+	{
+		params.levelWiseGrowth = levelWise;
+		TrainingTree tt( ds.getClassIndexMap() );
+		auto ti = tt.train( ds, params );
+		REQUIRE( ti.trainingSuccess );
+		auto nbNodes = boost::num_vertices( tt._graph ) + 2 * ti.nbRemovals;   // nb of nodes before pruning
+		CHECK( ti.nbSiblingSubtractions == (nbNodes-1) / 2 );              // once per split
+		std::vector<size_t> leafCount( ds.nbClasses(), 0u );
+		for( auto pit = boost::vertices( tt._graph ); pit.first != pit.second; pit.first++ )
+		{
+			const auto& node = tt._graph[*pit.first];
+			if( node.isLeave() )
+			{
+				REQUIRE( node._classCount.size() == ds.nbClasses() );   // kept in the leaves, for pruning
+				for( size_t c=0; c<leafCount.size(); c++ )
+					leafCount[c] += node._classCount[c];
+			}
+			else
+				CHECK( node._classCount.empty() );                      // released once used
+		}
+		for( const auto& cc: ds.getClassIndexMap().left )             // the leaves hold all the points, with their class
+			CHECK( leafCount[cc.second] == ds.getClassCount( cc.first ) );
+	}
+}
+//-------------------------------------------------------------------------------------------
+/// Diagnostic sink keeping the files in memory
+struct MemoryDiagSink : public DiagSink
+{
+/// stores its content in the sink when closed
+	struct MemStream : public std::ostringstream
+	{
+		explicit MemStream( std::string& dest ) : _dest( dest ) {}
+		~MemStream() { _dest = str(); }
+		std::string& _dest;
+	};
+	bool enabled() const override { return true; }
+	std::unique_ptr<std::ostream> openFile( const std::string& fname, priv::EN_FileType ft, const std::string& ) override
+	{
+		vFiles.push_back( fname + '.' + priv::getString( ft ) );
+		return std::make_unique<MemStream>( content[ vFiles.back() ] );
+	}
+	std::vector<std::string> vFiles;
+	std::map<std::string,std::string> content;
+};
+
+TEST_CASE( "diagnostic sink", "[diag]" )
+{
+	Fparams fparams;
+	fparams.sep = ',';
+	fparams.classIsfirst = true;
+	DataSet ds;
+	REQUIRE( ds.load( "sample_data/wine.data", fparams ) );
+
+	Params params;
+	params.useSortToFindThresholds = true;
+
+	std::ostringstream oss1, oss2, oss3;
+	TrainingTree tt1( ds.getClassIndexMap() ), tt2( ds.getClassIndexMap() ), tt3( ds.getClassIndexMap() );
+	params.outputHtml = &oss1;
+	tt1.train( ds, params );                       // no sink
+	NullDiagSink nullSink;
+	params.diagSink = &nullSink;
+	params.outputHtml = &oss2;
+	tt2.train( ds, params );
+	MemoryDiagSink memSink;
+	params.diagSink = &memSink;
+	params.outputHtml = &oss3;
+	tt3.train( ds, params );
+
+	CHECK( sameTree( tt1, tt2 ) );
+	CHECK( sameTree( tt1, tt3 ) );
+	CHECK( oss1.str() == oss2.str() );
+	CHECK( oss1.str().find( "<img" ) == std::string::npos );      // no per node report without the files
+	CHECK( oss3.str().find( "<img src='thres_n0_at0.png'>" ) != std::string::npos );
+
+	REQUIRE( memSink.vFiles.size() > 2 );
+	CHECK( memSink.vFiles[0] == "thres_n0_at0.dat" );
+	for( size_t i=0; i<memSink.vFiles.size()-2; i++ )
+		CHECK( memSink.vFiles[i].find( "thres" ) == 0 );
+	CHECK( memSink.vFiles[memSink.vFiles.size()-2] == "tree_initial.dot" );   // the trees come last
+	CHECK( memSink.vFiles.back() == "tree_pruned.dot" );
+	std::ostringstream ossDot;
+	tt3.printDot( ossDot );
+	CHECK( memSink.content["tree_pruned.dot"] == ossDot.str() );
+	CHECK( oss3.str().find( "<img src='tree_pruned.png'>" ) != std::string::npos );
+
+	params.outputHtml = nullptr;                                  // no html report at all
+	params.diagSink = nullptr;
+	TrainingTree tt4( ds.getClassIndexMap() );
+	CHECK( tt4.train( ds, params ).trainingSuccess );
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "training trace", "[trace]" )
+{
+	Fparams fparams;
+	fparams.sep = ',';
+	fparams.classIsfirst = true;
+	DataSet ds;
+	REQUIRE( ds.load( "sample_data/wine.data", fparams ) );
+
+	Params params;
+	params.useSortToFindThresholds = true;
+
+	TrainingTree tt1( ds.getClassIndexMap() ), tt2( ds.getClassIndexMap() );
+	MemoryDiagSink memSink;
+	params.diagSink = &memSink;
+	tt1.train( ds, params );
+	TraceDiagSink traceSink;
+	params.diagSink = &traceSink;
+	std::ostringstream ossHtml;
+	params.outputHtml = &ossHtml;
+	tt2.train( ds, params );
+	params.outputHtml = nullptr;
+	CHECK( sameTree( tt1, tt2 ) );
+	CHECK( ossHtml.str().find( "<img" ) == std::string::npos );  // the html report is produced from the trace
+	struct CountingDiagSink : public NullDiagSink                 // only counts the split searches
+	{
+		size_t nbSearches = 0;
+		bool enabled() const override { return true; }
+		void addSplitSearch( const SplitSearchRecord&, const DataSet& ) override { nbSearches++; }
+	} countSink;
+	params.diagSink = &countSink;
+	TrainingTree tt3( ds.getClassIndexMap() );
+	tt3.train( ds, params );
+	CHECK( countSink.nbSearches > 0 );
+	CHECK( traceSink.nbRecords() == countSink.nbSearches + 2 );   // one per split search, plus the 2 trees
+
+	REQUIRE( traceSink.save( "test_trace.dtrace" ) );
+	MemoryDiagSink repSink;
+	REQUIRE( writeTraceReport( "test_trace.dtrace", repSink ) );
+
+	for( const auto& fc: memSink.content )                     // same files as when written during training
+		CHECK( repSink.content[fc.first] == fc.second );
+	CHECK( repSink.content.size() == memSink.content.size() + 1 );   // plus the html report
+	CHECK( repSink.content["training.html"].find( "<img src='thres_n0_at0.png'>" ) != std::string::npos );
+
+	std::ostringstream oss;
+	priv::printDotTree( oss, tt2._graph, tt2._initialVertex, ds._fname, tt2.nbLeaves() );
+	CHECK( repSink.content["tree_pruned.dot"] == oss.str() );
+
+	std::string buf;
+	{
+		std::ifstream fin( "test_trace.dtrace", std::ios::binary );
+		buf.assign( std::istreambuf_iterator<char>( fin ), std::istreambuf_iterator<char>() );
+	}
+	auto writeFile = [&]( std::string str )   // lambda
+	{
+		std::ofstream fout( "test_trace.dtrace", std::ios::binary );
+		fout.write( str.data(), str.size() );
+	};
+	MemoryDiagSink repSink2;
+	writeFile( buf.substr( 0, buf.size()-10 ) );               // truncated file
+	CHECK( !writeTraceReport( "test_trace.dtrace", repSink2 ) );
+	auto str = buf.substr( 0, sizeof(priv::TraceHeader) + 20 );  // truncated after the header, that announces a huge nb of labels
+	uint32_t nbLabels = uint32_t(-1);
+	std::memcpy( &str[offsetof( priv::TraceHeader, nbLabels )], &nbLabels, sizeof(nbLabels) );
+	writeFile( str );
+	CHECK( !writeTraceReport( "test_trace.dtrace", repSink2 ) );
+	CHECK( !writeTraceReport( "sample_data/wine.data", repSink2 ) );  // not a trace
+	std::remove( "test_trace.dtrace" );
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "compiled tree", "[compile]" )
+{
+	CHECK( sizeof(InferenceNode) == 16 );
+	Fparams fparams;
+	fparams.sep = ',';
+	fparams.classAsString = true;
+	DataSet ds;
+	REQUIRE( ds.load( "sample_data/iris.data", fparams ) );
+
+	Params params;
+	params.useSortToFindThresholds = true;
+	TrainingTree tt( ds.getClassIndexMap() );
+	CHECK( tt.compile().nbNodes() == 0 );                  // not trained
+	REQUIRE( tt.train( ds, params ).trainingSuccess );
+
+	auto itd = tt.compile();
+	auto itb = tt.compile( En_TreeLayout::BreadthFirst );
+	CHECK( itd.layout() == En_TreeLayout::DepthFirst );
+	CHECK( itd.nbAttribs() == ds.nbAttribs() );
+	CHECK( itd.nbNodes() == boost::num_vertices( tt._graph ) );
+	CHECK( itb.nbNodes() == itd.nbNodes() );
+	CHECK( itd.nbLeaves() == tt.nbLeaves() );
+	CHECK( itb.nbLeaves() == tt.nbLeaves() );
+
+	uint32_t next = 1;
+	for( const auto& node: itb.getNodes() )                // breadth-first: children pairs follow the order of their parents
+		if( !node.isLeaf() )
+		{
+			CHECK( node.child == next );
+			next += 2;
+		}
+	const auto& vd = itd.getNodes();
+	for( size_t i=0; i<vd.size(); i++ )                    // depth-first: the children of a lower child follow its own pair
+		if( !vd[i].isLeaf() && !vd[vd[i].child].isLeaf() )
+			CHECK( vd[vd[i].child].child == vd[i].child+2 );
+
+	for( size_t i=0; i<ds.size(); i++ )
+	{
+		auto pt = ds.getDataPoint( i );
+		std::vector<float> vVal( ds.nbAttribs() );
+		for( size_t at=0; at<vVal.size(); at++ )
+			vVal[at] = pt.attribVal( at );
+		CHECK( itd.classify( pt ) == tt.classify( pt ) );
+		CHECK( itb.classify( pt ) == tt.classify( pt ) );
+		CHECK( itd.classify( vVal.data() ) == tt.classify( pt ) );
+	}
+
+	std::ostringstream oss1, oss2, oss3;
+	oss1 << tt.classify( ds );
+	oss2 << itd.classify( ds );
+	oss3 << itb.classify( ds );
+	CHECK( oss1.str() == oss2.str() );
+	CHECK( oss1.str() == oss3.str() );
+
+	DataSetView view( ds );
+	auto folds = view.getFolds( 1, 3 );
+	std::ostringstream oss4, oss5;
+	oss4 << tt.classify( folds.second );
+	oss5 << itd.classify( folds.second );
+	CHECK( oss4.str() == oss5.str() );
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "batch classification", "[batch]" )
+{
+	std::mt19937 rng( 456 );
+	std::uniform_real_distribution<float> dist( 0., 100. );
+	DataSet ds( 5 );
+	for( int i=0; i<1003; i++ )                 // not a multiple of the batch size
+	{
+		std::vector<float> v( 5 );
+		for( auto& a: v )
+			a = dist( rng );
+		int c = ( v[0] + v[3] > 100. ) + ( v[2] > 60. ) + ( rng()%10 == 0 ? 1 : 0 );
+		ds.addPoint( DataPoint( v, ClassVal(c) ) );
+	}
+	Params params;
+	params.useSortToFindThresholds = true;
+	TrainingTree tt( ds.getClassIndexMap() );
+	REQUIRE( tt.train( ds, params ).trainingSuccess );
+
+	for( auto layout: { En_TreeLayout::DepthFirst, En_TreeLayout::BreadthFirst } )
+	{
+		auto itree = tt.compile( layout );
+		auto vPred = itree.predict( ds );
+		REQUIRE( vPred.size() == ds.size() );
+
+		std::vector<float> vRows( ds.size() * 6 );        // one unused value per row
+		for( size_t i=0; i<ds.size(); i++ )
+			for( size_t at=0; at<5; at++ )
+				vRows[i*6+at] = ds.getColumn( at )[i];
+		std::vector<ClassVal> vPredRows( ds.size() );
+		itree.predictRows( vRows.data(), ds.size(), 6, vPredRows.data() );
+
+		for( size_t i=0; i<ds.size(); i++ )
+		{
+			CHECK( vPred[i] == tt.classify( ds.getDataPoint(i) ) );
+			CHECK( vPredRows[i] == vPred[i] );
+		}
+
+		DataSetView view( ds );
+		view.shuffle();
+		auto vPredView = itree.predict( view );
+		for( size_t i=0; i<view.size(); i++ )
+			CHECK( vPredView[i] == vPred[ view.getIndexes()[i] ] );
+
+		auto attribVal = [&ds]( size_t i, uint32_t at ){ return ds.getColumn( at )[i]; };
+		for( size_t nb: { 1, 5, 13, DTCPP_INFERENCE_BATCH } )   // both paths reach the same leaves
+		{
+			std::vector<uint32_t> vLeaf1( nb ), vLeaf2( nb );
+			itree.p_findLeavesScalar( 100, nb, attribVal, vLeaf1.data() );
+#if defined(__SSE2__) && defined(DTCPP_SIMD_INFERENCE)
+			itree.p_findLeavesSSE2( 100, nb, attribVal, vLeaf2.data() );
+			CHECK( vLeaf1 == vLeaf2 );
+#endif
+			for( size_t l=0; l<nb; l++ )
+				CHECK( ClassVal( itree.getNodes()[vLeaf1[l]].classVal ) == vPred[100+l] );
+		}
+	}
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "code generation", "[codegen]" )
+{
+	for( float v: { 2.f, -3.f, 0.1f, 1.7999512f, 1e-30f, 3.4e38f } )
+	{
+		auto str = priv::floatLiteral( v );
+		CHECK( str.back() == 'f' );
+		CHECK( std::stof( str ) == v );
+	}
+
+	Fparams fparams;
+	fparams.sep = ',';
+	fparams.classAsString = true;
+	DataSet ds;
+	REQUIRE( ds.load( "sample_data/iris.data", fparams ) );
+
+	Params params;
+	params.useSortToFindThresholds = true;
+	TrainingTree tt( ds.getClassIndexMap() );
+	std::ostringstream oss0;
+	CHECK_THROWS( tt.printCode( oss0 ) );                    // not trained
+	REQUIRE( tt.train( ds, params ).trainingSuccess );
+
+	std::ostringstream oss;
+	tt.printCode( oss, "my_model", &ds.getStringIndexBimap() );
+	auto code = oss.str();
+	auto count = [&code]( const std::string& s )
+	{
+		size_t n = 0;
+		for( auto pos = code.find( s ); pos != std::string::npos; pos = code.find( s, pos+1 ) )
+			n++;
+		return n;
+	};
+	CHECK( count( "#ifndef MY_MODEL_HG" ) == 1 );
+	CHECK( count( "namespace my_model {" ) == 1 );
+	CHECK( count( "return " ) == tt.nbLeaves() + ds.nbClasses() + 1 );   // plus the cases of classLabel()
+	CHECK( count( "if( v[" ) == tt.nbLeaves() - 1 );
+	CHECK( count( "dtcpp::" ) == 0 );
+	CHECK( count( "#include" ) == 0 );
+	CHECK( count( "case " ) == ds.nbClasses() );
+	CHECK( priv::stringLiteral( "a\"b\\c\n1" ) == "\"a\\\"b\\\\c\\0121\"" );
+
+// the generated code is compiled, and its output compared with the tree on all the points
+	{
+		std::ofstream f( "test_codegen.h" );
+		f << code;
+	}
+	{
+		std::ofstream f( "test_codegen.cpp" );
+		f << "#include \"test_codegen.h\"\n#include <cstdio>\n"
+			<< "int main()\n{\n\tfloat v[" << ds.nbAttribs() << "];\n"
+			<< "\twhile( true )\n\t{\n"
+			<< "\t\tfor( int i=0; i<" << ds.nbAttribs() << "; i++ )\n"
+			<< "\t\t\tif( std::scanf( \"%f\", &v[i] ) != 1 )\n\t\t\t\treturn 0;\n"
+			<< "\t\tint c = my_model::classify( v );\n"
+			<< "\t\tstd::printf( \"%d %s\\n\", c, my_model::classLabel( c ) ? my_model::classLabel( c ) : \"-\" );\n"
+			<< "\t}\n}\n";
+	}
+	{
+		std::ofstream f( "test_codegen.in" );
+		f << std::setprecision( std::numeric_limits<float>::max_digits10 );
+		for( size_t i=0; i<ds.size(); i++ )
+			for( size_t at=0; at<ds.nbAttribs(); at++ )
+				f << ds.getColumn(at)[i] << ( at+1 == ds.nbAttribs() ? '\n' : ' ' );
+	}
+	REQUIRE( std::system( "c++ -Wall -Werror -std=c++11 test_codegen.cpp -o test_codegen.bin" ) == 0 );
+	REQUIRE( std::system( "./test_codegen.bin < test_codegen.in > test_codegen.out" ) == 0 );
+	std::ifstream fout( "test_codegen.out" );
+	for( size_t i=0; i<ds.size(); i++ )
+	{
+		int c = -2;
+		std::string label;
+		fout >> c >> label;
+		auto cval = tt.classify( ds.getDataPoint(i) );
+		CHECK( c == cval.get() );
+		CHECK( label == ds.getStringIndexBimap().right.at( cval.get() ) );
+	}
+	for( auto fn: { "test_codegen.h", "test_codegen.cpp", "test_codegen.in", "test_codegen.out", "test_codegen.bin" } )
+		std::remove( fn );
+}
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "model file", "[model]" )
+{
+	Fparams fparams;
+	fparams.sep = ',';
+	fparams.classAsString = true;
+	DataSet ds;
+	REQUIRE( ds.load( "sample_data/iris.data", fparams ) );
+
+	Params params;
+	params.useSortToFindThresholds = true;
+	TrainingTree tt( ds.getClassIndexMap() );
+	REQUIRE( tt.train( ds, params ).trainingSuccess );
+
+	auto it1 = tt.compile( En_TreeLayout::BreadthFirst );
+	it1.assignLabels( ds.getStringIndexBimap() );
+	REQUIRE( it1.saveModel( "test_model.dtm" ) );
+
+	InferenceTree it2;
+	{
+		InferenceTree it0;
+		REQUIRE( it0.loadModel( "test_model.dtm" ) );
+		it2 = it0;                           // copies share the mapped file
+	}
+	CHECK( it2.layout() == En_TreeLayout::BreadthFirst );
+	CHECK( it2.nbAttribs() == ds.nbAttribs() );
+	CHECK_THROWS( it2.classify( DataPoint( std::vector<float>{ 1.,2. }, 1 ) ) );   // not enough attributes
+	REQUIRE( it2.nbNodes() == it1.nbNodes() );
+	CHECK( std::memcmp( &it2.getNodes()[0], &it1.getNodes()[0], it1.nbNodes() * sizeof(InferenceNode) ) == 0 );
+	CHECK( it2.getClassIndexMap() == ds.getClassIndexMap() );
+	CHECK( it2.getStringIndexBimap() == ds.getStringIndexBimap() );
+	CHECK( it2.predict( ds ) == it1.predict( ds ) );
+	std::ostringstream oss1, oss2;
+	oss1 << it1.classify( ds );
+	oss2 << it2.classify( ds );
+	CHECK( oss1.str() == oss2.str() );
+
+	std::string content;
+	{
+		std::ifstream f( "test_model.dtm", std::ios::binary );
+		content.assign( std::istreambuf_iterator<char>( f ), std::istreambuf_iterator<char>() );
+	}
+	auto writeFile = [&]( std::string str )
+	{
+		std::ofstream f( "test_model.dtm", std::ios::binary );
+		f.write( str.data(), str.size() );
+	};
+	priv::ModelHeader h;
+	std::memcpy( &h, content.data(), sizeof(h) );
+
+	InferenceTree it3;
+	CHECK( !it3.loadModel( "sample_data/iris.data" ) );       // not a model file
+	CHECK( !it3.loadModel( "no_such_file" ) );
+	writeFile( content.substr( 0, content.size()-1 ) );          // truncated
+	CHECK( !it3.loadModel( "test_model.dtm" ) );
+	auto str = content;
+	uint32_t badChild = 0;                                     // root pointing on itself
+	std::memcpy( &str[h.offNodes + offsetof( InferenceNode, child )], &badChild, sizeof(badChild) );
+	writeFile( str );
+	CHECK( !it3.loadModel( "test_model.dtm" ) );
+	CHECK( it3.nbNodes() == 0 );
+	str = content;
+	uint32_t badAttr = static_cast<uint32_t>( ds.nbAttribs() );  // root using an attribute that points do not have
+	std::memcpy( &str[h.offNodes + offsetof( InferenceNode, attrIndex )], &badAttr, sizeof(badAttr) );
+	writeFile( str );
+	CHECK( !it3.loadModel( "test_model.dtm" ) );
+	CHECK( it3.nbNodes() == 0 );
+	REQUIRE( h.nbClasses > 1 );
+	uint32_t secondIdx;
+	std::memcpy( &secondIdx, &content[h.offClasses + 3 * sizeof(uint32_t)], sizeof(secondIdx) );
+	for( uint32_t badIdx: { uint32_t( h.nbClasses ), secondIdx } )    // 1st class index out of range, then same as 2nd one
+	{
+		str = content;
+		std::memcpy( &str[h.offClasses + sizeof(uint32_t)], &badIdx, sizeof(badIdx) );
+		writeFile( str );
+		CHECK( !it3.loadModel( "test_model.dtm" ) );
+		CHECK( it3.nbNodes() == 0 );
+	}
+
+	writeFile( content );
+	CHECK( it3.loadModel( "test_model.dtm" ) );
+	std::remove( "test_model.dtm" );
+	CHECK( it3.predict( ds ) == it1.predict( ds ) );           // still mapped
+}
+//-------------------------------------------------------------------------------------------
 TEST_CASE( "my_stod", "[STOD]" )
 {
 	CHECK_THROWS( dtcpp::priv::my_stod( "abc" ) );
@@ -260,6 +1269,225 @@ TEST_CASE( "my_stod", "[STOD]" )
 	CHECK( dtcpp::priv::my_stod( "0,12345678912" ) == 0.12345678912 );
 }
 
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "parser", "[parser]" )
+{
+	auto parse = []( std::string str, double& v )  // returns true if the whole string got converted
+	{
+		auto last = str.data() + str.size();
+		return dtcpp::priv::parseNumber( str.data(), last, v ) == last;
+	};
+	double v = 0.;
+	CHECK( parse( "1.25", v ) );   CHECK( v == 1.25 );
+	CHECK( parse( "1,25", v ) );   CHECK( v == 1.25 );
+	CHECK( parse( "-.5", v ) );    CHECK( v == -0.5 );
+	CHECK( parse( "1e3", v ) );    CHECK( v == 1000. );
+	CHECK( parse( "2.5E-2", v ) ); CHECK( v == 0.025 );
+	CHECK( !parse( "12.34,56", v ) );
+	CHECK( !parse( "1e", v ) );
+	CHECK( !parse( "", v ) );
+	CHECK( !parse( "-", v ) );
+
+	std::vector<boost::string_view> v_tok;
+	std::string line( "1.2;  3 ;x y;" );
+	dtcpp::priv::splitLine( line.data(), line.data()+line.size(), ';', v_tok );
+	REQUIRE( v_tok.size() == 3 );
+	CHECK( v_tok[0] == "1.2" );
+	CHECK( v_tok[1] == "3" );
+	CHECK( v_tok[2] == "x y" );
+
+	line = "  1.2 \t 3  4 ";
+	dtcpp::priv::splitLine( line.data(), line.data()+line.size(), ' ', v_tok );
+	REQUIRE( v_tok.size() == 3 );
+	CHECK( v_tok[2] == "4" );
+}
+
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "load mmap", "[loadmm]" )
+{
+	Fparams fparams;
+	fparams.sep = ',';
+	fparams.classAsString = true;
+	DataSet ds1, ds2;
+	fparams.useMemoryMapping = true;
+	REQUIRE( ds1.load( "sample_data/iris.data", fparams ) );
+	fparams.useMemoryMapping = false;
+	REQUIRE( ds2.load( "sample_data/iris.data", fparams ) );
+
+	REQUIRE( ds1.size() == 150 );
+	REQUIRE( ds1.size() == ds2.size() );
+	CHECK( ds1.nbClasses() == 3 );
+	for( size_t i=0; i<ds1.size(); i++ )
+	{
+		CHECK( ds1.classVal(i) == ds2.classVal(i) );
+		for( size_t at=0; at<ds1.nbAttribs(); at++ )
+			CHECK( ds1.getColumn(at)[i] == ds2.getColumn(at)[i] );
+	}
+
+	std::string content;                                       // a named pipe is not mapped, but read once as a stream
+	{
+		std::ifstream f( "sample_data/iris.data" );
+		content.assign( std::istreambuf_iterator<char>( f ), std::istreambuf_iterator<char>() );
+	}
+	std::remove( "test_fifo.data" );
+	REQUIRE( mkfifo( "test_fifo.data", 0600 ) == 0 );
+	std::thread writer(                                        // more than the pipe buffer, so the writer has to wait for the reader
+		[&content]{ std::ofstream f( "test_fifo.data" ); for( int i=0; i<50; i++ ) f << content; }   // lambda
+	);
+	DataSet ds3;
+	fparams.useMemoryMapping = true;
+	CHECK( ds3.load( "test_fifo.data", fparams ) );
+	writer.join();
+	std::remove( "test_fifo.data" );
+	CHECK( ds3.size() == 50 * ds1.size() );
+}
+
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "load parallel", "[loadpar]" )
+{
+	Fparams fparams;
+	fparams.sep = ',';
+	fparams.classAsString = true;
+	DataSet ds1, ds2;
+	REQUIRE( ds1.load( "sample_data/iris.data", fparams ) );
+	fparams.nbThreads = 5;
+	REQUIRE( ds2.load( "sample_data/iris.data", fparams ) );
+
+	REQUIRE( ds1.size() == ds2.size() );
+	REQUIRE( ds1.nbAttribs() == ds2.nbAttribs() );
+	CHECK( ds2.nbClasses() == 3 );
+	REQUIRE( ds1.getStringIndexBimap().size() == ds2.getStringIndexBimap().size() );
+	for( const auto& lab: ds1.getStringIndexBimap().left )
+		CHECK( ds2.getStringIndexBimap().left.at( lab.first ) == lab.second );
+	for( int c=0; c<3; c++ )
+		CHECK( ds1.getClassCount( ClassVal(c) ) == ds2.getClassCount( ClassVal(c) ) );
+	for( size_t i=0; i<ds1.size(); i++ )
+	{
+		CHECK( ds1.classVal(i) == ds2.classVal(i) );
+		for( size_t at=0; at<ds1.nbAttribs(); at++ )
+			CHECK( ds1.getColumn(at)[i] == ds2.getColumn(at)[i] );
+	}
+}
+
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "snapshot", "[snap]" )
+{
+	Fparams fparams;
+	fparams.sep = ',';
+	fparams.classAsString = true;
+	DataSet ds1, ds2;
+	REQUIRE( ds1.load( "sample_data/iris.data", fparams ) );
+
+	DatasetStats<float> st1( ds1.nbAttribs() );
+	st1.add( 1, AttribStats<float>{ 1.f, 2.f, 3.f, 4.f, 5.f } );
+	REQUIRE( ds1.saveSnapshot( "test_snapshot.dtcache", &st1 ) );
+	REQUIRE( ds2.loadSnapshot( "test_snapshot.dtcache", fparams ) );
+
+	CHECK( !ds1.isReadOnly() );
+	CHECK( ds2.isReadOnly() );
+	REQUIRE( ds1.size() == ds2.size() );
+	REQUIRE( ds1.nbAttribs() == ds2.nbAttribs() );
+	CHECK( ds2.nbClasses() == 3 );
+	CHECK( ds1._fname == ds2._fname );
+	for( int c=0; c<3; c++ )
+		CHECK( ds1.getClassCount( ClassVal(c) ) == ds2.getClassCount( ClassVal(c) ) );
+	for( const auto& lab: ds1.getStringIndexBimap().left )
+		CHECK( ds2.getStringIndexBimap().left.at( lab.first ) == lab.second );
+	for( size_t i=0; i<ds1.size(); i++ )
+	{
+		CHECK( ds1.classVal(i) == ds2.classVal(i) );
+		for( size_t at=0; at<ds1.nbAttribs(); at++ )
+			CHECK( ds1.getColumn(at)[i] == ds2.getColumn(at)[i] );
+	}
+
+	DatasetStats<float> st2( 1 );
+	REQUIRE( ds2.getSnapshotStats( st2 ) );
+	CHECK( st2.get(1)._meanVal == 3.f );
+	CHECK( st2.get(1)._medianVal == 5.f );
+
+	auto ds3 = ds2;              // copies share the mapped file
+	CHECK( ds3.isReadOnly() );
+	CHECK( ds3.getColumn(0) == ds2.getColumn(0) );
+
+	ds2.addPoint( DataPoint( std::vector<float>{ 1.,2.,3.,4. }, 1 ) );  // modifying it copies the data
+	CHECK( !ds2.isReadOnly() );
+	CHECK( ds2.size() == ds1.size()+1 );
+	CHECK( ds2.getColumn(3)[0] == ds1.getColumn(3)[0] );
+	CHECK( ds2.getClassCount( ClassVal(1) ) == ds1.getClassCount( ClassVal(1) )+1 );
+
+	DataSet ds4;
+	fparams.classAsString = false;
+	CHECK( !ds4.loadSnapshot( "test_snapshot.dtcache", fparams ) );  // different parameters
+	CHECK( !ds4.loadSnapshot( "sample_data/iris.data", fparams ) );   // not a snapshot
+	CHECK( ds4.size() == 0 );
+
+	fparams.classAsString = true;
+	std::string content;
+	{
+		std::ifstream f( "test_snapshot.dtcache", std::ios::binary );
+		content.assign( std::istreambuf_iterator<char>( f ), std::istreambuf_iterator<char>() );
+	}
+	priv::SnapshotHeader h;
+	std::memcpy( &h, content.data(), sizeof(h) );
+	auto checkTampered = [&]( size_t offset, uint64_t value )   // writes \c value at \c offset and tries to load the file
+	{
+		auto str = content;
+		std::memcpy( &str[offset], &value, sizeof(value) );
+		{
+			std::ofstream f( "test_snapshot.dtcache", std::ios::binary );
+			f.write( str.data(), str.size() );
+		}
+		return ds4.loadSnapshot( "test_snapshot.dtcache", fparams );
+	};
+	CHECK( !checkTampered( offsetof( priv::SnapshotHeader, colStride ), 64 ) );                // columns overlap
+	CHECK( !checkTampered( offsetof( priv::SnapshotHeader, colStride ), uint64_t(1)<<62 ) );   // colStride*nbAttribs overflows
+	CHECK( !checkTampered( offsetof( priv::SnapshotHeader, offColumns ), h.offColumns+8 ) );    // misaligned
+	CHECK( !checkTampered( h.offClass, 7 ) );                                                 // unknown class value
+	CHECK( !checkTampered( h.offClassCount, uint64_t(-3) ) );                                  // negative class value
+	CHECK( ds4.size() == 0 );
+	CHECK( checkTampered( offsetof( priv::SnapshotHeader, fileSize ), h.fileSize ) );          // unchanged
+	std::remove( "test_snapshot.dtcache" );
+}
+
+//-------------------------------------------------------------------------------------------
+TEST_CASE( "out of core", "[ooc]" )
+{
+	Fparams fparams;
+	fparams.sep = ',';
+	fparams.classAsString = true;
+	DataSet ds1, ds2;
+	REQUIRE( ds1.load( "sample_data/iris.data", fparams ) );
+	REQUIRE( DataSet::createSnapshot( "sample_data/iris.data", "test_ooc.dtcache", fparams, 64 ) );
+	REQUIRE( ds2.loadSnapshot( "test_ooc.dtcache", fparams ) );
+
+	REQUIRE( ds1.size() == ds2.size() );
+	CHECK( ds2.nbClasses() == 3 );
+	for( const auto& lab: ds1.getStringIndexBimap().left )
+		CHECK( ds2.getStringIndexBimap().left.at( lab.first ) == lab.second );
+	for( size_t i=0; i<ds1.size(); i++ )
+	{
+		CHECK( ds1.classVal(i) == ds2.classVal(i) );
+		for( size_t at=0; at<ds1.nbAttribs(); at++ )
+			CHECK( ds1.getColumn(at)[i] == ds2.getColumn(at)[i] );
+	}
+
+	std::ostringstream oss;
+	Params params;
+	params.outputHtml = &oss;
+	TrainingTree tt1( ds1.getClassIndexMap() ), tt2( ds2.getClassIndexMap() );
+	auto ti1 = tt1.train( ds1, params );
+	params.memoryBudget = 1;       // so that all the lists get moved out of memory
+	auto ti2 = tt2.train( ds2, params );
+	CHECK( ti1.nbSpilledLists == 0 );
+	CHECK( ti2.nbSpilledLists > 0 );
+	CHECK( ti1.nbRemovals == ti2.nbRemovals );
+	CHECK( tt1.nbLeaves() == tt2.nbLeaves() );
+	CHECK( tt1.maxDepth() == tt2.maxDepth() );
+	for( size_t i=0; i<ds1.size(); i++ )
+		CHECK( tt1.classify( ds1.getDataPoint(i) ) == tt2.classify( ds2.getDataPoint(i) ) );
+	std::remove( "test_ooc.dtcache" );
+}
+
 //-------------------------------------------------------------------------------------------
 /// Helper function for the pruning test
 std::pair<vertexT_t,vertexT_t>
@@ -273,12 +1501,13 @@ addChildPairT( vertexT_t v, GraphT& g )
 	g[pv.second]._nClass = ClassVal(5);
 	g[pv.first]._type   = NT_Final_MD;
 	g[pv.second]._type  = NT_Final_MD;
+	g[pv.first]._classCount  = ClassCountArray{ 2, 8 };
+	g[pv.second]._classCount = ClassCountArray{ 2, 8 };
 	return pv;
 }
 
 //-------------------------------------------------------------------------------------------
-/// test of pruning
-/// 20210403: disabled, because prubning now requires a dataset (to recompute GI for a merged node)
+/// test of pruning (the leaves hold their class count, so the dataset is not used)
 TEST_CASE( "pruning", "[pru]" )
 {
 	g_params.verbose = true;
@@ -301,12 +1530,27 @@ TEST_CASE( "pruning", "[pru]" )
 	CHECK( boost::num_edges( g ) == 8 );
 	CHECK( tt.nbLeaves() == 5 );
 	tt.printInfo( std::cout );
-//	tt.printDot( 0 );
 
-/*	CHECK( tt.pruning() == 4 );
+	DataSet ds;
+	priv::IndexSpill spill( 0 );
+	CHECK( tt.p_pruning( ds, spill ) == 4 );         // all the leaves have same class
+	CHECK( boost::num_vertices( g ) == 1 );
 	CHECK( tt.nbLeaves() == 0 );
-	tt.printInfo( std::cout );
-	tt.printDot( 1 );*/
+	CHECK( g[tt._initialVertex]._nClass == ClassVal(5) );
+
+	tt.clear();
+	pvA  = addChildPairT( tt._initialVertex, g );
+	pvB1 = addChildPairT( pvA.first, g );
+	auto pvB2 = addChildPairT( pvA.second, g );
+	addChildPairT( pvB1.first, g );
+	g[pvB2.second]._nClass = ClassVal(4);
+	CHECK( tt.p_pruning( ds, spill ) == 2 );         // only the subtree of pvA.first collapses
+	CHECK( tt.nbLeaves() == 3 );
+	CHECK( g[pvA.first]._type == NT_Merged );
+	CHECK( g[pvA.first]._nClass == ClassVal(5) );
+	CHECK( g[pvA.first]._classCount == ClassCountArray{ 6, 24 } );
+	CHECK( g[pvA.first]._giniImpurity == Approx( 1. - 0.2*0.2 - 0.8*0.8 ) );
+	CHECK( g[pvA.second]._type == NT_Decision );
 }
 
 //-------------------------------------------------------------------------------------------
@@ -326,9 +1570,9 @@ TEST_CASE( "streaming ConfusionMatrix", "[scm]" )
 //-------------------------------------------------------------------------------------------
 TEST_CASE( "vbs_histogram", "[vbsh]" )
 {
-	auto c1 = ClassVal(1);
-	auto c2 = ClassVal(2);
-	std::vector<std::pair<float,ClassVal>> vpac{
+	auto c1 = ClassIndex(0);
+	auto c2 = ClassIndex(1);
+	std::vector<std::pair<float,ClassIndex>> vpac{
 		{ 0.,  c1 },
 		{ 0.5, c1 },
 		{ 0.6, c1 },
@@ -336,7 +1580,7 @@ TEST_CASE( "vbs_histogram", "[vbsh]" )
 		{ 0.8, c2 },
 		{ 3.,  c2 },
 	};
-	histac::VBS_Histogram<float,ClassVal> h( vpac, 3 );
+	histac::VBS_Histogram<float,ClassIndex> h( vpac, 3 );
 	CHECK( h.nbBins() == 3 );
 	CHECK( h.nbPts()  == 6 );
 
@@ -380,9 +1624,9 @@ TEST_CASE( "vbs_histogram", "[vbsh]" )
 //-------------------------------------------------------------------------------------------
 TEST_CASE( "vbs_histogram2", "[vbsh2]" )
 {
-	auto c1 = ClassVal(1);
-	auto c2 = ClassVal(2);
-	std::vector<std::pair<float,ClassVal>> vpac{
+	auto c1 = ClassIndex(0);
+	auto c2 = ClassIndex(1);
+	std::vector<std::pair<float,ClassIndex>> vpac{
 		{ 0.0, c1 },
 		{ 1.5, c1 },
 		{ 1.5, c2 },
@@ -390,7 +1634,7 @@ TEST_CASE( "vbs_histogram2", "[vbsh2]" )
 		{ 2.5, c2 },
 		{ 4.0, c2 },
 	};
-	histac::VBS_Histogram<float,ClassVal> h( vpac, 4 );
+	histac::VBS_Histogram<float,ClassIndex> h( vpac, 4 );
 	CHECK( h.nbBins() == 4 );
 	CHECK( h.nbPts()  == 6 );
 	h.print( std::cout, "BEFORE SPLIT" );
@@ -440,6 +1684,44 @@ TEST_CASE( "missing_data", "[missdata]" )
 	CHECK(  pt.valueIsMissing(1) );
 	CHECK( !pt.valueIsMissing(2) );
 }
+
+TEST_CASE( "missing_data bitmaps", "[missbm]" )
+{
+	DataSet data( 3 );
+	for( int i=0; i<150; i++ )   // attribute 1 missing for one point out of 3, spans 3 bitmap words
+	{
+		auto s = std::to_string(i);
+		data.addPoint( DataPoint( std::vector<std::string>{ s, (i%3 ? s : "?"), s } ) );
+	}
+	CHECK( data.size() == 150 );
+	CHECK( !data.attribHasMissingValues(0) );
+	CHECK(  data.attribHasMissingValues(1) );
+	CHECK( !data.attribHasMissingValues(2) );
+	CHECK( data.getMissingBitmap(0) == nullptr );
+	CHECK( data.getMissingBitmap(2) == nullptr );
+	const auto* bm = data.getMissingBitmap(1);
+	REQUIRE( bm != nullptr );
+	CHECK( ( bm[0] & 0xF ) == 0x9 );   // points 0 and 3
+	CHECK( data.nbMissingValues(3) == 1 );
+	CHECK( data.nbMissingValues(4) == 0 );
+
+	auto check = [](const auto& ds)   // missing values must follow the points
+	{
+		for( size_t i=0; i<ds.size(); i++ )
+		{
+			auto pt = ds.getDataPoint( i );
+			CHECK( pt.valueIsMissing( 1 ) == ( int( pt.attribVal(0) ) % 3 == 0 ) );
+		}
+	};
+	check( data );
+	data.shuffle();
+	check( data );
+
+	auto vfolds = data.getFolds( 1, 5 );
+	CHECK( vfolds.second.size() == 30 );
+	check( vfolds.first );
+	check( vfolds.second );
+}
 #endif
 
 //-------------------------------------------------------------------------------------------